@@ -4,19 +4,60 @@
 #include <thread>
 #include <chrono>
 #include <bitset>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
 
 #include "deps/DeviceManager.h"
+#include "deps/SimAudioBackend.h"
+#include "deps/Command.h"
+#include "deps/CommandServer.h"
+#include "deps/StatePublisher.h"
+#include "deps/DuckEngine.h"
+#include "deps/DeviceGroup.h"
+#include "deps/LevelMath.h"
+#include "deps/PeakMeter.h"
+#include "deps/MachineOutput.h"
+#include "deps/Profile.h"
+#include "deps/Trace.h"
+#include "deps/AliasTable.h"
 
 #undef max
 #undef min
 
 const std::string version = "V1.0.0";
+// set by -out: no console, no waiting, results on stdout and an exit code
+static OutFormat machine_out = OutFormat::NONE;
 
 bool remake_terminal();
 void message_timer(const unsigned int);
+void print_stats(const char*, std::vector<double>&);
+void run_benchmark(const std::function<std::shared_ptr<AudioBackend>()>&, const std::string&, const Command&, const size_t);
+bool forward_command(const std::vector<std::string>&, std::string&);
+void run_loadtest(const std::vector<std::string>&, const size_t, const size_t);
+void print_ramp_stats(const RampEngine&);
+void print_trace(std::ostream&, const std::chrono::steady_clock::time_point);
+void report_opstats(std::ostream&, const bool, const std::string&);
+void run_level_benchmark();
+void run_enum_benchmark(SimConfig, const size_t);
+void run_meter(const DeviceList&, const std::vector<std::vector<std::string>>&, const size_t, const size_t, const bool);
+void list_sessions(const DeviceList&, const std::vector<std::vector<std::string>>&);
+void run_ducking(const DeviceList&, const std::vector<std::pair<DuckRule, std::vector<std::vector<std::string>>>>&, const size_t, const bool);
+int run_machine(const std::function<std::shared_ptr<AudioBackend>()>&, const std::string&, const std::vector<std::string>&);
 
 int main(int argc, char* argv[])
 {
+	const auto started = std::chrono::steady_clock::now();
 	try {
 #ifdef _DEBUG
 		remake_terminal();
@@ -36,9 +77,58 @@ int main(int argc, char* argv[])
 			std::cout << "SoundCtl " << version << " by Lohk, 2022\n";
 			std::cout << "Compiled " << __DATE__ << " @ " << __TIME__ << " GMT-3\n\n";
 
-			std::cout << "Call: <app.exe> <device kind> <device name to find> <modifiers> (number)\n\n";
+			std::cout << "Call: <app.exe> [options] [-app <app>] <device kind> <device name to find> <modifiers> (number)\n\n";
+			std::cout << "Options:\n";
+			std::cout << "- -sim <spec>: use a simulated backend, e.g. play=8,rec=4,ch=2,depth=2,lat=50,fail=10 (lat in us, fail: every n-th write fails)\n";
+			std::cout << "- -bench <runs>: run the command <runs> times and print the timing of each phase\n";
+			std::cout << "- -enumbench <workers>: time opening 1 to 256 fake endpoints one by one and on that many threads (lat from -sim, default 100)\n";
+			std::cout << "- -trace: print how long each startup phase took (COM init, enumerator, enumerate, match, activate, apply)\n";
+			std::cout << "- -opstats: print call counts, failures and latency histograms of every device operation after the run\n";
+			std::cout << "- -opstatsfile <file>: write them to that file instead (with -daemonstats: the ones of the resident instance)\n";
+			std::cout << "- -levelbench: time the dB/scalar conversion kernels against powf/log10f (no device arguments)\n";
+			std::cout << "- -meter <hz>: stream the peak level of each device (<kind> <name>, ; between devices) up to 1000 times per second\n";
+			std::cout << "- -meterfor <ms>: stop metering after this long (default: until closed)\n";
+			std::cout << "- -meterstats: print the sampler cost per device once metering stops\n";
+			std::cout << "- -out <json|line>: machine mode for list, get <kind> <name> or set <command>, see below\n";
+			std::cout << "- -sessions: list the application sessions of each device (<kind> <name>, ; between devices) with their volume and mute\n";
+			std::cout << "- -daemon: stay resident and run commands sent by -client (no device arguments)\n";
+			std::cout << "- -maxrate <hz>: volume writes per second per device in resident mode, bursts are merged (default 50)\n";
+			std::cout << "- -daemonstats: print how many volume changes the resident instance got and how many writes it issued\n";
+			std::cout << "- -client: send the command to the resident instance, run it here if there is none\n";
+			std::cout << "- -loadtest <count>: send the command <count> times to the resident instance and print the latency\n";
+			std::cout << "- -conns <n>: connections used by -loadtest (default 1)\n";
+			std::cout << "- -batch <file>: run one command per line of the file (- for stdin) with a single enumeration\n";
+			std::cout << "- -timeout <ms>: give up on a device that takes longer than this, each device runs on its own thread (no -fade)\n";
+			std::cout << "- -fade <ms>: ramp volume changes over this long instead of jumping\n";
+			std::cout << "- -curve <lin|db|s>: shape of the ramp, linear, linear in dB or S-curve (default lin)\n";
+			std::cout << "- -fadestats: print step and jitter figures once the ramps are done\n";
+			std::cout << "- -save <file>: store volume, mute and channel levels of every device in a profile (no device arguments)\n";
+			std::cout << "- -load <file>: bring every device of the profile back to it, writing only what differs (no device arguments)\n";
+			std::cout << "- -profilestats: print how many values -load wrote and skipped\n";
+			std::cout << "- -alias <alias>: remember the device given after it (<kind> <name>) as @<alias>, by its endpoint ID\n";
+			std::cout << "- -aliases: list the aliases and the endpoint IDs they stand for (no device arguments)\n";
+			std::cout << "- -publish <hz>: keep the state of every device in shared memory for other programs, sampled that often (alone or with -daemon)\n";
+			std::cout << "- -publishfor <ms>: stop publishing after this long (default: until closed)\n";
+			std::cout << "- -publishpeaks: publish the last peak of each device too\n";
+			std::cout << "- -statefile <name>: shared memory to publish to or read from (default " << state_default_name() << ")\n";
+			std::cout << "- -readstate: print what is published there, like -out list (no device arguments)\n";
+			std::cout << "- -duck <rule>: lower the devices after the first one (IN <name> ; [-app <app>] OUT <name> ; ...) while the first one picks up sound\n";
+			std::cout << "  <rule>: thr=0.1,depth=0.3,attack=20,hold=500,release=800,curve=db (peak threshold, ducked fraction, times in ms)\n";
+			std::cout << "- -duckrules <file>: one rule per line, <rule> then the devices as above (several capture devices at once)\n";
+			std::cout << "- -duckfor <ms>: stop ducking after this long and put everything back (default: until closed)\n";
+			std::cout << "- -duckstats: print triggers, writes and reaction latency of each rule once ducking stops\n";
+			std::cout << "- -groups <file>: keep linked devices together (alone or with -daemon), one group per line:\n";
+			std::cout << "  <name> <kind> <name> [x<ratio>] [+|-<offset>] [nomute] ; <kind> <name> ... (the first device sets the start)\n";
+			std::cout << "- -groupfor <ms>: stop following the groups after this long (default: until closed)\n";
+			std::cout << "- -groupstats: print changes, echoes and propagation latency once the groups stop\n\n";
+			std::cout << "Several commands can also be given at once, separated by a standalone ;\n";
+			std::cout << "-app <app> right before a command changes the sessions of that application on the device instead of the device itself.\n";
+			std::cout << "<app> is a PID, a session identifier or a process name (.exe optional). Sessions are not faded.\n\n";
+			std::cout << "Machine mode (-out) never opens a console or waits. It prints the state of the devices involved (set prints it after the change)\n";
+			std::cout << "as one JSON object or one line per device: <IN|OUT> <default> <volume> <mute> <levels> <id> <name>, tab separated.\n";
+			std::cout << "Errors print {\"ok\":false,...} or ERR <reason>. Exit code: 0 ok, 1 failed, 2 invalid parameters, 3 no such device.\n\n";
 			std::cout << "Device kind: IN or OUT (defaults IN if something else)\n";
-			std::cout << "Device name: hint or * for default console one\n";
+			std::cout << "Device name: hint or * for default console one, an endpoint ID ({...}, see -out line list) or @<alias>\n";
 			std::cout << "Number: depends on flag\n";
 			std::cout << "Flags:\n";
 			std::cout << "- M: mute\n";
@@ -51,9 +141,316 @@ int main(int argc, char* argv[])
 			std::cout << "Examples:\n";
 			std::cout << "app.exe OUT Yeti T <- Switch mute on a OUTPUT device with Yeti in the name\n";
 			std::cout << "app.exe IN Line ms 1.0 <- Unmute a output with Line in the name and set its volume to 100%\n";
+			std::cout << "app.exe -sim play=64,lat=20 -bench 1000 OUT \"Speakers 63\" T <- Time the whole path against 64 fake outputs\n";
+			std::cout << "app.exe -client OUT Yeti T <- Same as the first example, through the resident instance\n";
+			std::cout << "app.exe IN * M ; OUT Headset s 0.4 ; IN Line m <- Three changes, one startup\n";
+			std::cout << "app.exe -timeout 500 OUT Headset M ; OUT Speakers m <- A headset that hangs does not hold up the speakers\n";
+			std::cout << "app.exe -fade 2000 -curve db OUT Stream s 0.0 <- Fade an output out over 2 seconds\n";
+			std::cout << "app.exe -meter 100 -meterfor 5000 OUT * ; IN Mic <- Peaks of two devices, 100 times a second for 5 seconds\n";
+			std::cout << "app.exe -app firefox OUT * s 0.2 <- Turn Firefox down to 20% on the default output, nothing else changes\n";
+			std::cout << "app.exe -sessions OUT * <- What plays on the default output\n";
+			std::cout << "app.exe -save meeting.scp <- Later, -load meeting.scp switches the whole mixer back in one go\n";
+			std::cout << "app.exe -out json list <- Every device with its ID, volume, mute and channel levels\n";
+			std::cout << "app.exe -out line set OUT * i 0.05 <- Raise the default output and print its new state\n";
+			std::cout << "app.exe -alias desk OUT Speakers <- From now on, OUT @desk T toggles exactly that device, even with two \"Speakers\"\n";
+			std::cout << "app.exe -daemon -publish 20 <- Serve -client commands and keep every device state in shared memory for dashboards\n";
+			std::cout << "app.exe -groups links.txt <- With \"desk OUT Speakers ; OUT Headset x0.5\" in it, the headset follows the speakers at half\n";
 			message_timer(10);
 			return 0;
 		}
+		std::shared_ptr<const SimWorld> sim;
+		size_t bench_runs = 0, enum_workers = 0, load_runs = 0, load_conns = 1, meter_hz = 0, meter_ms = 0;
+		std::string batch_file, profile_save, profile_load, opstats_file, alias_name, state_name = state_default_name();
+		Fade fade;
+		bool fade_stats = false, profile_stats = false;
+		size_t max_rate = 50, publish_hz = 0, publish_ms = 0;
+		bool daemon = false, daemon_stats = false, client = false, level_bench = false, meter_stats = false, sessions = false, trace = false, opstats = false, list_aliases = false;
+		bool publish_peaks = false, read_published = false, duck_stats = false;
+		std::vector<std::pair<DuckRule, std::vector<std::vector<std::string>>>> duck_rules;
+		std::string duck_spec;
+		size_t duck_ms = 0;
+		std::vector<std::vector<std::string>> group_lines;
+		size_t group_ms = 0;
+		size_t timeout_ms = 0;
+		bool group_stats = false;
+		{
+			int argp = 1;
+			for (; argp < argc; ++argp) {
+				const bool has_val = (argp + 1 < argc);
+				if (strcmp(argv[argp], "-daemon") == 0) daemon = true;
+				else if (strcmp(argv[argp], "-client") == 0) client = true;
+				else if (strcmp(argv[argp], "-daemonstats") == 0) daemon_stats = true;
+				else if (has_val && strcmp(argv[argp], "-maxrate") == 0) max_rate = std::max<size_t>(1, std::stoul(argv[++argp]));
+				else if (strcmp(argv[argp], "-levelbench") == 0) level_bench = true;
+				else if (strcmp(argv[argp], "-trace") == 0 || strcmp(argv[argp], "--trace") == 0) trace = true;
+				else if (strcmp(argv[argp], "-opstats") == 0) opstats = true;
+				else if (has_val && strcmp(argv[argp], "-opstatsfile") == 0) opstats_file = argv[++argp];
+				else if (has_val && strcmp(argv[argp], "-sim") == 0) sim = std::make_shared<SimWorld>(SimConfig::parse(argv[++argp]));
+				else if (has_val && strcmp(argv[argp], "-bench") == 0) bench_runs = std::stoul(argv[++argp]);
+				else if (has_val && strcmp(argv[argp], "-enumbench") == 0) enum_workers = std::max<size_t>(1, std::stoul(argv[++argp]));
+				else if (has_val && strcmp(argv[argp], "-loadtest") == 0) load_runs = std::stoul(argv[++argp]);
+				else if (has_val && strcmp(argv[argp], "-conns") == 0) load_conns = std::max<size_t>(1, std::stoul(argv[++argp]));
+				else if (has_val && strcmp(argv[argp], "-batch") == 0) batch_file = argv[++argp];
+				else if (has_val && strcmp(argv[argp], "-timeout") == 0) timeout_ms = std::max<size_t>(1, std::stoul(argv[++argp]));
+				else if (has_val && strcmp(argv[argp], "-fade") == 0) fade.length = std::chrono::milliseconds(std::stoul(argv[++argp]));
+				else if (has_val && strcmp(argv[argp], "-curve") == 0) fade.curve = parse_curve(argv[++argp]);
+				else if (strcmp(argv[argp], "-fadestats") == 0) fade_stats = true;
+				else if (has_val && strcmp(argv[argp], "-save") == 0) profile_save = argv[++argp];
+				else if (has_val && strcmp(argv[argp], "-load") == 0) profile_load = argv[++argp];
+				else if (strcmp(argv[argp], "-profilestats") == 0) profile_stats = true;
+				else if (has_val && strcmp(argv[argp], "-alias") == 0) alias_name = argv[++argp];
+				else if (strcmp(argv[argp], "-aliases") == 0) list_aliases = true;
+				else if (has_val && strcmp(argv[argp], "-publish") == 0) publish_hz = std::max<size_t>(1, std::stoul(argv[++argp]));
+				else if (has_val && strcmp(argv[argp], "-publishfor") == 0) publish_ms = std::stoul(argv[++argp]);
+				else if (strcmp(argv[argp], "-publishpeaks") == 0) publish_peaks = true;
+				else if (has_val && strcmp(argv[argp], "-statefile") == 0) state_name = argv[++argp];
+				else if (strcmp(argv[argp], "-readstate") == 0) read_published = true;
+				else if (has_val && strcmp(argv[argp], "-duck") == 0) duck_spec = argv[++argp];
+				else if (has_val && strcmp(argv[argp], "-duckrules") == 0) {
+					std::ifstream fp(argv[++argp]);
+					if (!fp) throw std::runtime_error(std::string("Cannot read ") + argv[argp]);
+					for (const auto& line : read_batch(fp)) {
+						const std::vector<std::string> rest(line.begin() + 1, line.end());
+						duck_rules.emplace_back(DuckRule::parse(line[0]), split_batch(rest));
+					}
+				}
+				else if (has_val && strcmp(argv[argp], "-duckfor") == 0) duck_ms = std::stoul(argv[++argp]);
+				else if (strcmp(argv[argp], "-duckstats") == 0) duck_stats = true;
+				else if (has_val && strcmp(argv[argp], "-groups") == 0) {
+					std::ifstream fp(argv[++argp]);
+					if (!fp) throw std::runtime_error(std::string("Cannot read ") + argv[argp]);
+					for (auto& line : read_batch(fp)) group_lines.push_back(std::move(line));
+					if (group_lines.empty()) throw std::invalid_argument(std::string("No group in ") + argv[argp]);
+				}
+				else if (has_val && strcmp(argv[argp], "-groupfor") == 0) group_ms = std::stoul(argv[++argp]);
+				else if (strcmp(argv[argp], "-groupstats") == 0) group_stats = true;
+				else if (has_val && strcmp(argv[argp], "-meter") == 0) meter_hz = std::stoul(argv[++argp]);
+				else if (has_val && strcmp(argv[argp], "-meterfor") == 0) meter_ms = std::stoul(argv[++argp]);
+				else if (strcmp(argv[argp], "-meterstats") == 0) meter_stats = true;
+				else if (strcmp(argv[argp], "-sessions") == 0) sessions = true;
+				else if (has_val && strcmp(argv[argp], "-out") == 0) {
+					machine_out = OutFormat::LINES; // so a bad format is reported the machine way too
+					machine_out = parse_out_format(argv[++argp]);
+				}
+				else break;
+			}
+			if (trace) trace_enable();
+			// drop the options so argv[1] is the device kind again
+			argc -= argp - 1;
+			argv += argp - 1;
+		}
+
+		const auto make_backend = [&sim]() -> std::shared_ptr<AudioBackend> {
+			if (sim) return std::make_shared<SimAudioBackend>(sim);
+			return make_native_backend();
+		};
+		// the fake endpoints get their own cache so they never evict the real one
+		const std::string name_cache = name_cache_default_path() + (sim ? ".sim" : "");
+
+		if (enum_workers) {
+			SimConfig cfg;
+			if (sim) cfg = sim->get_config();
+			else cfg.latency = std::chrono::microseconds(100);
+			run_enum_benchmark(cfg, enum_workers);
+			return 0;
+		}
+
+		if (level_bench) {
+			run_level_benchmark();
+			return 0;
+		}
+
+		if (!profile_save.empty() || !profile_load.empty()) {
+			DeviceList devl(make_backend());
+			Profile prof;
+			if (!profile_save.empty()) {
+				prof.capture(devl);
+				if (!prof.save(profile_save)) throw std::runtime_error("Cannot write profile " + profile_save);
+				report_opstats(std::cout, opstats, opstats_file);
+				if (opstats) message_timer(5);
+				return 0;
+			}
+			if (!prof.load(profile_load)) throw std::runtime_error("Cannot read profile " + profile_load);
+			const auto st = prof.apply(devl);
+			if (profile_stats) {
+				remake_terminal();
+				std::cout << "Profile: " << st.endpoints << " device(s), " << st.missing << " missing\n";
+				std::cout << "- Writes: " << st.writes << ", already in place: " << st.skipped << "\n";
+			}
+			report_opstats(std::cout, opstats, opstats_file);
+			if (profile_stats || opstats) message_timer(5);
+			return 0;
+		}
+
+		if (list_aliases) {
+			AliasTable tab;
+			tab.load(alias_file_default_path());
+			remake_terminal();
+			for (const auto& i : tab.get_all()) std::cout << "@" << i.first << "\t" << i.second << "\n";
+			message_timer(10);
+			return 0;
+		}
+
+		if (read_published) {
+			const StateMap map = StateMap::open(state_name);
+			std::vector<PublishedDevice> pub;
+			if (!state_read(map.get(), pub)) throw std::runtime_error("Nothing published yet, or the publisher is busy: try again");
+			std::vector<DeviceState> vec;
+			for (auto& i : pub) vec.push_back(std::move(i.state));
+			remake_terminal();
+			std::cout << format_states(machine_out == OutFormat::NONE ? OutFormat::LINES : machine_out, vec);
+			message_timer(5);
+			return 0;
+		}
+
+		// its own backend: the registry of the publisher and the one of the resident instance each want the notifications
+		std::unique_ptr<StatePublisher> publisher;
+		if (publish_hz) publisher = std::make_unique<StatePublisher>(make_backend(), state_name, std::chrono::microseconds(1000000 / publish_hz), publish_peaks);
+
+		if (publish_hz && !daemon && group_lines.empty()) {
+			if (publish_ms) std::this_thread::sleep_for(std::chrono::milliseconds(publish_ms));
+			else while (true) std::this_thread::sleep_for(std::chrono::hours(1));
+			const auto st = publisher->get_stats();
+			remake_terminal();
+			std::cout << "Published: " << st.samples << " sample(s), " << st.writes << " slot write(s), " << st.rebuilds << " device set change(s)\n";
+			message_timer(5);
+			return 0;
+		}
+
+		// same as the publisher, the endpoints of the groups keep their own notifications
+		std::unique_ptr<GroupSet> groups;
+		if (!group_lines.empty()) {
+			DeviceList devl(make_backend());
+			devl.set_name_cache(name_cache);
+			std::vector<GroupDef> defs;
+			for (const auto& line : group_lines) defs.push_back(parse_group(devl, line));
+			groups = std::make_unique<GroupSet>(std::move(defs));
+		}
+
+		if (groups && !daemon) {
+			if (group_ms) std::this_thread::sleep_for(std::chrono::milliseconds(group_ms));
+			else while (true) std::this_thread::sleep_for(std::chrono::hours(1));
+			if (group_stats) {
+				const auto st = groups->get_stats();
+				remake_terminal();
+				std::cout << "Groups: " << st.changes << " change(s) propagated, " << st.echoes << " echo(es) dropped, " << st.coalesced << " coalesced\n";
+				std::cout << "- Writes: " << st.writes << ", failed: " << st.errors << "\n";
+				std::cout << "- Latency (us): avg " << st.latency_avg_us << ", p50 " << st.latency_p50_us << ", p99 " << st.latency_p99_us << ", max " << st.latency_max_us << "\n";
+				message_timer(5);
+			}
+			return 0;
+		}
+
+		if (daemon) {
+			CommandServer srv(make_backend(), std::chrono::microseconds(1000000 / max_rate));
+			srv.load_aliases(alias_file_default_path());
+			srv.run(ipc_default_name());
+			return 0;
+		}
+
+		if (daemon_stats) {
+			std::string reply;
+			if (!forward_command({ "-stats" }, reply)) throw std::runtime_error("No resident instance");
+			unsigned long long req = 0, wr = 0, noop = 0, err = 0;
+			if (sscanf(reply.c_str(), "OK %llu %llu %llu %llu", &req, &wr, &noop, &err) != 4) throw std::runtime_error(reply);
+			if (!opstats_file.empty()) {
+				// the resident instance may run from another directory
+				if (!forward_command({ "-opstats", std::filesystem::absolute(opstats_file).string() }, reply) || reply != "OK") throw std::runtime_error(reply);
+			}
+			remake_terminal();
+			std::cout << "Resident volume changes: " << req << " request(s), " << wr << " write(s), " << noop << " no-op(s), " << err << " error(s)\n";
+			message_timer(5);
+			return 0;
+		}
+
+		const std::vector<std::string> args(argv + 1, argv + argc);
+
+		if (!alias_name.empty()) {
+			DeviceList devl(make_backend());
+			devl.set_name_cache(name_cache);
+			const Device dev = select_device(devl, parse_target(args));
+
+			const std::string path = alias_file_default_path();
+			AliasTable tab;
+			tab.load(path);
+			tab.set(alias_name, dev.get_id());
+			if (!tab.save(path)) throw std::runtime_error("Cannot write " + path);
+			return 0;
+		}
+
+		if (machine_out != OutFormat::NONE) {
+			const int code = run_machine(make_backend, name_cache, args);
+			if (trace) print_trace(std::cerr, started); // stdout is for the result
+			report_opstats(std::cerr, opstats, opstats_file);
+			return code;
+		}
+
+		if (meter_hz) {
+			DeviceList devl(make_backend());
+			devl.set_name_cache(name_cache);
+			run_meter(devl, split_batch(args), meter_hz, meter_ms, meter_stats);
+			report_opstats(std::cout, opstats, opstats_file);
+			if (opstats) message_timer(5);
+			return 0;
+		}
+
+		if (!duck_spec.empty() || !duck_rules.empty()) {
+			if (!duck_spec.empty()) duck_rules.emplace_back(DuckRule::parse(duck_spec), split_batch(args));
+			DeviceList devl(make_backend());
+			devl.set_name_cache(name_cache);
+			run_ducking(devl, duck_rules, duck_ms, duck_stats);
+			report_opstats(std::cout, opstats, opstats_file);
+			if (opstats) message_timer(5);
+			return 0;
+		}
+
+		if (sessions) {
+			DeviceList devl(make_backend());
+			devl.set_name_cache(name_cache);
+			list_sessions(devl, split_batch(args));
+			report_opstats(std::cout, opstats, opstats_file);
+			message_timer(5);
+			return 0;
+		}
+
+		if (!batch_file.empty() || std::find(args.begin(), args.end(), ";") != args.end()) {
+			std::vector<std::vector<std::string>> ops;
+			if (batch_file.empty()) ops = split_batch(args);
+			else if (batch_file == "-") ops = read_batch(std::cin);
+			else {
+				std::ifstream fp(batch_file);
+				if (!fp) throw std::runtime_error("Cannot open " + batch_file);
+				ops = read_batch(fp);
+			}
+
+			if (timeout_ms && fade.length.count() > 0) throw std::invalid_argument("-timeout cannot be used with -fade");
+			std::vector<std::string> errors;
+			RampEngine ramp;
+			if (timeout_ms) errors = run_batch_async(make_backend(), ops, std::chrono::milliseconds(timeout_ms));
+			else {
+				DeviceList devl(make_backend());
+				devl.set_name_cache(name_cache);
+				errors = run_batch(devl, ops, &ramp, fade);
+			}
+			ramp.wait_idle();
+			if (fade_stats) print_ramp_stats(ramp);
+			if (trace) print_trace(std::cout, started);
+			report_opstats(std::cout, opstats, opstats_file);
+
+			bool failed = false;
+			for (const auto& i : errors) failed |= !i.empty();
+			if (failed) {
+				remake_terminal();
+				for (size_t a = 0; a < ops.size(); ++a) {
+					std::cout << "[" << a << "]";
+					for (const auto& i : ops[a]) std::cout << " " << i;
+					std::cout << ": " << (errors[a].empty() ? "OK" : errors[a]) << "\n";
+				}
+			}
+			if (failed || fade_stats || trace || opstats) message_timer(5);
+			return 0;
+		}
+
 		if (argc < 4) {
 			remake_terminal();
 			std::cout << "Invalid parameters. Try -help.\n";
@@ -63,86 +460,102 @@ int main(int argc, char* argv[])
 			return 0;
 		}
 
-		const bool is_device_mic = (strcmp(argv[1], "OUT") != 0);
-		const std::string device_search = argv[2];
-		const std::bitset<6> flags = {
-			(((uint32_t)(strchr(argv[3], 'M') != nullptr))     ) | // mute
-			(((uint32_t)(strchr(argv[3], 'm') != nullptr)) << 1) | // unmute
-			(((uint32_t)(strchr(argv[3], 'T') != nullptr)) << 2) | // toggle mute
-			(((uint32_t)(strchr(argv[3], 'i') != nullptr)) << 3) | // increase vol
-			(((uint32_t)(strchr(argv[3], 'd') != nullptr)) << 4) | // decrease vol
-			(((uint32_t)(strchr(argv[3], 's') != nullptr)) << 5)   // set vol
-		};
-		const float device_change = (argc > 4 ? std::stof(argv[4]) : -1.0f);
+		const Command cmd = parse_command(args);
 
 #ifdef _DEBUG
 		std::cout << "Parameters read:\n";
-		std::cout << "- Mic? " << (is_device_mic ? "Yes" : "No") << "\n";
-		std::cout << "- Search for? " << device_search << "\n";
-		std::cout << "- Flags? " << flags << "\n";
-		std::cout << "- Volume (optional)? " << device_change << "\n";
+		std::cout << "- Mic? " << (cmd.is_device_mic ? "Yes" : "No") << "\n";
+		std::cout << "- Search for? " << cmd.device_search << "\n";
+		std::cout << "- Flags? " << cmd.flags << "\n";
+		std::cout << "- Volume (optional)? " << cmd.device_change << "\n";
+		std::cout << "- App (optional)? " << cmd.app_search << "\n";
 #endif
 
-		DeviceList devl;
-		Device dev = is_device_mic ?
-			((device_search.empty() || device_search.find('*') == 0) ? devl.get_default_rec(AudioType::CONSOLE) : devl.get_rec(device_search)) :
-			((device_search.empty() || device_search.find('*') == 0) ? devl.get_default_play(AudioType::CONSOLE) : devl.get_play(device_search));
-
-#ifdef _DEBUG
-		std::cout << "Device selected: " << dev.get_friendly_name() << std::endl;
-#endif
-
-		if (flags[2]) { // toggle mute
-			dev.set_mute(!dev.get_mute());
-		}
-		else if (flags[0]) { // mute
-			dev.set_mute(true);
-		}
-		else if (flags[1]) { // unmute
-			dev.set_mute(false);
+		if (load_runs) {
+			run_loadtest(args, load_runs, load_conns);
+			return 0;
 		}
 
-		if (flags[5]) { // set volume
-			if (device_change < 0.0f || device_change > 1.0f) {
-				remake_terminal();
-				std::cout << "Invalid volume\n";
-				message_timer(5);
+		if (client) {
+			std::string reply;
+			if (forward_command(args, reply)) {
+				if (reply != "OK") throw std::runtime_error(reply.compare(0, 4, "ERR ") == 0 ? reply.substr(4) : reply);
 				return 0;
 			}
-			dev.set_volume(device_change);
+			// no resident instance, just do it here
 		}
-		else if (flags[3]) { // increase
-			if (device_change < 0.0f || device_change > 1.0f) {
-				remake_terminal();
-				std::cout << "Invalid volume\n";
-				message_timer(5);
-				return 0;
-			}
-			const float sum = std::min(1.0f, device_change + dev.get_volume());
-			dev.set_volume(sum);
+
+		if (bench_runs) {
+			run_benchmark(make_backend, name_cache, cmd, bench_runs);
+			return 0;
 		}
-		else if (flags[4]) { // decrease
-			if (device_change < 0.0f || device_change > 1.0f) {
-				remake_terminal();
-				std::cout << "Invalid volume\n";
-				message_timer(5);
-				return 0;
+
+		if (timeout_ms) {
+			if (fade.length.count() > 0) throw std::invalid_argument("-timeout cannot be used with -fade");
+			const auto errors = run_batch_async(make_backend(), { args }, std::chrono::milliseconds(timeout_ms));
+			if (trace) print_trace(std::cout, started);
+			report_opstats(std::cout, opstats, opstats_file);
+			if (!errors.front().empty()) throw std::runtime_error(errors.front()); // waits with the error
+			if (trace || opstats) message_timer(5);
+			return 0;
+		}
+
+		DeviceList devl(make_backend());
+		devl.set_name_cache(name_cache);
+		const auto dev = std::make_shared<Device>(select_device(devl, cmd));
+
+#ifdef _DEBUG
+		std::cout << "Device selected: " << dev->get_friendly_name() << std::endl;
+#endif
+
+		bool shown = false;
+		{
+			TraceScope t("apply");
+			if (!cmd.app_search.empty()) {
+				// a single command: one enumeration, no need to follow the sessions
+				apply_session_command(SessionTable(dev, false), cmd);
+			}
+			else if (fade.length.count() > 0) {
+				RampEngine ramp;
+				apply_command(dev, cmd, &ramp, fade);
+				ramp.wait_idle();
+				if (fade_stats) print_ramp_stats(ramp);
+				shown = fade_stats;
 			}
-			const float sum = std::max(0.0f, - device_change + dev.get_volume());
-			dev.set_volume(sum);
+			else apply_command(*dev, cmd);
 		}
+		if (trace) print_trace(std::cout, started);
+		report_opstats(std::cout, opstats, opstats_file);
+		if (shown || trace || opstats) message_timer(5);
 
 #ifdef _DEBUG
-		std::cout << "- Muted: " << (dev.get_mute() ? "Yes" : "No") << std::endl;
-		std::cout << "- Volume: " << (dev.get_volume() * 100.0f) << "%" << std::endl;
+		std::cout << "- Muted: " << (dev->get_mute() ? "Yes" : "No") << std::endl;
+		std::cout << "- Volume: " << (dev->get_volume() * 100.0f) << "%" << std::endl;
 #endif
 	}
+	catch (const std::invalid_argument& e) {
+		if (machine_out != OutFormat::NONE) {
+			std::cout << format_error(machine_out, e.what());
+			return static_cast<int>(ExitCode::USAGE);
+		}
+		remake_terminal();
+		std::cout << "Exception: " << e.what() << std::endl;
+		message_timer(5);
+	}
 	catch (const std::exception& e) {
+		if (machine_out != OutFormat::NONE) {
+			std::cout << format_error(machine_out, e.what());
+			return static_cast<int>(ExitCode::FAILED);
+		}
 		remake_terminal();
 		std::cout << "Exception: " << e.what() << std::endl;
 		message_timer(5);
 	}
 	catch (...) {
+		if (machine_out != OutFormat::NONE) {
+			std::cout << format_error(machine_out, "UNHANDLED");
+			return static_cast<int>(ExitCode::FAILED);
+		}
 		remake_terminal();
 		std::cout << "Exception: UNHANDLED" << std::endl;
 		message_timer(5);
@@ -156,8 +569,405 @@ int main(int argc, char* argv[])
 	return 0;
 }
 
+void print_stats(const char* name, std::vector<double>& v)
+{
+	if (v.empty()) return;
+	std::sort(v.begin(), v.end());
+	double sum = 0;
+	for (const auto& i : v) sum += i;
+
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%-9s %10.2f %10.2f %10.2f %10.2f %10.2f\n", name,
+		v.front(), sum / v.size(), v[v.size() / 2], v[std::min(v.size() - 1, (v.size() * 99) / 100)], v.back());
+	std::cout << buf;
+}
+
+void run_benchmark(const std::function<std::shared_ptr<AudioBackend>()>& make_backend, const std::string& name_cache, const Command& cmd, const size_t runs)
+{
+	using clock = std::chrono::steady_clock;
+	const char* names[] = { "enumerate", "match", "apply", "total" };
+	std::vector<double> times[4];
+
+	for (auto& i : times) i.reserve(runs);
+
+	for (size_t r = 0; r < runs; ++r) {
+		const auto t0 = clock::now();
+		DeviceList devl(make_backend());
+		devl.set_name_cache(name_cache);
+		const auto t1 = clock::now();
+		const auto dev = std::make_shared<Device>(select_device(devl, cmd));
+		const auto t2 = clock::now();
+		if (cmd.app_search.empty()) apply_command(*dev, cmd);
+		else apply_session_command(SessionTable(dev, false), cmd);
+		const auto t3 = clock::now();
+
+		times[0].push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+		times[1].push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+		times[2].push_back(std::chrono::duration<double, std::micro>(t3 - t2).count());
+		times[3].push_back(std::chrono::duration<double, std::micro>(t3 - t0).count());
+	}
+
+	remake_terminal();
+	std::cout << "Benchmark: " << runs << " run(s), times in microseconds\n";
+	std::cout << "phase        min        avg        p50        p99        max\n";
+	for (size_t a = 0; a < 4; ++a) print_stats(names[a], times[a]);
+	message_timer(5);
+}
+
+void run_enum_benchmark(SimConfig cfg, const size_t workers)
+{
+	using clock = std::chrono::steady_clock;
+	const size_t reps = 5;
+
+	remake_terminal();
+	std::cout << "Enumeration: " << cfg.latency.count() << " us per call, " << workers << " worker(s), median of " << reps << ", times in microseconds\n";
+	std::cout << "endpoints   open (1)  open (" << workers << ")   speedup   names (1)  names (" << workers << ")   speedup   errors\n";
+
+	for (size_t n = 1; n <= 256; n *= 2) {
+		cfg.num_play = n;
+		cfg.num_rec = 0;
+		const auto world = std::make_shared<SimWorld>(cfg);
+		DeviceList devl(std::make_shared<SimAudioBackend>(world));
+		const SimAudioBackend names_backend(world);
+		std::vector<double> times[4];
+		size_t errors = 0;
+
+		for (size_t r = 0; r < reps; ++r) {
+			for (size_t k = 0; k < 4; ++k) {
+				const size_t w = (k % 2 == 0 ? 1 : workers);
+				const auto t0 = clock::now();
+				if (k < 2) {
+					devl.set_workers(w);
+					for (const auto& i : devl.open_all(AudioFlow::PLAY)) errors += !i.error.empty();
+				}
+				else {
+					// cold name index: every name is read
+					NameIndex index;
+					index.refresh(names_backend, AudioFlow::PLAY, w);
+				}
+				times[k].push_back(std::chrono::duration<double, std::micro>(clock::now() - t0).count());
+			}
+		}
+
+		double med[4];
+		for (size_t k = 0; k < 4; ++k) {
+			std::sort(times[k].begin(), times[k].end());
+			med[k] = times[k][reps / 2];
+		}
+		char buf[160];
+		snprintf(buf, sizeof(buf), "%9zu %10.1f %10.1f %8.2fx %11.1f %10.1f %8.2fx %8zu\n", n,
+			med[0], med[1], med[0] / med[1], med[2], med[3], med[2] / med[3], errors);
+		std::cout << buf;
+	}
+	message_timer(5);
+}
+
+void run_level_benchmark()
+{
+	using clock = std::chrono::steady_clock;
+	// a channel vector up to long automation buffers
+	const size_t sizes[] = { 8, 64, 1024, 65536, 1 << 20 };
+	const size_t per_size = 1 << 24;
+
+	remake_terminal();
+	std::cout << "Level conversion: ns per value (Mvalues/s), " << per_size << " value(s) per size\n";
+	std::cout << "   size    db->scalar (ref)   db->scalar (kernel)    scalar->db (ref)   scalar->db (kernel)   max err\n";
+
+	for (const size_t n : sizes) {
+		std::vector<float> db(n), sc(n), out(n);
+		for (size_t a = 0; a < n; ++a) db[a] = -96.0f + 120.0f * a / n;
+		const size_t reps = std::max<size_t>(1, per_size / n);
+		double ns[4];
+		float sink = 0;
+
+		for (size_t k = 0; k < 4; ++k) {
+			const float* in = (k < 2 ? db.data() : sc.data());
+			const auto t0 = clock::now();
+			for (size_t r = 0; r < reps; ++r) {
+				switch (k) {
+				case 0: for (size_t a = 0; a < n; ++a) out[a] = powf(10.0f, in[a] / 20.0f); break;
+				case 1: db_to_scalar(in, out.data(), n); break;
+				case 2: for (size_t a = 0; a < n; ++a) out[a] = 20.0f * log10f(in[a]); break;
+				case 3: scalar_to_db(in, out.data(), n); break;
+				}
+				sink += out[r % n];
+			}
+			ns[k] = std::chrono::duration<double, std::nano>(clock::now() - t0).count() / (reps * n);
+			if (k == 1) sc = out;
+		}
+
+		// the kernel against the reference, relative for scalars and in dB for levels
+		float err = 0;
+		for (size_t a = 0; a < n; ++a) {
+			const float s = powf(10.0f, db[a] / 20.0f);
+			err = std::max(err, fabsf(sc[a] - s) / s);
+		}
+		for (size_t a = 0; a < n; ++a) err = std::max(err, fabsf(out[a] - 20.0f * log10f(sc[a])));
+
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%7zu %8.2f (%7.1f)   %8.2f (%7.1f)   %8.2f (%7.1f)   %8.2f (%7.1f)   %.1e%s\n", n,
+			ns[0], 1e3 / ns[0], ns[1], 1e3 / ns[1], ns[2], 1e3 / ns[2], ns[3], 1e3 / ns[3], err, sink == 12345.0f ? " " : "");
+		std::cout << buf;
+	}
+	message_timer(5);
+}
+
+void run_meter(const DeviceList& devl, const std::vector<std::vector<std::string>>& targets, const size_t hz, const size_t ms, const bool stats)
+{
+	using clock = std::chrono::steady_clock;
+	if (hz > 1000) throw std::invalid_argument("Invalid meter rate");
+
+	PeakMeter meter(std::chrono::microseconds(1000000 / hz));
+	std::vector<std::string> names;
+	for (const auto& i : targets) {
+		const auto dev = std::make_shared<Device>(select_device(devl, parse_target(i)));
+		names.push_back(dev->get_friendly_name());
+		meter.add(dev);
+	}
+
+	remake_terminal();
+	// one line per sample: time (ms), device, one peak per channel. Lines starting with # are not samples.
+	for (size_t a = 0; a < names.size(); ++a) std::cout << "# " << a << "\t" << names[a] << "\n";
+
+	const auto drain = [&meter] {
+		std::string out;
+		char buf[64];
+		PeakSample s;
+		while (meter.pop(s)) {
+			snprintf(buf, sizeof(buf), "%.3f\t%u", s.time_us / 1e3, s.source);
+			out += buf;
+			for (uint32_t c = 0; c < s.channels; ++c) {
+				snprintf(buf, sizeof(buf), "\t%.4f", s.peak[c]);
+				out += buf;
+			}
+			out += '\n';
+		}
+		std::cout << out << std::flush;
+	};
+
+	meter.start();
+	const auto until = clock::now() + std::chrono::milliseconds(ms);
+	while (ms == 0 || clock::now() < until) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		drain();
+	}
+	meter.stop();
+	drain();
+
+	if (!stats) return;
+	const auto st = meter.get_stats();
+	std::cout << "# ticks " << st.ticks << ", dropped " << st.dropped << ", jitter " << st.jitter_avg_us << " us average, busy " << (st.busy_ratio * 100.0) << "%\n";
+	for (size_t a = 0; a < st.sources.size(); ++a) {
+		const auto& i = st.sources[a];
+		std::cout << "# " << a << "\t" << i.polls << " poll(s), " << i.poll_avg_us << " us average, " << i.poll_max_us << " us max, " << i.errors << " error(s)\n";
+	}
+}
+
+void run_ducking(const DeviceList& devl, const std::vector<std::pair<DuckRule, std::vector<std::vector<std::string>>>>& rules, const size_t ms, const bool stats)
+{
+	DuckEngine engine;
+	// a device named by several rules is opened once, so is its session table
+	std::map<std::pair<bool, std::string>, std::shared_ptr<Device>> opened;
+	const auto open = [&](const Command& cmd) {
+		auto& dev = opened[{ cmd.is_device_mic, cmd.device_search }];
+		if (!dev) dev = std::make_shared<Device>(select_device(devl, cmd));
+		return dev;
+	};
+
+	for (const auto& r : rules) {
+		if (r.second.size() < 2) throw std::invalid_argument("A duck rule needs a capture device and at least one device to lower");
+		const size_t rule = engine.add(open(parse_target(r.second[0])), r.first);
+		for (size_t a = 1; a < r.second.size(); ++a) {
+			const auto& t = r.second[a];
+			if (t.size() > 2 && t[0] == "-app") {
+				const std::vector<std::string> rest(t.begin() + 2, t.end());
+				engine.add_target(rule, open(parse_target(rest)), t[1]);
+			}
+			else engine.add_target(rule, open(parse_target(t)));
+		}
+	}
+
+	engine.start();
+	if (ms) std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	else while (true) std::this_thread::sleep_for(std::chrono::hours(1));
+	engine.stop();
+
+	if (!stats) return;
+	const auto st = engine.get_stats();
+	remake_terminal();
+	std::cout << "Ducking: " << st.ticks << " tick(s), jitter " << st.jitter_avg_us << " us average, busy " << (st.busy_ratio * 100.0) << "%\n";
+	for (size_t a = 0; a < st.rules.size(); ++a) {
+		const auto& i = st.rules[a];
+		std::cout << "- Rule " << a << ": " << i.triggers << " trigger(s), " << i.writes << " write(s), " << i.errors << " error(s)\n";
+		if (i.triggers) std::cout << "  Reaction: " << i.reaction_avg_us << " us average, " << i.reaction_p50_us << " p50, " << i.reaction_p99_us << " p99, " << i.reaction_max_us << " max\n";
+	}
+	message_timer(10);
+}
+
+int run_machine(const std::function<std::shared_ptr<AudioBackend>()>& make_backend, const std::string& name_cache, const std::vector<std::string>& args)
+{
+	const auto fail = [](const ExitCode code, const std::string& why) {
+		std::cout << format_error(machine_out, why);
+		return static_cast<int>(code);
+	};
+
+	// list | get <kind> <name> | set <kind> <name> <flags> (number)
+	const std::string verb = args.empty() ? "" : args[0];
+	const std::vector<std::string> rest(args.begin() + (args.empty() ? 0 : 1), args.end());
+	Command cmd;
+	try {
+		if (verb == "get") cmd = parse_target(rest);
+		else if (verb == "set") cmd = parse_command(rest);
+		else if (verb != "list") throw std::invalid_argument("Expected list, get or set");
+	}
+	catch (const std::exception& e) {
+		return fail(ExitCode::USAGE, e.what());
+	}
+
+	try {
+		DeviceList devl(make_backend());
+		devl.set_name_cache(name_cache);
+		if (verb == "list") {
+			std::cout << format_states(machine_out, read_all_states(devl));
+			return static_cast<int>(ExitCode::OK);
+		}
+
+		std::shared_ptr<Device> dev;
+		try {
+			dev = std::make_shared<Device>(select_device(devl, cmd));
+		}
+		catch (const std::exception& e) {
+			return fail(ExitCode::NO_DEVICE, e.what());
+		}
+
+		if (verb == "set") {
+			TraceScope t("apply");
+			if (cmd.app_search.empty()) apply_command(*dev, cmd);
+			else apply_session_command(SessionTable(dev, false), cmd);
+		}
+
+		const AudioFlow f = cmd.is_device_mic ? AudioFlow::REC : AudioFlow::PLAY;
+		std::cout << format_states(machine_out, { read_state(*dev, f, dev->get_id() == get_default_id(devl, f)) });
+		return static_cast<int>(ExitCode::OK);
+	}
+	catch (const std::exception& e) {
+		return fail(ExitCode::FAILED, e.what());
+	}
+}
+
+void list_sessions(const DeviceList& devl, const std::vector<std::vector<std::string>>& targets)
+{
+	remake_terminal();
+	// per device: a "#" line with its name, then pid, process, volume, mute and session identifier per session
+	for (const auto& i : targets) {
+		const auto dev = std::make_shared<Device>(select_device(devl, parse_target(i)));
+		const SessionTable table(dev, false);
+		std::cout << "# " << dev->get_friendly_name() << "\n";
+
+		auto all = table.get_all();
+		std::sort(all.begin(), all.end(), [](const std::shared_ptr<BackendSession>& a, const std::shared_ptr<BackendSession>& b) { return a->get_pid() < b->get_pid(); });
+
+		char buf[64];
+		for (const auto& s : all) {
+			snprintf(buf, sizeof(buf), "%u\t", s->get_pid());
+			std::cout << buf << (s->get_process_name().empty() ? "(system)" : s->get_process_name());
+			snprintf(buf, sizeof(buf), "\t%.4f\t%d\t", s->get_volume(), s->get_mute() ? 1 : 0);
+			std::cout << buf << s->get_session_id() << "\n";
+		}
+	}
+}
+
+bool forward_command(const std::vector<std::string>& args, std::string& reply)
+{
+	try {
+		IpcConnection conn = ipc_connect(ipc_default_name());
+		return conn.write_line(join_request(args)) && conn.read_line(reply);
+	}
+	catch (...) {
+		return false;
+	}
+}
+
+void run_loadtest(const std::vector<std::string>& args, const size_t runs, const size_t conns)
+{
+	using clock = std::chrono::steady_clock;
+	const std::string line = join_request(args);
+
+	std::vector<IpcConnection> links;
+	for (size_t c = 0; c < conns; ++c) links.push_back(ipc_connect(ipc_default_name()));
+
+	std::vector<std::vector<double>> times(conns);
+	std::vector<std::thread> thrs;
+	std::atomic<size_t> errors{ 0 };
+
+	const auto t0 = clock::now();
+	for (size_t c = 0; c < conns; ++c) {
+		thrs.emplace_back([&, c] {
+			const size_t mine = runs / conns + (c < runs % conns ? 1 : 0);
+			std::string reply;
+			times[c].reserve(mine);
+			for (size_t r = 0; r < mine; ++r) {
+				const auto s = clock::now();
+				if (!links[c].write_line(line) || !links[c].read_line(reply)) { errors += mine - r; return; }
+				times[c].push_back(std::chrono::duration<double, std::micro>(clock::now() - s).count());
+				if (reply != "OK") ++errors;
+			}
+		});
+	}
+	for (auto& i : thrs) i.join();
+	const double secs = std::chrono::duration<double>(clock::now() - t0).count();
+
+	std::vector<double> all;
+	for (auto& i : times) all.insert(all.end(), i.begin(), i.end());
+
+	remake_terminal();
+	std::cout << "Load test: " << runs << " command(s) over " << conns << " connection(s) in " << secs << " s\n";
+	std::cout << "- Throughput: " << (all.size() / secs) << " commands/s\n";
+	std::cout << "- Errors: " << errors.load() << "\n";
+	std::cout << "phase        min        avg        p50        p99        max\n";
+	print_stats("roundtrip", all);
+	message_timer(5);
+}
+
+void print_trace(std::ostream& out, const std::chrono::steady_clock::time_point started)
+{
+	const double total = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+	remake_terminal();
+
+	// a phase includes the ones it waited on (match includes the enumerate it needed), so they do not add up to the total
+	char buf[128];
+	snprintf(buf, sizeof(buf), "%-11s %6s %12s %12s\n", "phase", "count", "total us", "max us");
+	out << buf;
+	for (const auto& i : trace_get()) {
+		snprintf(buf, sizeof(buf), "%-11s %6llu %12.1f %12.1f\n", i.name.c_str(), static_cast<unsigned long long>(i.count), i.total_us, i.max_us);
+		out << buf;
+	}
+	snprintf(buf, sizeof(buf), "%-11s %6s %12.1f\n", "total", "", total);
+	out << buf;
+}
+
+void report_opstats(std::ostream& out, const bool print, const std::string& file)
+{
+	if (print) {
+		remake_terminal();
+		out << format_opstats(opstats_get());
+	}
+	if (!file.empty() && !dump_opstats(file)) throw std::runtime_error("Cannot write " + file);
+}
+
+void print_ramp_stats(const RampEngine& ramp)
+{
+	const auto st = ramp.get_stats();
+	remake_terminal();
+	std::cout << "Ramps: " << st.ticks << " tick(s), " << st.writes << " write(s)\n";
+	std::cout << "- Jitter: " << st.jitter_avg_us << " us average, " << st.jitter_max_us << " us max\n";
+	std::cout << "- Busy: " << (st.busy_ratio * 100.0) << "% of the ramp thread\n";
+}
+
 bool remake_terminal()
 {
+	if (machine_out != OutFormat::NONE) return false;
+#ifdef _WIN32
 	static bool result = false;
 	if (result) return true;
 
@@ -199,10 +1009,14 @@ bool remake_terminal()
 	result = true;
 
 	return result;
+#else
+	return true;
+#endif
 }
 
 void message_timer(const unsigned int t)
 {
+	if (machine_out != OutFormat::NONE) return;
 	std::cout << "\nClosing app in " << t << " second(s)..." << std::endl;
 	std::this_thread::sleep_for(std::chrono::seconds(t));
 	return;
@@ -0,0 +1,92 @@
+#include "AliasTable.h"
+#include "NameIndex.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <stdlib.h>
+
+static bool _blank(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool AliasTable::load(const std::string& path)
+{
+    std::ifstream fp(path);
+    if (!fp) return false;
+
+    std::unordered_map<std::string, std::string> tmp;
+    std::string line;
+    while (std::getline(fp, line)) {
+        size_t p = 0;
+        while (p < line.size() && _blank(line[p])) ++p;
+        if (p == line.size() || line[p] == '#') continue;
+
+        size_t end = p;
+        while (end < line.size() && !_blank(line[end])) ++end;
+        size_t id = end;
+        while (id < line.size() && _blank(line[id])) ++id;
+        size_t id_end = line.size();
+        while (id_end > id && _blank(line[id_end - 1])) --id_end;
+        if (id == id_end) continue; // an alias without an ID
+
+        tmp[fold_name(line.substr(p, end - p))] = line.substr(id, id_end - id);
+    }
+
+    ids = std::move(tmp);
+    return true;
+}
+
+bool AliasTable::save(const std::string& path) const
+{
+    std::ofstream fp(path, std::ios::trunc);
+    if (!fp) return false;
+
+    fp << "# <alias> <endpoint ID>, use it as @<alias> in place of a device name\n";
+    for (const auto& i : get_all()) fp << i.first << ' ' << i.second << '\n';
+    return static_cast<bool>(fp);
+}
+
+const std::string* AliasTable::find(const std::string& alias) const
+{
+    const auto it = ids.find(fold_name(alias));
+    return it == ids.end() ? nullptr : &it->second;
+}
+
+void AliasTable::set(const std::string& alias, const std::string& id)
+{
+    if (alias.empty() || std::any_of(alias.begin(), alias.end(), _blank)) throw std::invalid_argument("Invalid alias: " + alias);
+    if (id.empty() || std::any_of(id.begin(), id.end(), [](const char c) { return c == '\r' || c == '\n'; })) throw std::invalid_argument("Invalid endpoint ID");
+    ids[fold_name(alias)] = id;
+}
+
+bool AliasTable::remove(const std::string& alias)
+{
+    return ids.erase(fold_name(alias)) != 0;
+}
+
+std::vector<std::pair<std::string, std::string>> AliasTable::get_all() const
+{
+    std::vector<std::pair<std::string, std::string>> vec(ids.begin(), ids.end());
+    std::sort(vec.begin(), vec.end());
+    return vec;
+}
+
+size_t AliasTable::size() const
+{
+    return ids.size();
+}
+
+std::string alias_file_default_path()
+{
+#ifdef _WIN32
+    const char* base = getenv("APPDATA");
+    return std::string(base ? base : ".") + "\\SoundCtl.aliases";
+#else
+    const char* base = getenv("XDG_CONFIG_HOME");
+    if (base) return std::string(base) + "/soundctl.aliases";
+    base = getenv("HOME");
+    return std::string(base ? base : "/tmp") + "/.config/soundctl.aliases";
+#endif
+}
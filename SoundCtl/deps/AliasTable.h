@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Short user names for endpoint IDs, kept in a text file the user can edit: one "<alias> <endpoint ID>" per line,
+// blank lines and lines starting with # are skipped. Aliases are case-insensitive (see fold_name) and hold no blanks.
+// The whole file goes into one hash map, so a lookup costs the same whatever the number of aliases or endpoints.
+class AliasTable {
+	std::unordered_map<std::string, std::string> ids; // by folded alias
+public:
+	// false if the file is missing. Malformed lines are skipped, the rest still loads.
+	bool load(const std::string&);
+	// sorted by alias, comments are not kept
+	bool save(const std::string&) const;
+
+	// endpoint ID of that alias, nullptr if there is none
+	const std::string* find(const std::string&) const;
+	// Throws std::invalid_argument if the alias is empty or has blanks
+	void set(const std::string&, const std::string&);
+	bool remove(const std::string&);
+
+	// (alias, ID) pairs sorted by alias
+	std::vector<std::pair<std::string, std::string>> get_all() const;
+	size_t size() const;
+};
+
+std::string alias_file_default_path();
@@ -0,0 +1,184 @@
+#include "AsyncDevice.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <objbase.h>
+#endif
+
+const char* async_status_name(const AsyncStatus s)
+{
+    switch (s) {
+    case AsyncStatus::PENDING: return "pending";
+    case AsyncStatus::OK: return "ok";
+    case AsyncStatus::FAILED: return "failed";
+    case AsyncStatus::TIMED_OUT: return "timed out";
+    case AsyncStatus::CANCELLED: return "cancelled";
+    }
+    return "?";
+}
+
+bool AsyncState::finish(const AsyncStatus s, const std::string& why)
+{
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        if (status != AsyncStatus::PENDING) return false;
+        status = s;
+        error = why;
+    }
+    cond.notify_all();
+    return true;
+}
+
+AsyncStatus AsyncState::wait()
+{
+    std::unique_lock<std::mutex> l(mtx);
+    if (!cond.wait_until(l, deadline, [this] { return status != AsyncStatus::PENDING; })) {
+        status = AsyncStatus::TIMED_OUT;
+        error = started ? "Timed out, the device did not answer" : "Timed out behind other calls to the device";
+    }
+    return status;
+}
+
+AsyncDevice::AsyncDevice(std::function<Device()> opener)
+    : core(std::make_shared<Core>())
+{
+    if (!opener) throw std::invalid_argument("NULL OPENER");
+    core->opener = std::move(opener);
+
+    // detached: a call that never returns must not hold up the owner, the core lives as long as the thread needs it
+    std::thread(&AsyncDevice::_work, core).detach();
+}
+
+AsyncDevice::~AsyncDevice()
+{
+    std::deque<Task> left;
+    {
+        std::lock_guard<std::mutex> l(core->mtx);
+        core->stop = true;
+        left.swap(core->queue);
+    }
+    core->cond.notify_all();
+    for (auto& t : left) t.st->finish(AsyncStatus::CANCELLED, "Cancelled, the device was closed");
+
+    // lets an idle worker release the device before returning, like any other owner would
+    std::unique_lock<std::mutex> l(core->mtx);
+    core->cond.wait(l, [this] { return core->exited || core->busy; });
+}
+
+void AsyncDevice::_submit(std::shared_ptr<AsyncState> st, std::function<void(const std::shared_ptr<Device>&)> run, const std::chrono::milliseconds timeout)
+{
+    st->deadline = std::chrono::steady_clock::now() + timeout;
+    {
+        std::lock_guard<std::mutex> l(core->mtx);
+        core->queue.push_back(Task{ std::move(st), std::move(run) });
+    }
+    core->cond.notify_one();
+}
+
+void AsyncDevice::_work(std::shared_ptr<Core> c)
+{
+#ifdef _WIN32
+    const bool com = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+#endif
+    for (;;) {
+        Task t;
+        {
+            std::unique_lock<std::mutex> l(c->mtx);
+            c->cond.wait(l, [&c] { return c->stop || !c->queue.empty(); });
+            if (c->stop) break;
+            t = std::move(c->queue.front());
+            c->queue.pop_front();
+        }
+
+        {
+            // a caller that gave up (or will before anything could be done) gets nothing run for it
+            std::lock_guard<std::mutex> l(t.st->mtx);
+            if (t.st->status != AsyncStatus::PENDING) continue;
+            if (std::chrono::steady_clock::now() >= t.st->deadline) {
+                t.st->status = AsyncStatus::TIMED_OUT;
+                t.st->error = "Timed out behind other calls to the device";
+                t.st->cond.notify_all();
+                continue;
+            }
+            t.st->started = true;
+        }
+        {
+            std::lock_guard<std::mutex> l(c->mtx);
+            c->busy = true;
+        }
+        c->cond.notify_all(); // an owner going away stops waiting for us
+
+        if (!c->dev && c->open_error.empty()) {
+            try {
+                c->dev = std::make_shared<Device>(c->opener());
+            }
+            catch (const std::exception& e) {
+                c->open_error = e.what();
+            }
+            if (c->open_error.empty() && !c->dev) c->open_error = "Cannot open the device";
+        }
+        if (!c->dev) t.st->finish(AsyncStatus::FAILED, c->open_error);
+        else {
+            try {
+                t.run(c->dev);
+                t.st->finish(AsyncStatus::OK, "");
+            }
+            catch (const std::exception& e) {
+                t.st->finish(AsyncStatus::FAILED, e.what());
+            }
+            catch (...) {
+                t.st->finish(AsyncStatus::FAILED, "Unknown error");
+            }
+        }
+
+        std::lock_guard<std::mutex> l(c->mtx);
+        c->busy = false;
+    }
+    // the device goes on this thread too, where it was used
+    c->dev.reset();
+#ifdef _WIN32
+    if (com) CoUninitialize();
+#endif
+    {
+        std::lock_guard<std::mutex> l(c->mtx);
+        c->exited = true;
+    }
+    c->cond.notify_all();
+}
+
+AsyncOp<std::string> AsyncDevice::open(const std::chrono::milliseconds timeout)
+{
+    return call<std::string>([](const std::shared_ptr<Device>& d) { return d->get_friendly_name(); }, timeout);
+}
+
+AsyncOp<float> AsyncDevice::get_volume(const std::chrono::milliseconds timeout)
+{
+    return call<float>([](const std::shared_ptr<Device>& d) { return d->get_volume(); }, timeout);
+}
+
+AsyncOp<bool> AsyncDevice::set_volume(const float f, const std::chrono::milliseconds timeout)
+{
+    return call<bool>([f](const std::shared_ptr<Device>& d) { d->set_volume(f); return true; }, timeout);
+}
+
+AsyncOp<bool> AsyncDevice::get_mute(const std::chrono::milliseconds timeout)
+{
+    return call<bool>([](const std::shared_ptr<Device>& d) { return d->get_mute(); }, timeout);
+}
+
+AsyncOp<bool> AsyncDevice::set_mute(const bool b, const std::chrono::milliseconds timeout)
+{
+    return call<bool>([b](const std::shared_ptr<Device>& d) { d->set_mute(b); return true; }, timeout);
+}
+
+AsyncOp<std::vector<float>> AsyncDevice::get_levels(const size_t node, const std::chrono::milliseconds timeout)
+{
+    return call<std::vector<float>>([node](const std::shared_ptr<Device>& d) { return d->get_underlying_volume(node).get_levels(); }, timeout);
+}
+
+AsyncOp<bool> AsyncDevice::set_levels(const size_t node, std::vector<float> levels, const std::chrono::milliseconds timeout)
+{
+    return call<bool>([node, levels](const std::shared_ptr<Device>& d) { d->get_underlying_volume(node).set_levels(levels); return true; }, timeout);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DeviceManager.h"
+
+enum class AsyncStatus { PENDING, OK, FAILED, TIMED_OUT, CANCELLED };
+const char* async_status_name(const AsyncStatus);
+
+// Thrown by AsyncOp::get for anything but OK
+class AsyncError : public std::runtime_error {
+public:
+	const AsyncStatus status;
+	AsyncError(const AsyncStatus s, const std::string& what) : std::runtime_error(what), status(s) {}
+};
+
+// Shared between the caller and the worker. Whoever moves status off PENDING first wins: the worker with a result,
+// the caller with a timeout or a cancellation (the result of a call already running is then dropped).
+struct AsyncState {
+	std::mutex mtx;
+	std::condition_variable cond;
+	AsyncStatus status = AsyncStatus::PENDING;
+	bool started = false;
+	std::string error;
+	std::chrono::steady_clock::time_point deadline;
+
+	// caller side, true if it was still pending
+	bool finish(const AsyncStatus, const std::string&);
+	AsyncStatus wait();
+};
+
+template<typename T> struct AsyncValue : AsyncState {
+	T value{};
+};
+
+// One operation handed to an AsyncDevice. wait() never blocks past the deadline given when it was submitted.
+template<typename T> class AsyncOp {
+	std::shared_ptr<AsyncValue<T>> st;
+public:
+	AsyncOp() = default;
+	explicit AsyncOp(std::shared_ptr<AsyncValue<T>> s) : st(std::move(s)) {}
+
+	// Until the result or the deadline, whichever comes first. At the deadline the operation is TIMED_OUT.
+	AsyncStatus wait() { return st->wait(); }
+	// The value, or AsyncError with the reason
+	T get()
+	{
+		const AsyncStatus s = wait();
+		std::lock_guard<std::mutex> l(st->mtx);
+		if (s != AsyncStatus::OK) throw AsyncError(s, st->error);
+		return st->value;
+	}
+	// Not started yet: it never will be. Running: whatever it returns is dropped. Done: nothing changes.
+	void cancel() { st->finish(AsyncStatus::CANCELLED, "Cancelled"); }
+	const std::string& error() const { return st->error; }
+};
+
+// One endpoint driven from its own worker thread, so a device that hangs in a call (a Bluetooth headset going away,
+// an Activate that never returns) only holds up its own operations. Operations on one AsyncDevice run in the order
+// they were submitted; different AsyncDevices run in parallel.
+// Each call has its own timeout, counted from the submission: the time spent behind earlier calls counts too. A call
+// whose deadline passed before the worker got to it is skipped. A call that is running cannot be interrupted (the
+// audio APIs have no way to), its result is dropped and the next ones wait for it.
+// The worker owns the Device: it is opened there (see the constructor) and never touched from another thread.
+// Destroying an AsyncDevice cancels what is queued and waits for an idle worker to release the device; a worker
+// stuck in a call is left to finish on its own, it keeps what it needs alive.
+class AsyncDevice {
+	struct Task {
+		std::shared_ptr<AsyncState> st;
+		std::function<void(const std::shared_ptr<Device>&)> run; // fills in the value, throws on failure
+	};
+	struct Core {
+		std::function<Device()> opener;
+		std::shared_ptr<Device> dev;
+		std::string open_error;
+		std::deque<Task> queue;
+		std::mutex mtx;
+		std::condition_variable cond;
+		bool stop = false;
+		bool busy = false;   // in the opener or an operation
+		bool exited = false;
+	};
+
+	std::shared_ptr<Core> core;
+
+	static void _work(std::shared_ptr<Core>);
+	void _submit(std::shared_ptr<AsyncState>, std::function<void(const std::shared_ptr<Device>&)>, const std::chrono::milliseconds);
+public:
+	// The opener runs on the worker before the first operation (it may hang as well). If it throws, every operation fails with its reason.
+	AsyncDevice(std::function<Device()>);
+	AsyncDevice(const AsyncDevice&) = delete;
+	void operator=(const AsyncDevice&) = delete;
+	~AsyncDevice();
+
+	// Any operation on the device, run on the worker
+	template<typename T> AsyncOp<T> call(std::function<T(const std::shared_ptr<Device>&)> f, const std::chrono::milliseconds timeout)
+	{
+		auto st = std::make_shared<AsyncValue<T>>();
+		AsyncValue<T>* v = st.get();
+		_submit(st, [v, f](const std::shared_ptr<Device>& d) { v->value = f(d); }, timeout);
+		return AsyncOp<T>(std::move(st));
+	}
+
+	// Opens the device and its property store: the friendly name
+	AsyncOp<std::string> open(const std::chrono::milliseconds);
+	AsyncOp<float> get_volume(const std::chrono::milliseconds);
+	AsyncOp<bool> set_volume(const float, const std::chrono::milliseconds);
+	AsyncOp<bool> get_mute(const std::chrono::milliseconds);
+	AsyncOp<bool> set_mute(const bool, const std::chrono::milliseconds);
+	// Channel levels (scalars) of the n-th topology volume control
+	AsyncOp<std::vector<float>> get_levels(const size_t, const std::chrono::milliseconds);
+	AsyncOp<bool> set_levels(const size_t, std::vector<float>, const std::chrono::milliseconds);
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Topology.h"
+
+// Interfaces the device layer (Device, VolumeDevice, DeviceList) is built on.
+// WinAudioBackend talks to Core Audio, PulseAudioBackend to a PulseAudio or PipeWire server (Linux),
+// SimAudioBackend is an in-process fake for benchmarking.
+
+enum class AudioFlow { PLAY, REC };
+enum class AudioType { CONSOLE = 0, MULTIMEDIA = 1, COMMUNICATIONS = 2 }; // same values as ERole
+
+// A backend call that failed, with the code the system gave back (the HRESULT on Windows)
+class BackendError : public std::runtime_error {
+	const long code;
+public:
+	BackendError(const std::string& what, const long c) : std::runtime_error(what), code(c) {}
+	long get_code() const { return code; }
+};
+
+// A volume node found in the topology of an endpoint. Levels are in dB.
+class BackendLevel {
+public:
+	virtual ~BackendLevel() = default;
+
+	virtual const std::string& get_name() const = 0;
+	virtual size_t get_channel_count() const = 0;
+	virtual float get_level_db(const size_t) const = 0;
+	virtual void set_level_db(const size_t, const float) = 0;
+
+	// One value per channel, the buffer holds get_channel_count() floats. Defaults go channel by channel.
+	virtual void get_levels_db(float*, const size_t) const;
+	// Only channels with their bit set in the mask are written (channels past 31 are written if the mask is all set)
+	virtual void set_levels_db(const float*, const size_t, const uint32_t);
+};
+
+inline bool channel_in_mask(const uint32_t mask, const size_t ch)
+{
+	return ch < 32 ? ((mask >> ch) & 1) != 0 : mask == 0xFFFFFFFF;
+}
+
+inline void BackendLevel::get_levels_db(float* out, const size_t n) const
+{
+	for (size_t a = 0; a < n; ++a) out[a] = get_level_db(a);
+}
+
+inline void BackendLevel::set_levels_db(const float* in, const size_t n, const uint32_t mask)
+{
+	for (size_t a = 0; a < n; ++a) if (channel_in_mask(mask, a)) set_level_db(a, in[a]);
+}
+
+// A mute or AGC control found in the topology of an endpoint
+class BackendSwitch {
+public:
+	virtual ~BackendSwitch() = default;
+
+	virtual const std::string& get_name() const = 0;
+	virtual bool get() const = 0;
+	virtual void set(const bool) = 0;
+};
+
+// One application's stream group on an endpoint, what the volume mixer shows as a slider
+class BackendSession {
+public:
+	virtual ~BackendSession() = default;
+
+	// unique per session and stable while it lives
+	virtual const std::string& get_instance_id() const = 0;
+	// shared by every session of that application on that endpoint
+	virtual const std::string& get_session_id() const = 0;
+	virtual uint32_t get_pid() const = 0;
+	// executable file name, empty for the system sounds
+	virtual const std::string& get_process_name() const = 0;
+
+	virtual void set_volume(const float) = 0;
+	virtual float get_volume() const = 0;
+	virtual void set_mute(const bool) = 0;
+	virtual bool get_mute() const = 0;
+};
+
+// Same threading rules as BackendListener
+class SessionListener {
+public:
+	virtual ~SessionListener() = default;
+
+	virtual void on_session_added(std::shared_ptr<BackendSession>) = 0;
+	virtual void on_session_expired(const std::string&) = 0;
+};
+
+// Endpoint volume or mute changed, whoever changed it (this process included). Same threading rules as BackendListener.
+class VolumeListener {
+public:
+	virtual ~VolumeListener() = default;
+
+	// endpoint ID, master volume and mute after the change
+	virtual void on_volume_changed(const std::string&, const float, const bool) = 0;
+};
+
+class BackendEndpoint {
+public:
+	virtual ~BackendEndpoint() = default;
+
+	virtual std::string get_id() const = 0;
+	virtual std::string get_friendly_name() const = 0;
+	virtual AudioFlow get_flow() const = 0;
+	virtual bool is_active() const = 0;
+	virtual void set_volume(const float) = 0;
+	virtual float get_volume() const = 0;
+	virtual void set_mute(const bool) = 0;
+	virtual bool get_mute() const = 0;
+
+	// Peak sample value (0.0..1.0) per channel since the previous read, without touching the stream
+	virtual size_t get_meter_channel_count() const = 0;
+	// the count must be get_meter_channel_count(), as GetChannelsPeakValues wants
+	virtual void get_peaks(float*, const size_t) const = 0;
+
+	// sessions alive right now (expired ones are left out)
+	virtual std::vector<std::shared_ptr<BackendSession>> get_sessions() = 0;
+	// sessions created or expired from now on, nullptr to stop. The listener must stay alive until replaced.
+	virtual void set_session_listener(SessionListener*) = 0;
+	// volume and mute changes of this endpoint from now on, nullptr to stop. Same lifetime rule.
+	virtual void set_volume_listener(VolumeListener*) = 0;
+
+	// Walked once per endpoint, the backend keeps it until the device changes
+	virtual std::shared_ptr<const TopologyGraph> get_topology() = 0;
+	// n-th control of that kind in the topology, throws if there is none
+	virtual std::unique_ptr<BackendLevel> get_underlying_volume(const size_t) = 0;
+	virtual std::unique_ptr<BackendSwitch> get_underlying_switch(const NodeKind, const size_t) = 0;
+};
+
+// Endpoint notifications. Called from a backend thread: keep it short and do not call back into the backend from there.
+class BackendListener {
+public:
+	virtual ~BackendListener() = default;
+
+	// added, removed, state or property changed: look the ID up again to know which
+	virtual void on_device_changed(const std::string&) = 0;
+	// empty ID if there is no default anymore
+	virtual void on_default_changed(const AudioFlow, const AudioType, const std::string&) = 0;
+};
+
+class AudioBackend {
+public:
+	virtual ~AudioBackend() = default;
+
+	virtual size_t get_count(const AudioFlow) const = 0;
+	virtual std::unique_ptr<BackendEndpoint> get_endpoint(const AudioFlow, const size_t) const = 0;
+	// nullptr if no endpoint has that ID, in any state
+	virtual std::unique_ptr<BackendEndpoint> get_endpoint(const std::string&) const = 0;
+	// nullptr if there is no default endpoint for that role
+	virtual std::unique_ptr<BackendEndpoint> get_default(const AudioFlow, const AudioType) const = 0;
+
+	// One listener at a time, nullptr to stop. The listener must stay alive until replaced.
+	virtual void set_listener(BackendListener*) = 0;
+};
+
+// Core Audio on Windows. Throws on platforms without a native backend.
+std::shared_ptr<AudioBackend> make_native_backend();
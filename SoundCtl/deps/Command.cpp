@@ -0,0 +1,301 @@
+#include "Command.h"
+#include "AsyncDevice.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <map>
+#include <stdint.h>
+
+Command parse_command(const std::vector<std::string>& args)
+{
+    if (args.size() >= 2 && args[0] == "-app") {
+        Command cmd = parse_command(std::vector<std::string>(args.begin() + 2, args.end()));
+        cmd.app_search = args[1];
+        return cmd;
+    }
+
+    if (args.size() < 3) throw std::invalid_argument("Invalid parameters. Try -help.");
+
+    const std::string& mods = args[2];
+    const auto has = [&mods](const char c) { return static_cast<uint32_t>(mods.find(c) != std::string::npos); };
+
+    Command cmd;
+    cmd.is_device_mic = (args[0] != "OUT");
+    cmd.device_search = args[1];
+    cmd.flags = {
+        (has('M')     ) | // mute
+        (has('m') << 1) | // unmute
+        (has('T') << 2) | // toggle mute
+        (has('i') << 3) | // increase vol
+        (has('d') << 4) | // decrease vol
+        (has('s') << 5)   // set vol
+    };
+    cmd.device_change = (args.size() > 3 ? std::stof(args[3]) : -1.0f);
+
+    if ((cmd.flags[3] || cmd.flags[4] || cmd.flags[5]) && (cmd.device_change < 0.0f || cmd.device_change > 1.0f))
+        throw std::invalid_argument("Invalid volume");
+
+    return cmd;
+}
+
+Command parse_target(const std::vector<std::string>& args)
+{
+    if (args.size() < 2) throw std::invalid_argument("Invalid parameters. Try -help.");
+
+    Command cmd;
+    cmd.is_device_mic = (args[0] != "OUT");
+    cmd.device_search = args[1];
+    cmd.device_change = -1.0f;
+    return cmd;
+}
+
+TargetKind get_target_kind(const std::string& search)
+{
+    if (search.empty() || search[0] == '*') return TargetKind::DEFAULT;
+    if (search[0] == '{') return TargetKind::ID; // every endpoint ID starts that way
+    if (search[0] == '@' && search.size() > 1) return TargetKind::ALIAS;
+    return TargetKind::NAME;
+}
+
+Device select_device(const DeviceList& devl, const Command& cmd)
+{
+    const std::string& s = cmd.device_search;
+    switch (get_target_kind(s)) {
+    case TargetKind::DEFAULT:
+        return cmd.is_device_mic ? devl.get_default_rec(AudioType::CONSOLE) : devl.get_default_play(AudioType::CONSOLE);
+    case TargetKind::ID:
+        return cmd.is_device_mic ? devl.get_rec(EndpointId{ s }) : devl.get_play(EndpointId{ s });
+    case TargetKind::ALIAS:
+        return cmd.is_device_mic ? devl.get_rec(DeviceAlias{ s.substr(1) }) : devl.get_play(DeviceAlias{ s.substr(1) });
+    default:
+        return cmd.is_device_mic ? devl.get_rec(s) : devl.get_play(s);
+    }
+}
+
+static void _apply_mute(Device& dev, const Command& cmd)
+{
+    if (cmd.flags[2]) { // toggle mute
+        dev.set_mute(!dev.get_mute());
+    }
+    else if (cmd.flags[0]) { // mute
+        dev.set_mute(true);
+    }
+    else if (cmd.flags[1]) { // unmute
+        dev.set_mute(false);
+    }
+}
+
+// -1 if the command does not change the volume
+static float _target_volume(const Device& dev, const Command& cmd)
+{
+    if (cmd.flags[5]) { // set volume
+        return cmd.device_change;
+    }
+    else if (cmd.flags[3]) { // increase
+        return std::min(1.0f, cmd.device_change + dev.get_volume());
+    }
+    else if (cmd.flags[4]) { // decrease
+        return std::max(0.0f, - cmd.device_change + dev.get_volume());
+    }
+    return -1.0f;
+}
+
+void apply_command(Device& dev, const Command& cmd)
+{
+    _apply_mute(dev, cmd);
+
+    const float vol = _target_volume(dev, cmd);
+    if (vol >= 0.0f) dev.set_volume(vol);
+}
+
+void apply_command(const std::shared_ptr<Device>& dev, const std::string& id, const Command& cmd, WriteCoalescer& writes)
+{
+    _apply_mute(*dev, cmd);
+
+    if (cmd.flags[5]) writes.set(id, dev, cmd.device_change);
+    else if (cmd.flags[3]) writes.adjust(id, dev, cmd.device_change);
+    else if (cmd.flags[4]) writes.adjust(id, dev, -cmd.device_change);
+}
+
+void apply_session_command(const SessionTable& table, const Command& cmd)
+{
+    const auto sessions = table.find(cmd.app_search);
+    if (sessions.empty()) throw std::runtime_error("No session matches " + cmd.app_search);
+
+    // toggling follows the first session so an app with several of them ends up consistent
+    if (cmd.flags[2] || cmd.flags[0] || cmd.flags[1]) {
+        const bool mute = cmd.flags[2] ? !sessions.front()->get_mute() : cmd.flags[0];
+        for (const auto& i : sessions) i->set_mute(mute);
+    }
+
+    for (const auto& i : sessions) {
+        if (cmd.flags[5]) i->set_volume(cmd.device_change);
+        else if (cmd.flags[3]) i->set_volume(std::min(1.0f, i->get_volume() + cmd.device_change));
+        else if (cmd.flags[4]) i->set_volume(std::max(0.0f, i->get_volume() - cmd.device_change));
+    }
+}
+
+void apply_command(const std::shared_ptr<Device>& dev, const Command& cmd, RampEngine* ramp, const Fade& fade)
+{
+    if (!ramp || fade.length.count() <= 0) {
+        apply_command(*dev, cmd);
+        return;
+    }
+
+    _apply_mute(*dev, cmd);
+
+    const float vol = _target_volume(*dev, cmd);
+    if (vol >= 0.0f) ramp->add(dev, vol, fade.length, fade.curve);
+}
+
+RampCurve parse_curve(const std::string& s)
+{
+    if (s == "lin") return RampCurve::LINEAR;
+    if (s == "db") return RampCurve::DB_LINEAR;
+    if (s == "s") return RampCurve::S_CURVE;
+    throw std::invalid_argument("Invalid curve: " + s);
+}
+
+std::vector<std::string> split_args(const std::string& line)
+{
+    std::vector<std::string> args;
+    std::string cur;
+    bool quoted = false, has = false;
+
+    for (const char c : line) {
+        if (c == '"') { quoted = !quoted; has = true; }
+        else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+            if (has) args.push_back(std::move(cur));
+            cur.clear();
+            has = false;
+        }
+        else { cur += c; has = true; }
+    }
+    if (has) args.push_back(std::move(cur));
+    return args;
+}
+
+std::vector<std::vector<std::string>> read_batch(std::istream& in)
+{
+    std::vector<std::vector<std::string>> ops;
+    std::string line;
+    while (std::getline(in, line)) {
+        auto args = split_args(line);
+        if (args.empty() || args[0][0] == '#') continue;
+        ops.push_back(std::move(args));
+    }
+    return ops;
+}
+
+std::vector<std::vector<std::string>> split_batch(const std::vector<std::string>& args)
+{
+    std::vector<std::vector<std::string>> ops(1);
+    for (const auto& i : args) {
+        if (i == ";") ops.emplace_back();
+        else ops.back().push_back(i);
+    }
+    ops.erase(std::remove_if(ops.begin(), ops.end(), [](const std::vector<std::string>& v) { return v.empty(); }), ops.end());
+    return ops;
+}
+
+std::vector<std::string> run_batch(const DeviceList& devl, const std::vector<std::vector<std::string>>& ops, RampEngine* ramp, const Fade& fade)
+{
+    struct Target {
+        std::shared_ptr<Device> dev;
+        std::unique_ptr<SessionTable> sessions; // on the first -app command, then shared by the others
+        std::string error;
+    };
+
+    std::vector<std::string> errors(ops.size());
+    std::vector<Command> cmds(ops.size());
+    std::vector<Target*> targets(ops.size(), nullptr);
+    std::map<std::string, Target> resolved; // by kind + search text
+
+    // parse and resolve everything before touching any device
+    for (size_t a = 0; a < ops.size(); ++a) {
+        try {
+            cmds[a] = parse_command(ops[a]);
+        }
+        catch (const std::exception& e) {
+            errors[a] = e.what();
+            continue;
+        }
+
+        const std::string key = (cmds[a].is_device_mic ? "IN\t" : "OUT\t") + cmds[a].device_search;
+        auto it = resolved.find(key);
+        if (it == resolved.end()) {
+            Target t;
+            try {
+                t.dev = std::make_shared<Device>(select_device(devl, cmds[a]));
+            }
+            catch (const std::exception& e) {
+                t.error = e.what();
+            }
+            it = resolved.emplace(key, std::move(t)).first;
+        }
+        targets[a] = &it->second;
+    }
+
+    for (size_t a = 0; a < ops.size(); ++a) {
+        if (!targets[a]) continue;
+        if (!targets[a]->dev) {
+            errors[a] = targets[a]->error;
+            continue;
+        }
+        try {
+            TraceScope t("apply");
+            if (cmds[a].app_search.empty()) apply_command(targets[a]->dev, cmds[a], ramp, fade);
+            else {
+                if (!targets[a]->sessions) targets[a]->sessions = std::make_unique<SessionTable>(targets[a]->dev, false);
+                apply_session_command(*targets[a]->sessions, cmds[a]);
+            }
+        }
+        catch (const std::exception& e) {
+            errors[a] = e.what();
+        }
+    }
+
+    return errors;
+}
+
+std::vector<std::string> run_batch_async(const std::shared_ptr<AudioBackend>& backend, const std::vector<std::vector<std::string>>& ops, const std::chrono::milliseconds timeout)
+{
+    std::vector<std::string> errors(ops.size());
+    std::vector<AsyncOp<bool>> results(ops.size());
+    std::vector<bool> submitted(ops.size(), false);
+    std::map<std::string, std::unique_ptr<AsyncDevice>> devices; // by kind + search text
+
+    for (size_t a = 0; a < ops.size(); ++a) {
+        Command cmd;
+        try {
+            cmd = parse_command(ops[a]);
+        }
+        catch (const std::exception& e) {
+            errors[a] = e.what();
+            continue;
+        }
+
+        const std::string key = (cmd.is_device_mic ? "IN\t" : "OUT\t") + cmd.device_search;
+        auto it = devices.find(key);
+        if (it == devices.end()) {
+            // its own DeviceList: the lookup runs on that device's thread, next to the lookups of the others
+            const auto open = [backend, cmd] { return select_device(DeviceList(backend), cmd); };
+            it = devices.emplace(key, std::make_unique<AsyncDevice>(open)).first;
+        }
+
+        results[a] = it->second->call<bool>([cmd](const std::shared_ptr<Device>& dev) {
+            TraceScope t("apply");
+            if (cmd.app_search.empty()) apply_command(*dev, cmd);
+            else apply_session_command(SessionTable(dev, false), cmd);
+            return true;
+        }, timeout);
+        submitted[a] = true;
+    }
+
+    // everything is running already, waiting in order adds nothing: each wait ends by its own deadline
+    for (size_t a = 0; a < ops.size(); ++a) {
+        if (!submitted[a]) continue;
+        if (results[a].wait() != AsyncStatus::OK) errors[a] = results[a].error();
+    }
+    return errors;
+}
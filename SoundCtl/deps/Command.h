@@ -0,0 +1,61 @@
+#pragma once
+
+#include <bitset>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "DeviceManager.h"
+#include "RampEngine.h"
+#include "SessionTable.h"
+#include "WriteCoalescer.h"
+
+// One "[-app <app>] <kind> <name> <flags> (number)" request, as given on the command line.
+struct Command {
+	bool is_device_mic;
+	std::string device_search;
+	std::bitset<6> flags;
+	float device_change;
+	std::string app_search; // empty: the endpoint itself, else its sessions matching this (see SessionTable::find)
+};
+
+// How the device is given: * (or nothing) for the default one, {...} for an endpoint ID, @<alias> for an alias
+// from the alias file, anything else is looked for in the friendly names
+enum class TargetKind { DEFAULT, NAME, ID, ALIAS };
+TargetKind get_target_kind(const std::string&);
+
+// Volume changes ramped over this long instead of jumping, when a RampEngine is given
+struct Fade {
+	std::chrono::milliseconds length{ 0 };
+	RampCurve curve = RampCurve::LINEAR;
+};
+
+// Throws std::invalid_argument on missing arguments or a volume out of [0.0..1.0]
+Command parse_command(const std::vector<std::string>&);
+// Only "<kind> <name>", for modes that read from a device instead of changing it
+Command parse_target(const std::vector<std::string>&);
+Device select_device(const DeviceList&, const Command&);
+void apply_command(Device&, const Command&);
+// Mute changes are immediate, the volume change is handed to the engine (it keeps the device alive until done)
+void apply_command(const std::shared_ptr<Device>&, const Command&, RampEngine*, const Fade&);
+// Mute changes are immediate, the volume change goes through the coalescer under that endpoint ID
+void apply_command(const std::shared_ptr<Device>&, const std::string&, const Command&, WriteCoalescer&);
+// Same flags on every session matching cmd.app_search, each relative to its own volume. Throws if none matches.
+void apply_session_command(const SessionTable&, const Command&);
+// "lin", "db" or "s"
+RampCurve parse_curve(const std::string&);
+
+// Splits a line on blanks, "double quoted" parts stay together
+std::vector<std::string> split_args(const std::string&);
+// One command per line, blank lines and lines starting with # are skipped
+std::vector<std::vector<std::string>> read_batch(std::istream&);
+// Splits argv style arguments on standalone ";"
+std::vector<std::vector<std::string>> split_batch(const std::vector<std::string>&);
+
+// Resolves every target first (each distinct device is opened once), then applies the commands in order.
+// One entry per command: empty if it worked, the reason otherwise. A failure never stops the others.
+std::vector<std::string> run_batch(const DeviceList&, const std::vector<std::vector<std::string>>&, RampEngine* = nullptr, const Fade& = {});
+// Same results, but each distinct device is opened and driven from its own thread (see AsyncDevice): devices run in
+// parallel and a command that takes longer than the timeout, opening included, is reported as timed out without
+// holding up the others. No fades. Name lookups read the names every time: a name cache is not shared between threads.
+std::vector<std::string> run_batch_async(const std::shared_ptr<AudioBackend>&, const std::vector<std::vector<std::string>>&, const std::chrono::milliseconds);
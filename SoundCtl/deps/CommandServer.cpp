@@ -0,0 +1,172 @@
+#include "CommandServer.h"
+
+#include <iostream>
+#include <thread>
+
+// mute, unmute and toggle (see parse_command)
+static const std::bitset<6> mute_flags(0x07);
+
+std::vector<std::string> split_request(const std::string& line)
+{
+    std::vector<std::string> args;
+    size_t pos = 0;
+    for (size_t tab = line.find('\t'); tab != std::string::npos; tab = line.find('\t', pos)) {
+        args.push_back(line.substr(pos, tab - pos));
+        pos = tab + 1;
+    }
+    args.push_back(line.substr(pos));
+    return args;
+}
+
+std::string join_request(const std::vector<std::string>& args)
+{
+    std::string line;
+    for (const auto& i : args) {
+        if (!line.empty()) line += '\t';
+        line += i;
+    }
+    return line;
+}
+
+CommandServer::CommandServer(std::shared_ptr<AudioBackend> backend, const std::chrono::microseconds interval)
+    : registry(std::move(backend)), writes(interval)
+{
+}
+
+static std::string _key(const Command& cmd)
+{
+    return (cmd.is_device_mic ? "IN\t" : "OUT\t") + cmd.device_search;
+}
+
+std::shared_ptr<CommandServer::Cached> CommandServer::_resolve(const Command& cmd, bool& reused)
+{
+    const AudioFlow flow = cmd.is_device_mic ? AudioFlow::REC : AudioFlow::PLAY;
+    const std::string& s = cmd.device_search;
+
+    const std::string key = _key(cmd);
+    const auto snap = registry.get_snapshot();
+    const DeviceRegistry::Entry* ent = nullptr;
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        switch (get_target_kind(s)) {
+        case TargetKind::DEFAULT: ent = snap->find_default(flow, AudioType::CONSOLE); break;
+        case TargetKind::ID: ent = snap->find_id(flow, s); break;
+        case TargetKind::ALIAS: {
+            const std::string* id = aliases.find(s.substr(1));
+            if (!id) throw std::runtime_error("Unknown alias: " + s.substr(1));
+            ent = snap->find_id(flow, *id);
+            break;
+        }
+        default: ent = snap->find(flow, s); break;
+        }
+        if (!ent) throw std::runtime_error("NULL DEVICE");
+
+        // the name or the default may point somewhere else since last time
+        const auto it = cache.find(key);
+        reused = (it != cache.end() && it->second->id == ent->id);
+        if (reused) return it->second;
+    }
+
+    auto c = std::make_shared<Cached>();
+    c->id = ent->id;
+    c->dev = std::make_shared<Device>(registry.open(ent->id));
+
+    std::lock_guard<std::mutex> l(mtx);
+    auto& slot = cache[key];
+    // another client may have opened it meanwhile, everyone goes on with that one
+    if (slot && slot->id == c->id) return slot;
+    slot = c;
+    return c;
+}
+
+void CommandServer::_run(Cached& c, const Command& cmd)
+{
+    if (cmd.app_search.empty()) {
+        apply_command(c.dev, c.id, cmd, writes);
+        return;
+    }
+    if (!c.sessions) c.sessions = std::make_unique<SessionTable>(c.dev);
+    apply_session_command(*c.sessions, cmd);
+}
+
+void CommandServer::_apply(Command& cmd, bool& reused)
+{
+    const auto shared = _resolve(cmd, reused);
+    Cached& c = *shared;
+    std::lock_guard<std::mutex> l(c.io);
+
+    Command mute = cmd;
+    mute.flags &= mute_flags;
+    if (mute.flags.none() || mute.flags == cmd.flags) {
+        _run(c, cmd);
+        return;
+    }
+    _run(c, mute);
+    cmd.flags &= ~mute_flags; // went through, a retry must not toggle it back
+    _run(c, cmd);
+}
+
+bool CommandServer::load_aliases(const std::string& path)
+{
+    std::lock_guard<std::mutex> l(mtx);
+    return aliases.load(path);
+}
+
+std::string CommandServer::execute(const std::string& line)
+{
+    if (line == "-stats") {
+        const auto st = writes.get_stats();
+        return "OK " + std::to_string(st.requests) + " " + std::to_string(st.writes) + " " + std::to_string(st.noops) + " " + std::to_string(st.errors);
+    }
+    if (line.compare(0, 9, "-opstats\t") == 0) {
+        return dump_opstats(line.substr(9)) ? "OK" : "ERR Cannot write " + line.substr(9);
+    }
+
+    try {
+        Command cmd = parse_command(split_request(line));
+
+        bool reused = false;
+        try {
+            _apply(cmd, reused);
+        }
+        catch (const BackendError&) {
+            if (!reused) throw; // just opened, nothing stale about it
+            // the cached interfaces may be stale (driver restart): open the endpoint again and retry what is left, once
+            {
+                std::lock_guard<std::mutex> l(mtx);
+                cache.erase(_key(cmd));
+            }
+            _apply(cmd, reused);
+        }
+        return "OK";
+    }
+    catch (const std::exception& e) {
+        return std::string("ERR ") + e.what();
+    }
+    catch (...) {
+        return "ERR UNHANDLED";
+    }
+}
+
+void CommandServer::_serve(IpcConnection conn)
+{
+    std::string line;
+    while (conn.read_line(line)) {
+        if (!conn.write_line(execute(line))) break;
+    }
+}
+
+void CommandServer::run(const std::string& name)
+{
+    IpcServer srv(name);
+    while (true) {
+        try {
+            std::thread(&CommandServer::_serve, this, srv.accept()).detach();
+        }
+        catch (const std::exception& e) {
+            // one client gone wrong (or out of handles for a moment) must not end the resident instance
+            std::cerr << "Accepting a client failed: " << e.what() << "\n";
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
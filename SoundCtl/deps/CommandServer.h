@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "AliasTable.h"
+#include "Command.h"
+#include "DeviceRegistry.h"
+#include "Ipc.h"
+
+// Resident mode: a DeviceRegistry tracks the endpoints live and every Device already opened stays open between commands.
+// So does the SessionTable of a device once an -app command used it, following the sessions live from then on.
+// Volume changes go through a WriteCoalescer: a burst of them (a held volume key) turns into a few absolute writes.
+// The "-stats" request replies "OK <requests> <writes> <noops> <errors>" from it.
+// "-opstats <file>" writes the operation statistics of the device layer (see OpStats) to that file.
+// Requests are the usual command line arguments separated by '\t', one per line. Replies are "OK" or "ERR <reason>".
+// Clients run in parallel: commands for one endpoint are serialized, a slow endpoint does not hold up the others.
+class CommandServer {
+	struct Cached {
+		std::string id;
+		std::shared_ptr<Device> dev;
+		std::mutex io; // held across the device calls of one command, guards sessions
+		std::unique_ptr<SessionTable> sessions;
+	};
+
+	DeviceRegistry registry;
+	WriteCoalescer writes;
+	AliasTable aliases;
+	std::unordered_map<std::string, std::shared_ptr<Cached>> cache; // by kind + search text
+	std::mutex mtx; // guards aliases and cache, never held across a device call
+
+	std::shared_ptr<Cached> _resolve(const Command&, bool&);
+	void _run(Cached&, const Command&);
+	// Takes off the command what went through, for the retry after a stale device
+	void _apply(Command&, bool&);
+	void _serve(IpcConnection);
+public:
+	// interval = 1 / maximum volume writes per second per endpoint
+	CommandServer(std::shared_ptr<AudioBackend>, const std::chrono::microseconds = std::chrono::milliseconds(20));
+	CommandServer(const CommandServer&) = delete;
+	void operator=(const CommandServer&) = delete;
+
+	// Read once, now: restart the resident instance after editing the file. Returns false if it is missing.
+	bool load_aliases(const std::string&);
+
+	// runs one request line, returns the reply line
+	std::string execute(const std::string&);
+
+	// blocks forever, one thread per client
+	void run(const std::string&);
+};
+
+std::vector<std::string> split_request(const std::string&);
+std::string join_request(const std::vector<std::string>&);
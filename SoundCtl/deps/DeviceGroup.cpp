@@ -0,0 +1,258 @@
+#include "DeviceGroup.h"
+#include "Command.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdexcept>
+
+// backends round what they store (Core Audio through dB steps, PulseAudio to integer volumes)
+static const float echo_epsilon = 0.002f;
+// a write whose notification has not come back by then never will (the change was swallowed or merged)
+static const std::chrono::seconds echo_timeout(1);
+// per member: more writes than that in flight means notifications are being lost
+static const size_t max_expected = 16;
+static const size_t latency_window = 4096;
+
+static bool _near(const float a, const float b)
+{
+    return fabsf(a - b) < echo_epsilon;
+}
+
+GroupSet::GroupSet(std::vector<GroupDef> defs)
+{
+    for (auto& d : defs) {
+        if (d.members.size() < 2) throw std::invalid_argument("A group needs two devices at least: " + d.name);
+
+        Group g;
+        g.name = d.name;
+        for (auto& m : d.members) {
+            if (!m.dev) throw std::invalid_argument("NULL DEVICE");
+            if (!(m.ratio > 0.0f)) throw std::invalid_argument("Invalid ratio in group " + d.name);
+
+            Member mem;
+            mem.id = m.dev->get_id();
+            mem.volume = m.dev->get_volume();
+            mem.mute = m.dev->get_mute();
+            mem.cfg = std::move(m);
+            if (!by_id.emplace(mem.id, std::make_pair(groups.size(), g.members.size())).second)
+                throw std::invalid_argument("Device in two groups: " + mem.id);
+            g.members.push_back(std::move(mem));
+        }
+        groups.push_back(std::move(g));
+    }
+
+    // the first sync goes through the worker too, so only that thread ever touches the members
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t g = 0; g < groups.size(); ++g) {
+        const Member& lead = groups[g].members[0];
+        pending.push_back(Event{ g, 0, lead.volume, lead.mute, true, now });
+    }
+    worker = std::thread(&GroupSet::_work, this);
+
+    try {
+        for (auto& g : groups) {
+            for (auto& m : g.members) m.cfg.dev->set_volume_listener(this);
+        }
+    }
+    catch (...) {
+        // clearing one that was never set is harmless
+        for (auto& g : groups) {
+            for (auto& m : g.members) {
+                try { m.cfg.dev->set_volume_listener(nullptr); }
+                catch (...) {}
+            }
+        }
+        {
+            std::lock_guard<std::mutex> l(mtx);
+            stop = true;
+        }
+        cond.notify_one();
+        worker.join();
+        throw;
+    }
+}
+
+GroupSet::~GroupSet()
+{
+    // no notification comes in once this returns for every member
+    for (auto& g : groups) {
+        for (auto& m : g.members) {
+            try { m.cfg.dev->set_volume_listener(nullptr); }
+            catch (...) {} // unplugged: its notifications stopped with it
+        }
+    }
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        stop = true;
+    }
+    cond.notify_one();
+    worker.join();
+}
+
+GroupSet::Stats GroupSet::get_stats() const
+{
+    Stats st;
+    std::vector<uint64_t> vec;
+    uint64_t sum, max;
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        st = stats;
+        vec = latencies_ns;
+        sum = latency_sum_ns;
+        max = latency_max_ns;
+    }
+    if (st.changes) st.latency_avg_us = sum / 1e3 / st.changes;
+    st.latency_max_us = max / 1e3;
+    if (!vec.empty()) {
+        std::sort(vec.begin(), vec.end());
+        st.latency_p50_us = vec[vec.size() / 2] / 1e3;
+        st.latency_p99_us = vec[std::min(vec.size() - 1, vec.size() * 99 / 100)] / 1e3;
+    }
+    return st;
+}
+
+void GroupSet::on_volume_changed(const std::string& id, const float volume, const bool mute)
+{
+    const auto it = by_id.find(id); // never changes once the listeners are in
+    if (it == by_id.end()) return;
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        for (auto& e : pending) {
+            if (e.group != it->second.first || e.member != it->second.second || e.force) continue;
+            // the newer state wins, the latency still counts from the older one
+            e.volume = volume;
+            e.mute = mute;
+            ++stats.coalesced;
+            return;
+        }
+        pending.push_back(Event{ it->second.first, it->second.second, volume, mute, false, now });
+    }
+    cond.notify_one();
+}
+
+void GroupSet::_work()
+{
+    for (;;) {
+        Event e;
+        {
+            std::unique_lock<std::mutex> l(mtx);
+            cond.wait(l, [this] { return stop || !pending.empty(); });
+            if (stop) return;
+            e = pending.front();
+            pending.pop_front();
+        }
+
+        Group& g = groups[e.group];
+        Member& m = g.members[e.member];
+        if (!e.force && _is_echo(m, e.volume, e.mute)) {
+            std::lock_guard<std::mutex> l(mtx);
+            ++stats.echoes;
+            continue;
+        }
+
+        // someone else moved it: whatever we wrote before is overtaken
+        m.expected.clear();
+        m.volume = e.volume;
+        m.mute = e.mute;
+
+        uint64_t writes = 0, errors = 0;
+        _propagate(g, e.member, e.volume, e.mute, writes, errors);
+        const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - e.at).count();
+
+        std::lock_guard<std::mutex> l(mtx);
+        stats.writes += writes;
+        stats.errors += errors;
+        if (e.force) continue; // not a change, the latency would only be the time it took to start
+        ++stats.changes;
+        latency_sum_ns += ns;
+        latency_max_ns = std::max(latency_max_ns, ns);
+        if (latencies_ns.size() < latency_window) latencies_ns.push_back(ns);
+        else latencies_ns[latency_next] = ns;
+        latency_next = (latency_next + 1) % latency_window;
+    }
+}
+
+bool GroupSet::_is_echo(Member& m, const float volume, const bool mute)
+{
+    const auto now = std::chrono::steady_clock::now();
+    while (!m.expected.empty() && m.expected.front().until < now) m.expected.pop_front();
+
+    for (size_t i = 0; i < m.expected.size(); ++i) {
+        if (!_near(m.expected[i].volume, volume) || m.expected[i].mute != mute) continue;
+        // the ones before it were merged into this notification
+        m.expected.erase(m.expected.begin(), m.expected.begin() + i + 1);
+        m.volume = volume;
+        m.mute = mute;
+        return true;
+    }
+    // a write of the same value, or a channel balance change: nothing for the others
+    return _near(m.volume, volume) && m.mute == mute;
+}
+
+void GroupSet::_propagate(Group& g, const size_t from, const float volume, const bool mute, uint64_t& writes, uint64_t& errors)
+{
+    const GroupMember& src = g.members[from].cfg;
+    const float level = (volume - src.offset) / src.ratio;
+
+    for (size_t i = 0; i < g.members.size(); ++i) {
+        if (i == from) continue;
+        Member& m = g.members[i];
+        const float target = std::min(1.0f, std::max(0.0f, m.cfg.ratio * level + m.cfg.offset));
+        _write(m, target, mute, src.mute && m.cfg.mute, writes, errors);
+    }
+}
+
+void GroupSet::_write(Member& m, const float volume, const bool mute, const bool with_mute, uint64_t& writes, uint64_t& errors)
+{
+    const auto until = std::chrono::steady_clock::now() + echo_timeout;
+
+    // expected before the write: a backend may notify before set_volume returns
+    if (!_near(m.volume, volume)) {
+        if (m.expected.size() >= max_expected) m.expected.pop_front();
+        m.expected.push_back(Expected{ volume, m.mute, until });
+        try {
+            m.cfg.dev->set_volume(volume);
+            m.volume = volume;
+            ++writes;
+        }
+        catch (...) {
+            m.expected.pop_back();
+            ++errors;
+        }
+    }
+    if (with_mute && m.mute != mute) {
+        if (m.expected.size() >= max_expected) m.expected.pop_front();
+        m.expected.push_back(Expected{ m.volume, mute, until });
+        try {
+            m.cfg.dev->set_mute(mute);
+            m.mute = mute;
+            ++writes;
+        }
+        catch (...) {
+            m.expected.pop_back();
+            ++errors;
+        }
+    }
+}
+
+GroupDef parse_group(const DeviceList& devl, const std::vector<std::string>& args)
+{
+    if (args.size() < 2) throw std::invalid_argument("Invalid group. Try -help.");
+
+    GroupDef def;
+    def.name = args[0];
+    for (const auto& item : split_batch(std::vector<std::string>(args.begin() + 1, args.end()))) {
+        GroupMember m;
+        for (size_t i = 2; i < item.size(); ++i) {
+            const std::string& opt = item[i];
+            if (opt == "nomute") m.mute = false;
+            else if (opt.size() > 1 && opt[0] == 'x') m.ratio = std::stof(opt.substr(1));
+            else if (opt.size() > 1 && (opt[0] == '+' || opt[0] == '-')) m.offset = std::stof(opt);
+            else throw std::invalid_argument("Unknown group option: " + opt);
+        }
+        m.dev = std::make_shared<Device>(select_device(devl, parse_target(item)));
+        def.members.push_back(std::move(m));
+    }
+    return def;
+}
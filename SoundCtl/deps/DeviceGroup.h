@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceManager.h"
+
+// One endpoint of a group. Its volume is ratio * level + offset, clamped to [0..1], where level is the group volume.
+struct GroupMember {
+	std::shared_ptr<Device> dev;
+	float ratio = 1.0f;
+	float offset = 0.0f;
+	bool mute = true; // follows the mute of the group too
+};
+
+struct GroupDef {
+	std::string name;
+	std::vector<GroupMember> members;
+};
+
+// Keeps the volume and mute of linked endpoints together. A change to any member, from this program or from anywhere
+// else, comes in as a volume notification and is written to the other members on one worker thread.
+// Echo suppression: the notifications our own writes cause are expected (value and deadline per member) and dropped,
+// so are notifications that change nothing. Without it every write would be propagated back and forth.
+// Latency is bounded by coalescing: while a change of a member waits, a newer one replaces it (the wait keeps counting
+// from the first), so the queue never holds more than one change per member.
+class GroupSet : private VolumeListener {
+public:
+	struct Stats {
+		uint64_t changes = 0;    // notifications propagated
+		uint64_t echoes = 0;     // our own writes coming back, or nothing changed
+		uint64_t coalesced = 0;  // replaced by a newer change before the worker took them
+		uint64_t writes = 0, errors = 0;
+		double latency_avg_us = 0, latency_p50_us = 0, latency_p99_us = 0, latency_max_us = 0; // notification -> last write
+	};
+private:
+	struct Expected {
+		float volume;
+		bool mute;
+		std::chrono::steady_clock::time_point until;
+	};
+	struct Member {
+		GroupMember cfg;
+		std::string id;
+		float volume = 0.0f; // last known
+		bool mute = false;
+		std::deque<Expected> expected; // our writes whose notification has not come back yet
+	};
+	struct Group {
+		std::string name;
+		std::vector<Member> members;
+	};
+	struct Event {
+		size_t group, member;
+		float volume;
+		bool mute;
+		bool force; // the first sync: propagated even if nothing changed
+		std::chrono::steady_clock::time_point at;
+	};
+
+	std::vector<Group> groups;
+	std::unordered_map<std::string, std::pair<size_t, size_t>> by_id; // endpoint ID -> group, member
+
+	std::deque<Event> pending;
+	Stats stats;
+	std::vector<uint64_t> latencies_ns; // the last latency_window ones, for the percentiles
+	size_t latency_next = 0;
+	uint64_t latency_sum_ns = 0, latency_max_ns = 0;
+	mutable std::mutex mtx;
+	std::condition_variable cond;
+	bool stop = false;
+	std::thread worker;
+
+	void on_volume_changed(const std::string&, const float, const bool) override;
+
+	void _work();
+	// worker side, like everything that touches the members
+	bool _is_echo(Member&, const float, const bool);
+	// the others follow that member: counts writes and failures
+	void _propagate(Group&, const size_t, const float, const bool, uint64_t&, uint64_t&);
+	void _write(Member&, const float, const bool, const bool, uint64_t&, uint64_t&);
+public:
+	// Brings every group to the state of its first member, then follows them. Throws if an endpoint is in two groups
+	// (they would drive each other) or a ratio is not positive.
+	GroupSet(std::vector<GroupDef>);
+	GroupSet(const GroupSet&) = delete;
+	void operator=(const GroupSet&) = delete;
+	~GroupSet();
+
+	Stats get_stats() const;
+};
+
+// "<name> <kind> <device> [x<ratio>] [+|-<offset>] [nomute] ; <kind> <device> ..." split on blanks, as read_batch does
+GroupDef parse_group(const DeviceList&, const std::vector<std::string>&);
@@ -1,476 +1,510 @@
 #include "DeviceManager.h"
+#include "LevelMath.h"
+#include "OpStats.h"
+#include "Parallel.h"
+#include "PulseAudioBackend.h"
+#include "Trace.h"
+#include "WinAudioBackend.h"
 
-bool DeviceList::coinit = false;
+#include <algorithm>
+#include <math.h>
 
-
-void VolumeDevice::_unload()
+std::shared_ptr<AudioBackend> make_native_backend()
 {
-    if (level) { level->Release(); level = nullptr; }
+#ifdef _WIN32
+    return std::make_shared<WinAudioBackend>();
+#elif defined(SOUNDCTL_PULSE)
+    return std::make_shared<PulseAudioBackend>();
+#else
+    throw std::runtime_error("No native audio backend on this platform");
+#endif
 }
 
-VolumeDevice::VolumeDevice(IAudioVolumeLevel* lvl, const std::string& s)
-    : level(lvl), name(s)
+
+VolumeDevice::VolumeDevice(std::unique_ptr<BackendLevel> lvl, DeviceOpStats* st)
+    : level(std::move(lvl)), stats(st)
 {
     if (!level) throw std::invalid_argument("NULL LEVEL");
 }
 
 VolumeDevice::VolumeDevice(VolumeDevice&& v) noexcept
-    : name(v.name)
+    : level(std::move(v.level)), stats(v.stats)
+{
+}
+
+VolumeDevice& VolumeDevice::operator=(VolumeDevice&& v) noexcept
 {
-    level = std::exchange(v.level, nullptr);
+    level = std::move(v.level);
+    stats = v.stats;
+    return *this;
 }
 
 VolumeDevice::~VolumeDevice()
 {
-    _unload();
+}
+
+size_t VolumeDevice::_channels() const
+{
+    const size_t _c = level->get_channel_count();
+    if (_c == 0) throw std::runtime_error("Failed to get channel count");
+    return _c;
 }
 
 float VolumeDevice::get_level(const size_t ch) const
 {
-    HRESULT hr{};
     float _f = 0;
 
     if (ch != static_cast<size_t>(-1)) {
-        hr = level->GetLevel(static_cast<UINT>(ch), &_f);
-        if (FAILED(hr)) throw std::runtime_error("Failed to get level of vol");
+        _f = DEVICE_OP(stats, DeviceOp::GET_LEVEL, level->get_level_db(ch));
     }
     else {
-        UINT _c;
-        hr = level->GetChannelCount(&_c);
-        if (FAILED(hr) || _c == 0) throw std::runtime_error("Failed to get channel count");
-
-        for (UINT a = 0; a < _c; ++a)
-        {
-            float __f;
-            level->GetLevel(a, &__f);
-            _f += __f;
-        }
+        std::vector<float> db(_channels());
+        DEVICE_OP(stats, DeviceOp::GET_LEVEL, level->get_levels_db(db.data(), db.size()));
 
-        _f *= 1.0f / _c;
+        for (const auto& i : db) _f += i;
+        _f *= 1.0f / db.size();
     }
 
-    return powf(10.0f, _f / 20.0f);
+    db_to_scalar(&_f, &_f, 1);
+    return _f;
 }
 
 void VolumeDevice::set_level(const float vol, const size_t ch)
 {
-    HRESULT hr{};
-    const float dbvol = 20.0f * log10f(vol);
+    float dbvol;
+    scalar_to_db(&vol, &dbvol, 1);
 
     if (ch == static_cast<size_t>(-1)) {
-        UINT _c;
-        hr = level->GetChannelCount(&_c);
-        if (FAILED(hr) || _c == 0) throw std::runtime_error("Failed to get channel count");
-
-        for (UINT a = 0; a < _c; ++a)
-            level->SetLevel(a, dbvol, NULL);
+        const std::vector<float> db(_channels(), dbvol);
+        DEVICE_OP(stats, DeviceOp::SET_LEVEL, level->set_levels_db(db.data(), db.size(), all_channels));
     }
     else {
-        level->SetLevel(static_cast<UINT>(ch), dbvol, NULL);
+        DEVICE_OP(stats, DeviceOp::SET_LEVEL, level->set_level_db(ch, dbvol));
     }
 }
 
-const std::string& VolumeDevice::get_name() const
+std::vector<float> VolumeDevice::get_levels() const
 {
-    return name;
+    std::vector<float> v(_channels());
+    DEVICE_OP(stats, DeviceOp::GET_LEVEL, level->get_levels_db(v.data(), v.size()));
+    db_to_scalar(v.data(), v.data(), v.size());
+    return v;
 }
 
-void Device::_unload()
+void VolumeDevice::set_levels(const std::vector<float>& vols, const uint32_t mask)
 {
-    if (vol) { vol->Release(); vol = nullptr; }
-    if (device) { device->Release(); device = nullptr; }
-    if (pProps) { pProps->Release(); pProps = nullptr; }
-    if (topo) { topo->Release(); topo = nullptr; }
+    if (vols.size() != _channels()) throw std::invalid_argument("Channel count mismatch");
+
+    std::vector<float> db(vols.size());
+    scalar_to_db(vols.data(), db.data(), db.size());
+    DEVICE_OP(stats, DeviceOp::SET_LEVEL, level->set_levels_db(db.data(), db.size(), mask));
 }
 
-Device::Device(IMMDevice* dev)
-    : device(dev)
+void VolumeDevice::apply_gains(const std::vector<float>& gains, const uint32_t mask)
 {
-    if (!dev) throw std::invalid_argument("NULL DEVICE");
+    std::vector<float> db(_channels());
+    if (gains.size() != db.size()) throw std::invalid_argument("Channel count mismatch");
 
-    HRESULT hr{};
+    // a gain is an offset in dB, no need to convert the levels themselves
+    std::vector<float> off(gains.size());
+    scalar_to_db(gains.data(), off.data(), off.size());
 
-    hr = device->OpenPropertyStore(STGM_READ, &pProps);
-    if (FAILED(hr)) {
-        _unload();
-        throw std::runtime_error("CANNOT LOAD PROPERTIES OF DEVICE!");
-    }
+    DEVICE_OP(stats, DeviceOp::GET_LEVEL, level->get_levels_db(db.data(), db.size()));
+    for (size_t a = 0; a < db.size(); ++a) db[a] += off[a];
+    DEVICE_OP(stats, DeviceOp::SET_LEVEL, level->set_levels_db(db.data(), db.size(), mask));
+}
+
+void VolumeDevice::set_balance(const float pan, const uint32_t left, const uint32_t right)
+{
+    if (pan < -1.0f || pan > 1.0f) throw std::invalid_argument("Invalid balance");
+
+    std::vector<float> db(_channels());
+    DEVICE_OP(stats, DeviceOp::GET_LEVEL, level->get_levels_db(db.data(), db.size()));
+
+    float top = -INFINITY;
+    for (size_t a = 0; a < db.size(); ++a)
+        if (channel_in_mask(left | right, a)) top = std::max(top, db[a]);
+
+    const float gain[2] = { std::min(1.0f, 1.0f - pan), std::min(1.0f, 1.0f + pan) };
+    float off[2];
+    scalar_to_db(gain, off, 2);
 
-    hr = device->Activate(__uuidof(IAudioEndpointVolume), CLSCTX_INPROC_SERVER, NULL, (LPVOID*)&vol);
-    if (FAILED(hr)) {
-        _unload();
-        throw std::runtime_error("CANNOT LOAD VOLUME PROPERTY OF DEVICE!");
+    for (size_t a = 0; a < db.size(); ++a) {
+        if (channel_in_mask(left, a)) db[a] = top + off[0];
+        else if (channel_in_mask(right, a)) db[a] = top + off[1];
     }
+    DEVICE_OP(stats, DeviceOp::SET_LEVEL, level->set_levels_db(db.data(), db.size(), left | right));
+}
 
-    hr = device->Activate(__uuidof(IDeviceTopology), CLSCTX_INPROC_SERVER, NULL, (LPVOID*)&topo);
-    if (FAILED(hr)) {
-        _unload();
-        throw std::runtime_error("CANNOT LOAD TOPOLOGY PROPERTY OF DEVICE!");
-    }    
+size_t VolumeDevice::get_channel_count() const
+{
+    return _channels();
 }
 
-Device::Device(Device&& d) noexcept
+const std::string& VolumeDevice::get_name() const
 {
-    device = std::exchange(d.device, nullptr);
-    pProps = std::exchange(d.pProps, nullptr);
-    vol = std::exchange(d.vol, nullptr);
-    topo = std::exchange(d.topo, nullptr);
+    return level->get_name();
 }
 
-Device::~Device()
+SwitchDevice::SwitchDevice(std::unique_ptr<BackendSwitch> s, DeviceOpStats* st)
+    : sw(std::move(s)), stats(st)
 {
-    _unload();
+    if (!sw) throw std::invalid_argument("NULL SWITCH");
 }
 
-std::string Device::get_friendly_name() const
+SwitchDevice::SwitchDevice(SwitchDevice&& s) noexcept
+    : sw(std::move(s.sw)), stats(s.stats)
+{
+}
+
+SwitchDevice::~SwitchDevice()
+{
+}
+
+bool SwitchDevice::get() const
+{
+    return DEVICE_OP(stats, DeviceOp::GET_SWITCH, sw->get());
+}
+
+void SwitchDevice::set(const bool b)
+{
+    DEVICE_OP(stats, DeviceOp::SET_SWITCH, sw->set(b));
+}
+
+const std::string& SwitchDevice::get_name() const
 {
-    HRESULT hr{};
-    PROPVARIANT varName;
+    return sw->get_name();
+}
 
-    PropVariantInit(&varName);
-    hr = pProps->GetValue(
-        PKEY_Device_FriendlyName, &varName);
+Device::Device(std::unique_ptr<BackendEndpoint> e)
+    : ep(std::move(e))
+{
+    if (!ep) throw std::invalid_argument("NULL DEVICE");
+}
 
-    std::wstring wstr(varName.pwszVal);
+Device::Device(Device&& d) noexcept
+    : ep(std::move(d.ep)), stats(d.stats.load())
+{
+}
 
-    PropVariantClear(&varName);
+Device& Device::operator=(Device&& d) noexcept
+{
+    ep = std::move(d.ep);
+    stats.store(d.stats.exchange(nullptr));
+    return *this;
+}
 
-    std::string hardcast;
-    for (const auto& i : wstr) hardcast += (char)i;
-    return hardcast;
+Device::~Device()
+{
+}
+
+DeviceOpStats* Device::_stats() const
+{
+#ifdef SOUNDCTL_OPSTATS
+    DeviceOpStats* s = stats.load(std::memory_order_acquire);
+    if (s) return s;
+    try {
+        s = opstats_for(ep->get_id());
+    }
+    catch (...) {
+        return opstats_for("?"); // gone already, the operation is about to fail too
+    }
+    stats.store(s, std::memory_order_release); // two threads racing here find the same counters
+    return s;
+#else
+    return nullptr;
+#endif
+}
+
+std::string Device::get_id() const
+{
+    return DEVICE_OP(_stats(), DeviceOp::GET_ID, ep->get_id());
+}
+
+std::string Device::get_friendly_name() const
+{
+    return DEVICE_OP(_stats(), DeviceOp::GET_NAME, ep->get_friendly_name());
 }
 
 void Device::set_volume(const float f)
 {
     if (f < 0.0f || f > 1.0f) return;
-    vol->SetMasterVolumeLevelScalar(f, NULL);    
+    DEVICE_OP(_stats(), DeviceOp::SET_VOLUME, ep->set_volume(f));
 }
 
 float Device::get_volume() const
 {
-    float f;
-    vol->GetMasterVolumeLevelScalar(&f);
-    return f;
+    return DEVICE_OP(_stats(), DeviceOp::GET_VOLUME, ep->get_volume());
 }
 
 void Device::set_mute(const bool b)
 {
-    vol->SetMute(b, NULL);
+    DEVICE_OP(_stats(), DeviceOp::SET_MUTE, ep->set_mute(b));
 }
 
 bool Device::get_mute() const
 {
-    BOOL b;
-    vol->GetMute(&b);
-    return b;
+    return DEVICE_OP(_stats(), DeviceOp::GET_MUTE, ep->get_mute());
 }
 
-VolumeDevice Device::get_underlying_volume(const size_t undr)
+size_t Device::get_meter_channel_count() const
 {
-    HRESULT hr{};    
+    return ep->get_meter_channel_count();
+}
 
-    // get the single connector for that endpoint
-    IConnector* pConnEndpoint = NULL;
-    hr = topo->GetConnector(static_cast<UINT>(undr), &pConnEndpoint);
-    if (FAILED(hr)) {
-        throw std::runtime_error("Could not get connector 0");
-    }
+void Device::get_peaks(float* out, const size_t n) const
+{
+    DEVICE_OP(_stats(), DeviceOp::GET_PEAKS, ep->get_peaks(out, n));
+}
 
-    // get the connector on the device that is
-    // connected to
-    // the connector on the endpoint
-    IConnector* pConnDevice = NULL;
-    hr = pConnEndpoint->GetConnectedTo(&pConnDevice);
-    if (FAILED(hr)) {
-        pConnEndpoint->Release();
-        throw std::runtime_error("Could not get connectedto");
-    }
-    pConnEndpoint->Release();
-
-    // QI on the device's connector for IPart
-    IPart* pPart = NULL;
-    hr = pConnDevice->QueryInterface(__uuidof(IPart), (void**)&pPart);
-    if (FAILED(hr)) {
-        pConnDevice->Release();
-        throw std::runtime_error("Could not query interface");
-    }
+std::vector<float> Device::get_peaks() const
+{
+    std::vector<float> v(ep->get_meter_channel_count());
+    DEVICE_OP(_stats(), DeviceOp::GET_PEAKS, ep->get_peaks(v.data(), v.size()));
+    return v;
+}
 
-    pConnDevice->Release();
+std::vector<std::shared_ptr<BackendSession>> Device::get_sessions()
+{
+    return DEVICE_OP(_stats(), DeviceOp::GET_SESSIONS, ep->get_sessions());
+}
 
-    std::string _tmpnam;
-    {
-        LPWSTR pwszPartName = NULL;
-        hr = pPart->GetName(&pwszPartName);
-        std::wstring wstr(pwszPartName);
-        CoTaskMemFree(pwszPartName);
-        for (const auto& i : wstr) _tmpnam += (char)i;
-    }
+void Device::set_session_listener(SessionListener* l)
+{
+    DEVICE_OP(_stats(), DeviceOp::WATCH_SESSIONS, ep->set_session_listener(l));
+}
 
-    // see if this is a volume node part
-    IAudioVolumeLevel* pVolume = NULL;
-    hr = pPart->Activate(CLSCTX_ALL, __uuidof(IAudioVolumeLevel), (void**)&pVolume);
-    if (E_NOINTERFACE == hr) {
-        pPart->Release();
-        throw std::runtime_error("Invalid number or no audio interface here.");
-    }
-    else if (FAILED(hr)) {
-        pPart->Release();
-        throw std::runtime_error("Could not get sub device");
-    }
+void Device::set_volume_listener(VolumeListener* l)
+{
+    DEVICE_OP(_stats(), DeviceOp::WATCH_VOLUME, ep->set_volume_listener(l));
+}
 
-    pPart->Release();
-    return VolumeDevice{ pVolume, _tmpnam };
+std::shared_ptr<const TopologyGraph> Device::get_topology()
+{
+    return DEVICE_OP(_stats(), DeviceOp::GET_TOPOLOGY, ep->get_topology());
 }
 
+VolumeDevice Device::get_underlying_volume(const size_t undr)
+{
+    DeviceOpStats* st = _stats();
+    return VolumeDevice{ DEVICE_OP(st, DeviceOp::OPEN_NODE, ep->get_underlying_volume(undr)), st };
+}
 
-void DeviceList::_delete_all()
+SwitchDevice Device::get_underlying_switch(const NodeKind kind, const size_t undr)
 {
-    __funky_release(devenum);
-    __funky_release(rec);
-    __funky_release(play);
+    DeviceOpStats* st = _stats();
+    return SwitchDevice{ DEVICE_OP(st, DeviceOp::OPEN_NODE, ep->get_underlying_switch(kind, undr)), st };
 }
 
+
 DeviceList::DeviceList()
+    : DeviceList(make_native_backend())
 {
-    if (!coinit) {
-        if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED))) {
-            _delete_all();
-            throw std::runtime_error("COINIT FAILED!");
+}
+
+DeviceList::DeviceList(std::shared_ptr<AudioBackend> b)
+    : backend(std::move(b))
+{
+    if (!backend) throw std::invalid_argument("NULL BACKEND");
+#ifdef SOUNDCTL_OPSTATS
+    stats = opstats_for("");
+#endif
+}
+
+DeviceList::~DeviceList()
+{
+}
+
+void DeviceList::set_name_cache(const std::string& path)
+{
+    name_cache = path;
+    index.reset();
+}
+
+void DeviceList::set_alias_file(const std::string& path)
+{
+    alias_file = path;
+    aliases.reset();
+}
+
+void DeviceList::set_workers(const size_t w)
+{
+    workers = std::max<size_t>(1, w);
+}
+
+size_t DeviceList::get_workers() const
+{
+    return workers;
+}
+
+std::vector<OpenedDevice> DeviceList::open_all(const AudioFlow f) const
+{
+    std::vector<OpenedDevice> vec(DEVICE_OP(stats, DeviceOp::COUNT, backend->get_count(f)));
+
+    // each index writes its own entry only, so the order is the collection order whatever the threads do
+    parallel_for(vec.size(), workers, [&](const size_t p) {
+        auto& o = vec[p];
+        try {
+            auto dev = std::make_shared<Device>(DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(f, p)));
+            o.id = dev->get_id();
+            o.name = dev->get_friendly_name();
+            o.volume = dev->get_volume();
+            o.dev = std::move(dev);
         }
-        coinit = true;
-    }
+        catch (const std::exception& e) {
+            o.error = e.what();
+        }
+    });
+    return vec;
+}
 
-    HRESULT hr;
+Device DeviceList::_get(const AudioFlow f, const std::string& fin) const
+{
+    TraceScope tr("match");
+    if (!name_cache.empty()) {
+        if (!index) {
+            index = std::make_unique<NameIndex>();
+            index->load(name_cache);
+        }
 
-    hr = CoCreateInstance(
-        __uuidof(MMDeviceEnumerator), nullptr,
-        CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
-        (void**)&devenum);
+        // Trust the cache if the collection has the same size and the endpoint at the hit still has the cached ID.
+        // Anything else (added, removed or disabled devices, or no hit at all) re-reads the IDs of this flow.
+        // A cached ID keeps its cached name: still no hit after that, the names are read again (a device was renamed).
+        size_t p = index->find(f, fin);
+        if (p != static_cast<size_t>(-1) && index->get_entries(f).size() == DEVICE_OP(stats, DeviceOp::COUNT, backend->get_count(f))) {
+            auto ep = DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(f, p));
+            if (ep && ep->get_id() == index->get_entries(f)[p].id) return Device{ std::move(ep) };
+        }
 
-    if (FAILED(hr)) {
-        _delete_all();
-        throw std::runtime_error("COCREATEINSTANCE FAILED!");
+        bool changed = index->refresh(*backend, f, workers);
+        p = index->find(f, fin);
+        if (p == static_cast<size_t>(-1)) {
+            changed |= index->refresh(*backend, f, workers, true);
+            p = index->find(f, fin);
+        }
+        if (changed) index->save(name_cache);
+        if (p == static_cast<size_t>(-1)) return Device{ nullptr }; // fails
+        return Device{ DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(f, p)) };
     }
 
-    hr = devenum->EnumAudioEndpoints(
-        eRender, DEVICE_STATE_ACTIVE,
-        &play);
-
-    if (FAILED(hr)) {
-        _delete_all();
-        throw std::runtime_error("EnumAudioEndpoints eRender FAILED!");
+    const std::string key = fold_name(fin);
+    const size_t num = DEVICE_OP(stats, DeviceOp::COUNT, backend->get_count(f));
+    for (size_t p = 0; p < num; ++p) {
+        auto ep = DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(f, p));
+        if (ep && fold_name(ep->get_friendly_name()).find(key) != std::string::npos) return Device{ std::move(ep) };
     }
+    return Device{ nullptr }; // fails
+}
 
-    hr = devenum->EnumAudioEndpoints(
-        eCapture, DEVICE_STATE_ACTIVE,
-        &rec);
+Device DeviceList::_get(const AudioFlow f, const EndpointId& id) const
+{
+    TraceScope tr("match");
+    auto ep = DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(id.value));
+    if (!ep) throw std::runtime_error("No device has the ID " + id.value);
+    if (ep->get_flow() != f) throw std::runtime_error(f == AudioFlow::REC ? "Not a rec device: " + id.value : "Not a play device: " + id.value);
+    if (!ep->is_active()) throw std::runtime_error("Device is not active: " + id.value);
+    return Device{ std::move(ep) };
+}
 
-    if (FAILED(hr)) {
-        _delete_all();
-        throw std::runtime_error("EnumAudioEndpoints eCapture FAILED!");
+Device DeviceList::_get(const AudioFlow f, const DeviceAlias& a) const
+{
+    if (!aliases) {
+        aliases = std::make_unique<AliasTable>();
+        aliases->load(alias_file);
     }
+    const std::string* id = aliases->find(a.name);
+    if (!id) throw std::runtime_error("Unknown alias: " + a.name);
+    return _get(f, EndpointId{ *id });
 }
 
-DeviceList::~DeviceList()
+Device DeviceList::_get_default(const AudioFlow f, const AudioType t) const
+{
+    TraceScope tr("match");
+    auto ep = DEVICE_OP(stats, DeviceOp::DEFAULT, backend->get_default(f, t));
+    if (ep) return Device{ std::move(ep) };
+
+    if (DEVICE_OP(stats, DeviceOp::COUNT, backend->get_count(f))) return Device{ DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(f, 0)) };
+    throw std::runtime_error(f == AudioFlow::REC ? "FAILED TO GET DEFAULT DEVICE FOR REC" : "FAILED TO GET DEFAULT DEVICE FOR PLAY");
+}
+
+Device DeviceList::_find_default(const AudioFlow f) const
 {
-    _delete_all();
+    TraceScope tr("match");
+    for (const AudioType t : { AudioType::CONSOLE, AudioType::MULTIMEDIA, AudioType::COMMUNICATIONS }) {
+        auto ep = DEVICE_OP(stats, DeviceOp::DEFAULT, backend->get_default(f, t));
+        if (ep) return Device{ std::move(ep) };
+    }
+
+    if (DEVICE_OP(stats, DeviceOp::COUNT, backend->get_count(f))) return Device{ DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(f, 0)) };
+    throw std::runtime_error(f == AudioFlow::REC ? "Cannot find a valid default rec device" : "Cannot find a valid default play device");
 }
 
 size_t DeviceList::get_num_rec() const
 {
-    UINT num{};
-    rec->GetCount(&num);
-    return static_cast<size_t>(num);
+    return DEVICE_OP(stats, DeviceOp::COUNT, backend->get_count(AudioFlow::REC));
 }
 
 size_t DeviceList::get_num_play() const
 {
-    UINT num{};
-    play->GetCount(&num);
-    return static_cast<size_t>(num);
+    return DEVICE_OP(stats, DeviceOp::COUNT, backend->get_count(AudioFlow::PLAY));
 }
 
 Device DeviceList::get_rec(const size_t p) const
 {
-    IMMDevice* ptr;
-    rec->Item(static_cast<UINT>(p), &ptr);
-    return Device{ ptr };
+    return Device{ DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(AudioFlow::REC, p)) };
 }
 
 Device DeviceList::get_play(const size_t p) const
 {
-    IMMDevice* ptr;
-    play->Item(static_cast<UINT>(p), &ptr); 
-    return Device{ ptr };
+    return Device{ DEVICE_OP(stats, DeviceOp::OPEN, backend->get_endpoint(AudioFlow::PLAY, p)) };
 }
 
 Device DeviceList::get_rec(const std::string& fin) const
 {
-    UINT num{};
-    rec->GetCount(&num);
-    IMMDevice* ptr;
-    for (UINT p = 0; p < num; ++p) {
-        rec->Item(p, &ptr);
-        Device dd{ ptr };
-        if (dd.get_friendly_name().find(fin) != std::string::npos) return Device{ ptr };
-    }
-    return Device{ nullptr }; // fails
+    return DEVICE_OP(stats, DeviceOp::FIND, _get(AudioFlow::REC, fin));
 }
 
 Device DeviceList::get_play(const std::string& fin) const
 {
-    UINT num{};
-    play->GetCount(&num);
-    IMMDevice* ptr;
-    for (UINT p = 0; p < num; ++p) {
-        play->Item(p, &ptr);
-        Device dd{ ptr };
-        if (dd.get_friendly_name().find(fin) != std::string::npos) return Device{ ptr };
-    }
-    return Device{ nullptr }; // fails
+    return DEVICE_OP(stats, DeviceOp::FIND, _get(AudioFlow::PLAY, fin));
 }
 
-Device DeviceList::get_default_rec(const AudioType t) const
+Device DeviceList::get_rec(const EndpointId& id) const
 {
-    IMMDevice* ptr = nullptr;
-    HRESULT hr = devenum->GetDefaultAudioEndpoint(eCapture, static_cast<ERole>(t), &ptr);
-
-    if (!ptr && get_num_rec()) {
-        return get_rec(0);
-    }
+    return _get(AudioFlow::REC, id);
+}
 
-    if (FAILED(hr)) {        
-        throw std::runtime_error("FAILED TO GET DEFAULT DEVICE FOR REC");
-    }
+Device DeviceList::get_play(const EndpointId& id) const
+{
+    return _get(AudioFlow::PLAY, id);
+}
 
-    return Device{ ptr };
+Device DeviceList::get_rec(const DeviceAlias& a) const
+{
+    return _get(AudioFlow::REC, a);
 }
 
-Device DeviceList::get_default_play(const AudioType t) const
+Device DeviceList::get_play(const DeviceAlias& a) const
 {
-    IMMDevice* ptr = nullptr;
-    HRESULT hr = devenum->GetDefaultAudioEndpoint(eRender, static_cast<ERole>(t), &ptr);
+    return _get(AudioFlow::PLAY, a);
+}
 
-    if (FAILED(hr)) {
-        throw std::runtime_error("FAILED TO GET DEFAULT DEVICE FOR REC");
-    }
+Device DeviceList::get_default_rec(const AudioType t) const
+{
+    return _get_default(AudioFlow::REC, t);
+}
 
-    return Device{ ptr };
+Device DeviceList::get_default_play(const AudioType t) const
+{
+    return _get_default(AudioFlow::PLAY, t);
 }
 
 Device DeviceList::find_default_rec() const
 {
-    IMMDevice* ptr = nullptr;
-    HRESULT hr = devenum->GetDefaultAudioEndpoint(eCapture, eConsole, &ptr);
-    if (FAILED(hr)) throw std::runtime_error("FAILED FIND DEFAULT 1 REC");
-    if (ptr) return Device{ ptr };
-    hr = devenum->GetDefaultAudioEndpoint(eCapture, eMultimedia, &ptr);
-    if (FAILED(hr)) throw std::runtime_error("FAILED FIND DEFAULT 2 REC");
-    if (ptr) return Device{ ptr };
-    hr = devenum->GetDefaultAudioEndpoint(eCapture, eCommunications, &ptr);
-    if (FAILED(hr)) throw std::runtime_error("FAILED FIND DEFAULT 3 REC");
-    if (ptr) return Device{ ptr };
-    if (get_num_rec()) return get_rec(0);
-    throw std::runtime_error("Cannot find a valid default rec device");
+    return _find_default(AudioFlow::REC);
 }
 
 Device DeviceList::find_default_play() const
 {
-    IMMDevice* ptr = nullptr;
-    HRESULT hr = devenum->GetDefaultAudioEndpoint(eRender, eConsole, &ptr);
-    if (FAILED(hr)) throw std::runtime_error("FAILED FIND DEFAULT 1 PLAY");
-    if (ptr) return Device{ ptr };
-    hr = devenum->GetDefaultAudioEndpoint(eRender, eMultimedia, &ptr);
-    if (FAILED(hr)) throw std::runtime_error("FAILED FIND DEFAULT 2 PLAY");
-    if (ptr) return Device{ ptr };
-    hr = devenum->GetDefaultAudioEndpoint(eRender, eCommunications, &ptr);
-    if (FAILED(hr)) throw std::runtime_error("FAILED FIND DEFAULT 3 PLAY");
-    if (ptr) return Device{ ptr };
-    if (get_num_play()) return get_play(0);
-    throw std::runtime_error("Cannot find a valid default play device");
-}
-
-
-
-#define EXIT_ON_ERROR(hres)  \
-              if (FAILED(hres)) { goto Exit; }
-#define SAFE_RELEASE(punk)  \
-              if ((punk) != NULL)  \
-                { (punk)->Release(); (punk) = NULL; }
-void _test()
-{
-    HRESULT hr = S_OK;
-    IMMDeviceEnumerator* pEnumerator = NULL;
-    IMMDeviceCollection* pCollection = NULL;
-    IMMDevice* pEndpoint = NULL;
-    IPropertyStore* pProps = NULL;
-    LPWSTR pwszID = NULL;
-
-    CoInitializeEx(NULL, COINIT_MULTITHREADED);
-
-    hr = CoCreateInstance(
-        __uuidof(MMDeviceEnumerator), NULL,
-        CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
-        (void**)&pEnumerator);
-
-    EXIT_ON_ERROR(hr)
-
-    hr = pEnumerator->EnumAudioEndpoints(
-            eRender, DEVICE_STATE_ACTIVE,
-            &pCollection);
-    EXIT_ON_ERROR(hr)
-
-    UINT  count;
-    hr = pCollection->GetCount(&count);
-    EXIT_ON_ERROR(hr)
-
-        if (count == 0)
-        {
-            printf("No endpoints found.\n");
-        }
-
-    // Each loop prints the name of an endpoint device.
-    for (ULONG i = 0; i < count; i++)
-    {
-        // Get pointer to endpoint number i.
-        hr = pCollection->Item(i, &pEndpoint);
-        EXIT_ON_ERROR(hr)
-
-            // Get the endpoint ID string.
-            hr = pEndpoint->GetId(&pwszID);
-        EXIT_ON_ERROR(hr)
-
-            hr = pEndpoint->OpenPropertyStore(
-                STGM_READ, &pProps);
-        EXIT_ON_ERROR(hr)
-
-            PROPVARIANT varName;
-        // Initialize container for property value.
-        PropVariantInit(&varName);
-
-        // Get the endpoint's friendly-name property.
-        hr = pProps->GetValue(
-            PKEY_Device_FriendlyName, &varName);
-        EXIT_ON_ERROR(hr)
-
-            // Print endpoint friendly name and endpoint ID.
-            printf("Endpoint %d: \"%S\" (%S)\n",
-                i, varName.pwszVal, pwszID);
-
-        CoTaskMemFree(pwszID);
-        pwszID = NULL;
-        PropVariantClear(&varName);
-        SAFE_RELEASE(pProps)
-            SAFE_RELEASE(pEndpoint)
-    }
-    SAFE_RELEASE(pEnumerator)
-        SAFE_RELEASE(pCollection)
-        return;
-Exit:
-    printf("Error!\n");
-    CoTaskMemFree(pwszID);
-    SAFE_RELEASE(pEnumerator)
-        SAFE_RELEASE(pCollection)
-        SAFE_RELEASE(pEndpoint)
-        SAFE_RELEASE(pProps)
+    return _find_default(AudioFlow::PLAY);
 }
@@ -1,77 +1,168 @@
 #pragma once
 
-#include <Windows.h>
-#include <mmdeviceapi.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <functiondiscoverykeys_devpkey.h>
-#include <endpointvolume.h>
+#include <stdint.h>
 #include <stdexcept>
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
 
-enum class AudioType {CONSOLE = eConsole, MULTIMEDIA = eMultimedia, COMMUNICATIONS = eCommunications};
+#include "AliasTable.h"
+#include "AudioBackend.h"
+#include "NameIndex.h"
+#include "OpStats.h"
 
 class VolumeDevice {
-	IAudioVolumeLevel* level = nullptr;
-	const std::string& name;
+	std::unique_ptr<BackendLevel> level;
+	DeviceOpStats* stats; // of the endpoint it belongs to
 
-	void _unload();
+	size_t _channels() const;
 public:
-	VolumeDevice(IAudioVolumeLevel*, const std::string&);
+	static const uint32_t all_channels = 0xFFFFFFFF;
+
+	VolumeDevice(std::unique_ptr<BackendLevel>, DeviceOpStats* = nullptr);
 	VolumeDevice(const VolumeDevice&) = delete;
 	VolumeDevice(VolumeDevice&&) noexcept;
 	void operator=(const VolumeDevice&) = delete;
-	void operator=(VolumeDevice&&) = delete;
+	VolumeDevice& operator=(VolumeDevice&&) noexcept;
 	~VolumeDevice();
 
 	float get_level(const size_t = static_cast<size_t>(-1)) const;
 	void set_level(const float, const size_t = static_cast<size_t>(-1));
 
+	// Whole channel vector (scalars) in one backend round trip
+	std::vector<float> get_levels() const;
+	// Throws std::invalid_argument if there is not one value per channel
+	void set_levels(const std::vector<float>&, const uint32_t = all_channels);
+	// Multiplies each channel in the mask by its gain (1.0 keeps it as it is)
+	void apply_gains(const std::vector<float>&, const uint32_t = all_channels);
+	// -1.0 full left .. 1.0 full right. Both sides start from the loudest of them, the other side is scaled down.
+	void set_balance(const float, const uint32_t = 0x1, const uint32_t = 0x2);
+
+	size_t get_channel_count() const;
+	const std::string& get_name() const;
+};
+
+// Mute or AGC control inside the topology
+class SwitchDevice {
+	std::unique_ptr<BackendSwitch> sw;
+	DeviceOpStats* stats;
+public:
+	SwitchDevice(std::unique_ptr<BackendSwitch>, DeviceOpStats* = nullptr);
+	SwitchDevice(const SwitchDevice&) = delete;
+	SwitchDevice(SwitchDevice&&) noexcept;
+	void operator=(const SwitchDevice&) = delete;
+	void operator=(SwitchDevice&&) = delete;
+	~SwitchDevice();
+
+	bool get() const;
+	void set(const bool);
+
 	const std::string& get_name() const;
 };
 
 class Device {
-	IMMDevice* device = nullptr;
-	IPropertyStore* pProps = nullptr;
-	IAudioEndpointVolume* vol = nullptr;
-	IDeviceTopology* topo = nullptr;
+	std::unique_ptr<BackendEndpoint> ep;
+	mutable std::atomic<DeviceOpStats*> stats{ nullptr }; // found by endpoint ID on the first operation
 
-	void _unload();
+	DeviceOpStats* _stats() const;
 public:
-	Device(IMMDevice*);
+	Device(std::unique_ptr<BackendEndpoint>);
 	Device(const Device&) = delete;
 	Device(Device&&) noexcept;
 	void operator=(const Device&) = delete;
-	void operator=(Device&&) = delete;
+	// takes over the endpoint, so devices can sit in a vector (see DeviceTable)
+	Device& operator=(Device&&) noexcept;
 	~Device();
 
+	std::string get_id() const;
 	std::string get_friendly_name() const;
 	void set_volume(const float);
 	float get_volume() const;
 	void set_mute(const bool);
 	bool get_mute() const;
-
+	// Peak per channel since the previous read (see PeakMeter to sample them continuously)
+	size_t get_meter_channel_count() const;
+	void get_peaks(float*, const size_t) const;
+	std::vector<float> get_peaks() const;
+
+	// Per-application streams on this endpoint (see SessionTable to keep them indexed)
+	std::vector<std::shared_ptr<BackendSession>> get_sessions();
+	void set_session_listener(SessionListener*);
+	// Volume and mute changes from anywhere (the OS mixer, other programs, this one), nullptr to stop
+	void set_volume_listener(VolumeListener*);
+
+	// Parts and controls between the endpoint and the hardware, built once and shared until the device changes
+	std::shared_ptr<const TopologyGraph> get_topology();
+	// n-th volume / mute / AGC control of the topology
 	VolumeDevice get_underlying_volume(const size_t = 0);
+	SwitchDevice get_underlying_switch(const NodeKind, const size_t = 0);
 };
 
-class DeviceList {
-	IMMDeviceEnumerator *devenum = nullptr;
-	IMMDeviceCollection *rec = nullptr, *play = nullptr;
-	static bool coinit;
+// Endpoint ID as given by BackendEndpoint::get_id, to pick the get_rec / get_play overload that opens it directly
+struct EndpointId {
+	std::string value;
+};
+// Name from the alias file (see AliasTable)
+struct DeviceAlias {
+	std::string name;
+};
 
-	template<typename T> inline void __funky_release(T*& dev) { if ((dev) != nullptr) { dev->Release(); dev = nullptr; } }
+// One endpoint opened by DeviceList::open_all
+struct OpenedDevice {
+	std::shared_ptr<Device> dev; // nullptr if opening it failed
+	std::string id, name;
+	float volume = 0.0f;
+	std::string error;
+};
 
-	void _delete_all();
+class DeviceList {
+	std::shared_ptr<AudioBackend> backend;
+	std::string name_cache;
+	size_t workers = 4;
+	mutable std::unique_ptr<NameIndex> index;
+	std::string alias_file = alias_file_default_path();
+	mutable std::unique_ptr<AliasTable> aliases;
+	DeviceOpStats* stats = nullptr; // lookups, not tied to one endpoint
+
+
+	Device _get_default(const AudioFlow, const AudioType) const;
+	Device _find_default(const AudioFlow) const;
+	Device _get(const AudioFlow, const std::string&) const;
+	Device _get(const AudioFlow, const EndpointId&) const;
+	Device _get(const AudioFlow, const DeviceAlias&) const;
 public:
 	DeviceList();
+	DeviceList(std::shared_ptr<AudioBackend>);
 	~DeviceList();
 
+	// Name lookups go through a NameIndex kept in this file (see name_cache_default_path), built on first use
+	void set_name_cache(const std::string&);
+	// Aliases come from this file (alias_file_default_path by default), read on first use
+	void set_alias_file(const std::string&);
+	// threads used to open many endpoints at once (1 = one after the other)
+	void set_workers(const size_t);
+	size_t get_workers() const;
+
+	// Every active endpoint of a flow in collection order, with its property store and endpoint volume already
+	// opened. That happens on the worker threads, so the slow COM calls of different endpoints overlap.
+	std::vector<OpenedDevice> open_all(const AudioFlow) const;
+
 	size_t get_num_rec() const;
 	size_t get_num_play() const;
 
 	Device get_rec(const std::string&) const;
 	Device get_play(const std::string&) const;
 
+	// Straight to that endpoint, however many there are. Throws if it is missing, inactive or of the other flow.
+	Device get_rec(const EndpointId&) const;
+	Device get_play(const EndpointId&) const;
+	// Throws if the alias is not in the file
+	Device get_rec(const DeviceAlias&) const;
+	Device get_play(const DeviceAlias&) const;
+
 	Device get_rec(const size_t) const;
 	Device get_play(const size_t) const;
 
@@ -81,5 +172,3 @@ public:
 	Device find_default_rec() const;
 	Device find_default_play() const;
 };
-
-void _test();
\ No newline at end of file
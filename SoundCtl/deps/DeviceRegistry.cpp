@@ -0,0 +1,183 @@
+#include "DeviceRegistry.h"
+
+const DeviceRegistry::Entry* DeviceRegistry::Snapshot::find(const AudioFlow f, const std::string& text) const
+{
+    const std::string key = fold_name(text);
+    for (const auto& i : devices[static_cast<size_t>(f)])
+        if (i.folded.find(key) != std::string::npos) return &i;
+    return nullptr;
+}
+
+const DeviceRegistry::Entry* DeviceRegistry::Snapshot::find_id(const AudioFlow f, const std::string& id) const
+{
+    const size_t fl = static_cast<size_t>(f);
+    const auto it = by_id[fl].find(id);
+    return it == by_id[fl].end() ? nullptr : &devices[fl][it->second];
+}
+
+const DeviceRegistry::Entry* DeviceRegistry::Snapshot::find_default(const AudioFlow f, const AudioType t) const
+{
+    const auto& vec = devices[static_cast<size_t>(f)];
+    const Entry* e = find_id(f, defaults[static_cast<size_t>(f)][static_cast<size_t>(t)]);
+    if (e) return e;
+    return vec.empty() ? nullptr : &vec.front();
+}
+
+void DeviceRegistry::Snapshot::index()
+{
+    for (size_t f = 0; f < 2; ++f) {
+        by_id[f].clear();
+        for (size_t p = 0; p < devices[f].size(); ++p) by_id[f].emplace(devices[f][p].id, p);
+    }
+}
+
+
+DeviceRegistry::DeviceRegistry(std::shared_ptr<AudioBackend> b)
+    : backend(std::move(b))
+{
+    if (!backend) throw std::invalid_argument("NULL BACKEND");
+
+    // subscribe before enumerating so nothing that happens in between is lost (replaying an event is harmless)
+    backend->set_listener(this);
+    current = _enumerate(); // no reader nor worker yet
+    worker = std::thread(&DeviceRegistry::_work, this);
+}
+
+DeviceRegistry::~DeviceRegistry()
+{
+    backend->set_listener(nullptr);
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        stop = true;
+    }
+    cond.notify_all();
+    worker.join();
+}
+
+std::shared_ptr<const DeviceRegistry::Snapshot> DeviceRegistry::get_snapshot() const
+{
+    std::lock_guard<std::mutex> l(snap_mtx);
+    return current;
+}
+
+Device DeviceRegistry::open(const std::string& id) const
+{
+    auto ep = backend->get_endpoint(id);
+    if (!ep) throw std::runtime_error("Device is gone: " + id);
+    return Device{ std::move(ep) };
+}
+
+void DeviceRegistry::on_device_changed(const std::string& id)
+{
+    _push(Event{ false, AudioFlow::PLAY, AudioType::CONSOLE, id });
+}
+
+void DeviceRegistry::on_default_changed(const AudioFlow f, const AudioType t, const std::string& id)
+{
+    _push(Event{ true, f, t, id });
+}
+
+void DeviceRegistry::_push(Event&& e)
+{
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        pending.push_back(std::move(e));
+    }
+    cond.notify_one();
+}
+
+void DeviceRegistry::_work()
+{
+    while (true) {
+        std::deque<Event> batch;
+        {
+            std::unique_lock<std::mutex> l(mtx);
+            cond.wait(l, [this] { return stop || !pending.empty(); });
+            if (stop) return;
+            batch.swap(pending);
+        }
+
+        // patch a copy, then publish it in one go (only this thread replaces current, it can read it without the lock)
+        auto next = std::make_shared<Snapshot>(*current);
+        for (const auto& e : batch) {
+            try {
+                _apply(*next, e);
+            }
+            catch (...) {
+                // the device went away while we looked at it, its removal event follows
+            }
+        }
+        next->index();
+        ++next->version;
+        std::shared_ptr<const Snapshot> old;
+        {
+            std::lock_guard<std::mutex> l(snap_mtx);
+            old = std::exchange(current, std::move(next));
+        }
+        // the last reference to the old one (if no reader has it) goes outside the lock
+    }
+}
+
+void DeviceRegistry::_apply(Snapshot& snap, const Event& e) const
+{
+    if (e.is_default) {
+        snap.defaults[static_cast<size_t>(e.flow)][static_cast<size_t>(e.type)] = e.id;
+        return;
+    }
+
+    const auto ep = backend->get_endpoint(e.id);
+
+    Entry fresh;
+    size_t flow = 0;
+    if (ep && ep->is_active()) {
+        fresh.id = e.id;
+        fresh.name = ep->get_friendly_name();
+        fresh.folded = fold_name(fresh.name);
+        flow = static_cast<size_t>(ep->get_flow());
+    }
+
+    // drop the old entry, keeping its position so a rename or a quick replug does not reorder the table
+    size_t pos = static_cast<size_t>(-1);
+    for (size_t f = 0; f < 2; ++f) {
+        auto& vec = snap.devices[f];
+        for (size_t p = 0; p < vec.size(); ++p) {
+            if (vec[p].id != e.id) continue;
+            vec.erase(vec.begin() + p);
+            if (f == flow) pos = p;
+            break;
+        }
+    }
+
+    if (fresh.id.empty()) return;
+    auto& vec = snap.devices[flow];
+    vec.insert(pos < vec.size() ? vec.begin() + pos : vec.end(), std::move(fresh));
+}
+
+std::shared_ptr<DeviceRegistry::Snapshot> DeviceRegistry::_enumerate() const
+{
+    auto snap = std::make_shared<Snapshot>();
+
+    for (size_t f = 0; f < 2; ++f) {
+        const AudioFlow flow = static_cast<AudioFlow>(f);
+        const size_t num = backend->get_count(flow);
+
+        for (size_t p = 0; p < num; ++p) {
+            const auto ep = backend->get_endpoint(flow, p);
+            if (!ep) continue;
+
+            Entry e;
+            e.id = ep->get_id();
+            e.name = ep->get_friendly_name();
+            e.folded = fold_name(e.name);
+            snap->devices[f].push_back(std::move(e));
+        }
+
+        for (const AudioType t : { AudioType::CONSOLE, AudioType::MULTIMEDIA, AudioType::COMMUNICATIONS }) {
+            const auto ep = backend->get_default(flow, t);
+            if (ep) snap->defaults[f][static_cast<size_t>(t)] = ep->get_id();
+        }
+    }
+
+    snap->index();
+    return snap;
+}
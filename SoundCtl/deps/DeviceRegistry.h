@@ -0,0 +1,74 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "DeviceManager.h"
+
+// Live table of the active endpoints, kept current by backend notifications instead of re-enumerating.
+// Readers take an immutable snapshot and never wait for a notification to be processed: the worker builds the next
+// snapshot on the side and swaps it in. Taking one is not lock-free, it holds a lock of its own for a pointer copy
+// (so does std::atomic_load on a shared_ptr, with a lock shared by the whole process).
+class DeviceRegistry : private BackendListener {
+public:
+	struct Entry {
+		std::string id, name, folded;
+	};
+	struct Snapshot {
+		uint64_t version = 0;
+		std::vector<Entry> devices[2];  // by AudioFlow, active endpoints only
+		std::string defaults[2][3];     // ID by AudioFlow and AudioType, empty if none
+		std::unordered_map<std::string, size_t> by_id[2]; // position in devices, rebuilt whenever they change
+
+		// first endpoint whose name contains the text (case-insensitive), nullptr if none
+		const Entry* find(const AudioFlow, const std::string&) const;
+		// one hash probe
+		const Entry* find_id(const AudioFlow, const std::string&) const;
+		// default for that role, or the first endpoint if there is none
+		const Entry* find_default(const AudioFlow, const AudioType) const;
+
+		void index();
+	};
+private:
+	struct Event {
+		bool is_default;
+		AudioFlow flow;
+		AudioType type;
+		std::string id;
+	};
+
+	const std::shared_ptr<AudioBackend> backend;
+	std::shared_ptr<const Snapshot> current; // written by the worker only
+	mutable std::mutex snap_mtx;             // guards current, held for a pointer copy or swap
+
+	std::deque<Event> pending;
+	std::mutex mtx;
+	std::condition_variable cond;
+	bool stop = false;
+	std::thread worker;
+
+	void on_device_changed(const std::string&) override;
+	void on_default_changed(const AudioFlow, const AudioType, const std::string&) override;
+
+	void _push(Event&&);
+	void _work();
+	void _apply(Snapshot&, const Event&) const;
+	std::shared_ptr<Snapshot> _enumerate() const;
+public:
+	DeviceRegistry(std::shared_ptr<AudioBackend>);
+	DeviceRegistry(const DeviceRegistry&) = delete;
+	void operator=(const DeviceRegistry&) = delete;
+	~DeviceRegistry();
+
+	std::shared_ptr<const Snapshot> get_snapshot() const;
+
+	// Throws if the endpoint is gone
+	Device open(const std::string&) const;
+};
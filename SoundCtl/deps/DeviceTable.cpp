@@ -0,0 +1,130 @@
+#include "DeviceTable.h"
+
+size_t DeviceTable::load(const DeviceList& devl, const AudioFlow f)
+{
+    auto opened = devl.open_all(f);
+
+    devices.clear();
+    ids.clear();
+    names.clear();
+    by_id.clear();
+    volumes.clear();
+    mutes.clear();
+    channels.clear();
+
+    // one allocation per array
+    devices.reserve(opened.size());
+    ids.reserve(opened.size());
+    names.reserve(opened.size());
+    volumes.reserve(opened.size());
+    mutes.reserve(opened.size());
+    channels.reserve(opened.size());
+    by_id.reserve(opened.size());
+
+    for (auto& o : opened) {
+        if (!o.dev) continue;
+
+        bool mute;
+        uint32_t ch = 0;
+        try {
+            mute = o.dev->get_mute();
+        }
+        catch (...) {
+            continue; // gone since open_all
+        }
+        try {
+            ch = static_cast<uint32_t>(o.dev->get_meter_channel_count());
+        }
+        catch (...) {
+        }
+
+        // open_all hands out the only reference, the device can be moved out of it
+        by_id.emplace(o.id, devices.size());
+        devices.push_back(std::move(*o.dev));
+        ids.push_back(std::move(o.id));
+        names.push_back(std::move(o.name));
+        volumes.push_back(o.volume);
+        mutes.push_back(mute ? 1 : 0);
+        channels.push_back(ch);
+    }
+    return devices.size();
+}
+
+size_t DeviceTable::size() const
+{
+    return devices.size();
+}
+
+size_t DeviceTable::find(const std::string& id) const
+{
+    const auto it = by_id.find(id);
+    return it == by_id.end() ? static_cast<size_t>(-1) : it->second;
+}
+
+Device& DeviceTable::get(const size_t p)
+{
+    return devices.at(p);
+}
+
+const std::string& DeviceTable::get_id(const size_t p) const
+{
+    return ids.at(p);
+}
+
+const std::string& DeviceTable::get_name(const size_t p) const
+{
+    return names.at(p);
+}
+
+float DeviceTable::get_volume(const size_t p) const
+{
+    return volumes.at(p);
+}
+
+bool DeviceTable::get_mute(const size_t p) const
+{
+    return mutes.at(p) != 0;
+}
+
+uint32_t DeviceTable::get_channel_count(const size_t p) const
+{
+    return channels.at(p);
+}
+
+const std::vector<float>& DeviceTable::get_volumes() const
+{
+    return volumes;
+}
+
+const std::vector<uint8_t>& DeviceTable::get_mutes() const
+{
+    return mutes;
+}
+
+void DeviceTable::set_volume(const size_t p, const float f)
+{
+    if (f < 0.0f || f > 1.0f) return; // as Device does
+    devices.at(p).set_volume(f);
+    volumes[p] = f;
+}
+
+void DeviceTable::set_mute(const size_t p, const bool b)
+{
+    devices.at(p).set_mute(b);
+    mutes[p] = b ? 1 : 0;
+}
+
+size_t DeviceTable::refresh()
+{
+    size_t failed = 0;
+    for (size_t p = 0; p < devices.size(); ++p) {
+        try {
+            volumes[p] = devices[p].get_volume();
+            mutes[p] = devices[p].get_mute() ? 1 : 0;
+        }
+        catch (...) {
+            ++failed;
+        }
+    }
+    return failed;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceManager.h"
+
+// Every active endpoint of one flow, opened once and kept side by side in one vector. The state read most often is
+// cached apart from the devices, one array per field, so a pass over hundreds of endpoints reads a few contiguous
+// cache lines and allocates nothing. refresh() brings the cache up to date in one pass; writes go through it.
+// Not thread safe: one owner, like a Device.
+class DeviceTable {
+	std::vector<Device> devices;
+	std::vector<std::string> ids, names;
+	std::unordered_map<std::string, size_t> by_id;
+
+	// by position, same as devices
+	std::vector<float> volumes;
+	std::vector<uint8_t> mutes;     // 0 / 1, a byte each so the array can be scanned as is
+	std::vector<uint32_t> channels; // meter channels, 0 if the endpoint has no meter
+public:
+	DeviceTable() = default;
+	DeviceTable(const DeviceTable&) = delete;
+	DeviceTable(DeviceTable&&) = default;
+	void operator=(const DeviceTable&) = delete;
+	DeviceTable& operator=(DeviceTable&&) = default;
+
+	// Opens every active endpoint of the flow (see DeviceList::open_all) and reads its state. Endpoints that cannot
+	// be opened are left out. Returns how many were.
+	size_t load(const DeviceList&, const AudioFlow);
+
+	size_t size() const;
+	// position of that endpoint ID, npos if it is not in the table
+	size_t find(const std::string&) const;
+
+	Device& get(const size_t);
+	const std::string& get_id(const size_t) const;
+	const std::string& get_name(const size_t) const;
+
+	// Cached as of the last load or refresh, or the last write through the table
+	float get_volume(const size_t) const;
+	bool get_mute(const size_t) const;
+	uint32_t get_channel_count(const size_t) const;
+	const std::vector<float>& get_volumes() const;
+	const std::vector<uint8_t>& get_mutes() const;
+
+	// Written to the endpoint, then to the cache. Throws as Device does.
+	void set_volume(const size_t, const float);
+	void set_mute(const size_t, const bool);
+
+	// Reads volume and mute of every endpoint again. An endpoint that fails (unplugged) keeps its cached values.
+	// Returns how many failed.
+	size_t refresh();
+};
@@ -0,0 +1,293 @@
+#include "DuckEngine.h"
+#include "Command.h"
+
+#include <algorithm>
+
+static const size_t reaction_window = 4096;
+
+DuckRule DuckRule::parse(const std::string& spec)
+{
+    DuckRule r;
+    size_t pos = 0;
+
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+
+        const std::string item = spec.substr(pos, end - pos);
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos) throw std::invalid_argument("Invalid duck option: " + item);
+
+        const std::string key = item.substr(0, eq);
+        const std::string val = item.substr(eq + 1);
+
+        if (key == "thr") r.threshold = std::stof(val);
+        else if (key == "depth") r.depth = std::stof(val);
+        else if (key == "attack") r.attack = std::chrono::milliseconds(std::stoul(val));
+        else if (key == "hold") r.hold = std::chrono::milliseconds(std::stoul(val));
+        else if (key == "release") r.release = std::chrono::milliseconds(std::stoul(val));
+        else if (key == "curve") r.curve = parse_curve(val);
+        else throw std::invalid_argument("Unknown duck option: " + key);
+
+        pos = end + 1;
+    }
+
+    if (!(r.threshold > 0.0f && r.threshold <= 1.0f)) throw std::invalid_argument("Invalid duck threshold");
+    if (!(r.depth >= 0.0f && r.depth <= 1.0f)) throw std::invalid_argument("Invalid duck depth");
+    return r;
+}
+
+// callers measure one tick ahead, so the tick that starts a ramp already moves the volume
+static float _progress(const std::chrono::steady_clock::duration done, const std::chrono::milliseconds length)
+{
+    if (length.count() <= 0) return 1.0f;
+    return std::chrono::duration<float>(done).count() / std::chrono::duration<float>(length).count();
+}
+
+DuckEngine::DuckEngine(const std::chrono::microseconds p)
+    : period(p)
+{
+    if (period.count() <= 0) throw std::invalid_argument("Invalid duck period");
+}
+
+DuckEngine::~DuckEngine()
+{
+    stop();
+}
+
+size_t DuckEngine::add(std::shared_ptr<Device> source, const DuckRule& cfg)
+{
+    if (!source) throw std::invalid_argument("NULL DEVICE");
+    if (running) throw std::runtime_error("Ducking already running");
+
+    auto r = std::make_unique<Rule>();
+    r->cfg = cfg;
+    r->peaks.resize(source->get_meter_channel_count());
+    r->source = std::move(source);
+    rules.push_back(std::move(r));
+    return rules.size() - 1;
+}
+
+void DuckEngine::add_target(const size_t rule, std::shared_ptr<Device> dev)
+{
+    if (!dev) throw std::invalid_argument("NULL DEVICE");
+    if (running) throw std::runtime_error("Ducking already running");
+
+    Target t;
+    t.dev = std::move(dev);
+    rules.at(rule)->targets.push_back(std::move(t));
+}
+
+void DuckEngine::add_target(const size_t rule, std::shared_ptr<Device> dev, const std::string& app)
+{
+    if (!dev) throw std::invalid_argument("NULL DEVICE");
+    if (running) throw std::runtime_error("Ducking already running");
+
+    Target t;
+    t.sessions = std::make_shared<SessionTable>(dev);
+    t.dev = std::move(dev);
+    t.app = app;
+    rules.at(rule)->targets.push_back(std::move(t));
+}
+
+void DuckEngine::start()
+{
+    if (running.exchange(true)) return;
+    worker = std::thread(&DuckEngine::_work, this);
+}
+
+void DuckEngine::stop()
+{
+    running = false;
+    if (worker.joinable()) worker.join();
+
+    for (auto& r : rules) {
+        if (r->phase == Phase::IDLE) continue;
+        _write(*r, 1.0f);
+        r->phase = Phase::IDLE;
+    }
+}
+
+DuckEngine::Stats DuckEngine::get_stats() const
+{
+    Stats st;
+    st.ticks = ticks.load(std::memory_order_relaxed);
+    if (st.ticks) {
+        st.jitter_avg_us = late_ns.load(std::memory_order_relaxed) / 1e3 / st.ticks;
+        st.busy_ratio = busy_ns.load(std::memory_order_relaxed) / 1e3 / (static_cast<double>(st.ticks) * period.count());
+    }
+
+    for (const auto& r : rules) {
+        RuleStats s;
+        s.triggers = r->triggers.load(std::memory_order_relaxed);
+        s.writes = r->writes.load(std::memory_order_relaxed);
+        s.errors = r->errors.load(std::memory_order_relaxed);
+
+        std::vector<uint64_t> vec;
+        uint64_t count, sum, max;
+        {
+            std::lock_guard<std::mutex> l(reactions_mtx);
+            vec = r->reactions_ns;
+            count = r->reactions;
+            sum = r->reaction_sum_ns;
+            max = r->reaction_max_ns;
+        }
+        if (count) s.reaction_avg_us = sum / 1e3 / count;
+        s.reaction_max_us = max / 1e3;
+        if (!vec.empty()) {
+            std::sort(vec.begin(), vec.end());
+            s.reaction_p50_us = vec[vec.size() / 2] / 1e3;
+            s.reaction_p99_us = vec[std::min(vec.size() - 1, vec.size() * 99 / 100)] / 1e3;
+        }
+        st.rules.push_back(s);
+    }
+    return st;
+}
+
+// what the targets are at right before ducking, release brings them back there
+void DuckEngine::_capture(Rule& r)
+{
+    for (auto& t : r.targets) {
+        try {
+            if (!t.sessions) {
+                t.base = t.dev->get_volume();
+                continue;
+            }
+            t.ducked.clear();
+            for (auto& s : t.sessions->find(t.app)) {
+                const float v = s->get_volume();
+                t.ducked.emplace_back(std::move(s), v);
+            }
+        }
+        catch (...) {
+            r.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t DuckEngine::_write(Rule& r, const float gain)
+{
+    if (gain == r.written) return 0;
+    r.written = gain;
+
+    size_t n = 0;
+    for (auto& t : r.targets) {
+        try {
+            if (!t.sessions) {
+                t.dev->set_volume(t.base * gain);
+                ++n;
+                continue;
+            }
+            for (auto& s : t.ducked) {
+                try {
+                    s.first->set_volume(s.second * gain);
+                    ++n;
+                }
+                catch (...) {
+                    r.errors.fetch_add(1, std::memory_order_relaxed); // the application quit
+                }
+            }
+        }
+        catch (...) {
+            r.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    r.writes.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+void DuckEngine::_step(Rule& r, const std::chrono::steady_clock::time_point now)
+{
+    using clock = std::chrono::steady_clock;
+
+    float peak = 0.0f;
+    try {
+        r.source->get_peaks(r.peaks.data(), r.peaks.size());
+        for (const float p : r.peaks) peak = std::max(peak, p);
+    }
+    catch (...) {
+        r.errors.fetch_add(1, std::memory_order_relaxed);
+        return; // unplugged: whatever is ducked stays so until it comes back or the engine stops
+    }
+    const bool loud = (peak >= r.cfg.threshold);
+    if (loud) r.last_loud = now;
+
+    switch (r.phase) {
+    case Phase::IDLE:
+        if (!loud) return;
+        _capture(r);
+        r.triggers.fetch_add(1, std::memory_order_relaxed);
+        r.trigger = now;
+        r.reacted = false;
+        r.from = 1.0f;
+        r.ramp_start = now;
+        r.phase = Phase::ATTACK;
+        break;
+    case Phase::RELEASE:
+        if (loud) {
+            // back down from where the release got to, the volumes from before the first duck still stand
+            r.from = r.gain;
+            r.ramp_start = now;
+            r.phase = Phase::ATTACK;
+        }
+        break;
+    case Phase::HOLD:
+        if (now - r.last_loud >= r.cfg.hold) {
+            r.from = r.gain;
+            r.ramp_start = now;
+            r.phase = Phase::RELEASE;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (r.phase == Phase::ATTACK) {
+        const float t = _progress(now - r.ramp_start + period, r.cfg.attack);
+        r.gain = ramp_value(r.from, r.cfg.depth, t, r.cfg.curve);
+        if (t >= 1.0f) r.phase = Phase::HOLD;
+    }
+    else if (r.phase == Phase::RELEASE) {
+        const float t = _progress(now - r.ramp_start + period, r.cfg.release);
+        r.gain = ramp_value(r.from, 1.0f, t, r.cfg.curve);
+        if (t >= 1.0f) {
+            r.gain = 1.0f;
+            r.phase = Phase::IDLE;
+        }
+    }
+
+    // a duck that wrote nothing (no matching session yet) has not reacted
+    if (_write(r, r.gain) && !r.reacted) {
+        r.reacted = true;
+        const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - r.trigger).count();
+        std::lock_guard<std::mutex> l(reactions_mtx);
+        ++r.reactions;
+        r.reaction_sum_ns += ns;
+        r.reaction_max_ns = std::max(r.reaction_max_ns, ns);
+        if (r.reactions_ns.size() < reaction_window) r.reactions_ns.push_back(ns);
+        else r.reactions_ns[r.reaction_next] = ns;
+        r.reaction_next = (r.reaction_next + 1) % reaction_window;
+    }
+}
+
+void DuckEngine::_work()
+{
+    using clock = std::chrono::steady_clock;
+    auto next = clock::now();
+
+    while (running.load(std::memory_order_relaxed)) {
+        next += period;
+        timer.wait_until(next);
+
+        const auto now = clock::now();
+        if (now > next) late_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(now - next).count(), std::memory_order_relaxed);
+
+        for (auto& r : rules) _step(*r, now);
+
+        ticks.fetch_add(1, std::memory_order_relaxed);
+        busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - now).count(), std::memory_order_relaxed);
+
+        // fell behind by more than a tick: skip the missed ones
+        while (next + period < now) next += period;
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeviceManager.h"
+#include "PrecisionTimer.h"
+#include "RampEngine.h"
+#include "SessionTable.h"
+
+// When to duck and how far. Peaks and depth are scalars [0..1].
+struct DuckRule {
+	float threshold = 0.1f; // capture peak that counts as someone speaking
+	float depth = 0.3f;     // ducked volume, as a fraction of the volume the target had before
+	std::chrono::milliseconds attack{ 20 };   // ramp down
+	std::chrono::milliseconds hold{ 500 };    // stay down that long after the last peak over the threshold
+	std::chrono::milliseconds release{ 800 }; // ramp back up
+	RampCurve curve = RampCurve::DB_LINEAR;
+
+	// "thr=0.1,depth=0.3,attack=20,hold=500,release=800,curve=db" (times in ms). Missing keys keep their defaults.
+	static DuckRule parse(const std::string&);
+};
+
+// Ducks playback endpoints or application sessions while a capture endpoint picks something up, and brings them back.
+// Everything runs on one thread at a fixed tick (a few ms): read the peak of each rule's capture endpoint, step its
+// state (idle, attack, hold, release), write the ramped volume of its targets. A rule that is loud again while
+// releasing ramps back down from where it is.
+// Reaction latency is the time from the tick that read the first peak over the threshold to the end of the first
+// ducked write; the meter itself may lag the sound by up to one tick on top of that.
+// Two rules lowering the same target each restore the volume they found, so give every target to one rule only.
+class DuckEngine {
+public:
+	struct RuleStats {
+		uint64_t triggers = 0;     // idle -> attack
+		uint64_t writes = 0;
+		uint64_t errors = 0;       // failed peak reads and volume writes
+		double reaction_avg_us = 0, reaction_p50_us = 0, reaction_p99_us = 0, reaction_max_us = 0;
+	};
+	struct Stats {
+		uint64_t ticks = 0;
+		double jitter_avg_us = 0;
+		double busy_ratio = 0;     // time spent reading and writing / time running
+		std::vector<RuleStats> rules;
+	};
+private:
+	enum class Phase { IDLE, ATTACK, HOLD, RELEASE };
+
+	struct Target {
+		std::shared_ptr<Device> dev;
+		std::shared_ptr<SessionTable> sessions; // set: the sessions matching app, else the endpoint
+		std::string app;
+		// volumes from before the duck, what release goes back to
+		float base = 1.0f;
+		std::vector<std::pair<std::shared_ptr<BackendSession>, float>> ducked;
+	};
+	struct Rule {
+		DuckRule cfg;
+		std::shared_ptr<Device> source;
+		std::vector<float> peaks;
+		std::vector<Target> targets;
+
+		Phase phase = Phase::IDLE;
+		float gain = 1.0f, from = 1.0f, written = 1.0f;
+		std::chrono::steady_clock::time_point ramp_start, last_loud, trigger;
+		bool reacted = true;
+
+		std::atomic<uint64_t> triggers{ 0 }, writes{ 0 }, errors{ 0 };
+		// under reactions_mtx: the last reaction_window ones for the percentiles, all of them for the average and max
+		std::vector<uint64_t> reactions_ns;
+		size_t reaction_next = 0;
+		uint64_t reactions = 0, reaction_sum_ns = 0, reaction_max_ns = 0;
+	};
+
+	const std::chrono::microseconds period;
+	std::vector<std::unique_ptr<Rule>> rules;
+	std::atomic<uint64_t> ticks{ 0 }, late_ns{ 0 }, busy_ns{ 0 };
+	std::atomic<bool> running{ false };
+	mutable std::mutex reactions_mtx;
+	PrecisionTimer timer;
+	std::thread worker;
+
+	void _work();
+	void _step(Rule&, const std::chrono::steady_clock::time_point);
+	void _capture(Rule&);
+	// returns how many volumes it wrote
+	size_t _write(Rule&, const float);
+public:
+	DuckEngine(const std::chrono::microseconds = std::chrono::milliseconds(5));
+	DuckEngine(const DuckEngine&) = delete;
+	void operator=(const DuckEngine&) = delete;
+	~DuckEngine();
+
+	// Only before start(). Returns the rule index used by add_target and in the stats.
+	size_t add(std::shared_ptr<Device>, const DuckRule&);
+	// the endpoint volume
+	void add_target(const size_t, std::shared_ptr<Device>);
+	// the sessions of that endpoint matching the text (see SessionTable::find), looked up again on every duck
+	void add_target(const size_t, std::shared_ptr<Device>, const std::string&);
+
+	void start();
+	// Puts every ducked target back where it was
+	void stop();
+
+	Stats get_stats() const;
+};
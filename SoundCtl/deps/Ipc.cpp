@@ -0,0 +1,279 @@
+#include "Ipc.h"
+
+#ifdef _WIN32
+#include <sddl.h>
+#include <vector>
+
+static std::wstring _widen(const std::string& s)
+{
+    return std::wstring(s.begin(), s.end());
+}
+
+// string form of the SID of the user running this process, read once
+static const std::string& _user_sid()
+{
+    static const std::string sid = [] {
+        HANDLE tok = NULL;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &tok)) throw std::runtime_error("OpenProcessToken FAILED!");
+        DWORD size = 0;
+        GetTokenInformation(tok, TokenUser, NULL, 0, &size);
+        std::vector<BYTE> buf(size);
+        const BOOL ok = size && GetTokenInformation(tok, TokenUser, buf.data(), size, &size);
+        CloseHandle(tok);
+        if (!ok) throw std::runtime_error("GetTokenInformation FAILED!");
+
+        LPSTR str = NULL;
+        if (!ConvertSidToStringSidA(reinterpret_cast<TOKEN_USER*>(buf.data())->User.Sid, &str)) throw std::runtime_error("ConvertSidToStringSid FAILED!");
+        std::string s(str);
+        LocalFree(str);
+        return s;
+    }();
+    return sid;
+}
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+#ifdef _WIN32
+IpcConnection::IpcConnection(HANDLE hnd)
+    : h(hnd)
+{
+    if (h == INVALID_HANDLE_VALUE) throw std::invalid_argument("NULL CONNECTION");
+}
+
+IpcConnection::IpcConnection(IpcConnection&& c) noexcept
+    : h(std::exchange(c.h, INVALID_HANDLE_VALUE)), buf(std::move(c.buf))
+{
+}
+
+void IpcConnection::_close()
+{
+    if (h != INVALID_HANDLE_VALUE) { CloseHandle(h); h = INVALID_HANDLE_VALUE; }
+}
+#else
+IpcConnection::IpcConnection(int f)
+    : fd(f)
+{
+    if (fd < 0) throw std::invalid_argument("NULL CONNECTION");
+}
+
+IpcConnection::IpcConnection(IpcConnection&& c) noexcept
+    : fd(std::exchange(c.fd, -1)), buf(std::move(c.buf))
+{
+}
+
+void IpcConnection::_close()
+{
+    if (fd >= 0) { close(fd); fd = -1; }
+}
+#endif
+
+IpcConnection::~IpcConnection()
+{
+    _close();
+}
+
+bool IpcConnection::read_line(std::string& line)
+{
+    char tmp[512];
+
+    for (size_t nl = buf.find('\n'); nl == std::string::npos; nl = buf.find('\n')) {
+#ifdef _WIN32
+        DWORD got = 0;
+        if (!ReadFile(h, tmp, sizeof(tmp), &got, NULL) || got == 0) return false;
+#else
+        const ssize_t got = recv(fd, tmp, sizeof(tmp), 0);
+        if (got <= 0) return false;
+#endif
+        buf.append(tmp, static_cast<size_t>(got));
+    }
+
+    const size_t nl = buf.find('\n');
+    line = buf.substr(0, nl);
+    buf.erase(0, nl + 1);
+    return true;
+}
+
+bool IpcConnection::write_line(const std::string& line)
+{
+    const std::string out = line + '\n';
+#ifdef _WIN32
+    DWORD put = 0;
+    return WriteFile(h, out.data(), static_cast<DWORD>(out.size()), &put, NULL) && put == out.size();
+#else
+    size_t put = 0;
+    while (put < out.size()) {
+        const ssize_t n = send(fd, out.data() + put, out.size() - put, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        put += static_cast<size_t>(n);
+    }
+    return true;
+#endif
+}
+
+
+#ifdef _WIN32
+// The default DACL lets Everyone read the pipe: only the user running the server gets in, and only from this machine
+static HANDLE _create_pipe(const std::string& name, const DWORD flags)
+{
+    const std::string sddl = "D:P(A;;GA;;;" + _user_sid() + ")";
+    PSECURITY_DESCRIPTOR sd = NULL;
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorA(sddl.c_str(), SDDL_REVISION_1, &sd, NULL)) return INVALID_HANDLE_VALUE;
+    SECURITY_ATTRIBUTES sa{ sizeof(sa), sd, FALSE };
+
+    HANDLE h = CreateNamedPipeW(_widen(name).c_str(), PIPE_ACCESS_DUPLEX | flags,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES,
+        4096, 4096, 0, &sa);
+    const DWORD err = GetLastError();
+    LocalFree(sd);
+    SetLastError(err); // the callers look at it
+    return h;
+}
+
+IpcServer::IpcServer(const std::string& nam)
+    : name(nam)
+{
+    // the first instance is created here so a second server fails instead of sharing the name
+    pending = _create_pipe(name, FILE_FLAG_FIRST_PIPE_INSTANCE);
+    if (pending == INVALID_HANDLE_VALUE) {
+        if (GetLastError() == ERROR_ACCESS_DENIED) throw std::runtime_error("Another instance is listening on " + name);
+        throw std::runtime_error("CreateNamedPipe FAILED!");
+    }
+}
+
+IpcServer::~IpcServer()
+{
+    if (pending != INVALID_HANDLE_VALUE) CloseHandle(pending);
+}
+
+IpcConnection IpcServer::accept()
+{
+    HANDLE h = std::exchange(pending, INVALID_HANDLE_VALUE);
+    if (h == INVALID_HANDLE_VALUE) h = _create_pipe(name, 0);
+    if (h == INVALID_HANDLE_VALUE) throw std::runtime_error("CreateNamedPipe FAILED!");
+
+    // ERROR_NO_DATA: the client connected and left already
+    if (!ConnectNamedPipe(h, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+        const DWORD err = GetLastError();
+        CloseHandle(h);
+        throw std::runtime_error("ConnectNamedPipe FAILED! (" + std::to_string(err) + ")");
+    }
+    return IpcConnection{ h };
+}
+
+IpcConnection ipc_connect(const std::string& name)
+{
+    const std::wstring wname = _widen(name);
+
+    for (int tries = 0; tries < 10; ++tries) {
+        HANDLE h = CreateFileW(wname.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (h != INVALID_HANDLE_VALUE) return IpcConnection{ h };
+        if (GetLastError() != ERROR_PIPE_BUSY) break;
+        // every instance busy: the server creates a new one right after each accept
+        WaitNamedPipeW(wname.c_str(), 100);
+    }
+    throw std::runtime_error("Cannot connect to " + name);
+}
+
+std::string ipc_default_name()
+{
+    // pipe names are machine-wide: one per user and logon session, like the audio the instance controls
+    DWORD session = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &session);
+    return "\\\\.\\pipe\\SoundCtl-" + _user_sid() + "-" + std::to_string(session);
+}
+#else
+std::string user_runtime_dir()
+{
+    const char* base = getenv("XDG_RUNTIME_DIR");
+    if (base && *base) return base; // private to the user by definition
+    return "/tmp/soundctl-" + std::to_string(getuid());
+}
+
+void prepare_runtime_path(const std::string& path)
+{
+    const std::string dir = user_runtime_dir();
+    if (path.compare(0, dir.size() + 1, dir + "/") != 0) return;
+
+    // /tmp is shared: anyone could have made that directory (or a symlink by that name) first
+    if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) throw std::runtime_error("Cannot create " + dir);
+    struct stat st;
+    if (lstat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() || (st.st_mode & 077) != 0)
+        throw std::runtime_error("Not a private directory: " + dir);
+}
+
+IpcServer::IpcServer(const std::string& nam)
+    : name(nam)
+{
+    prepare_runtime_path(name);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (name.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("Socket path too long");
+    strcpy(addr.sun_path, name.c_str());
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("socket FAILED!");
+
+    // only a socket nobody answers on is left over from an instance that died, anything else is in use
+    const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    const bool taken = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    if (probe >= 0) close(probe);
+    if (taken) {
+        close(fd);
+        throw std::runtime_error("Another instance is listening on " + name);
+    }
+
+    unlink(name.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot listen on " + name);
+    }
+}
+
+IpcServer::~IpcServer()
+{
+    close(fd);
+    unlink(name.c_str());
+}
+
+IpcConnection IpcServer::accept()
+{
+    for (;;) {
+        const int c = ::accept(fd, nullptr, nullptr);
+        if (c >= 0) return IpcConnection{ c };
+        // a signal, or a client that gave up before we got to it
+        if (errno != EINTR && errno != ECONNABORTED) throw std::runtime_error(std::string("accept FAILED! (") + strerror(errno) + ")");
+    }
+}
+
+IpcConnection ipc_connect(const std::string& name)
+{
+    prepare_runtime_path(name); // a server in somebody else's directory is not ours
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (name.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("Socket path too long");
+    strcpy(addr.sun_path, name.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("socket FAILED!");
+
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot connect to " + name);
+    }
+    return IpcConnection{ fd };
+}
+
+std::string ipc_default_name()
+{
+    return user_runtime_dir() + "/soundctl.sock";
+}
+#endif
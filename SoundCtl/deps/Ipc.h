@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Local line-based transport: a named pipe on Windows, a unix socket elsewhere.
+
+class IpcConnection {
+#ifdef _WIN32
+	HANDLE h = INVALID_HANDLE_VALUE;
+#else
+	int fd = -1;
+#endif
+	std::string buf;
+
+	void _close();
+public:
+#ifdef _WIN32
+	IpcConnection(HANDLE);
+#else
+	IpcConnection(int);
+#endif
+	IpcConnection(const IpcConnection&) = delete;
+	IpcConnection(IpcConnection&&) noexcept;
+	void operator=(const IpcConnection&) = delete;
+	void operator=(IpcConnection&&) = delete;
+	~IpcConnection();
+
+	// false once the other side is gone
+	bool read_line(std::string&);
+	bool write_line(const std::string&);
+};
+
+class IpcServer {
+	const std::string name;
+#ifdef _WIN32
+	HANDLE pending = INVALID_HANDLE_VALUE; // created, not connected yet
+#else
+	int fd = -1;
+#endif
+public:
+	// Throws std::runtime_error if another server is listening on the name already
+	IpcServer(const std::string&);
+	IpcServer(const IpcServer&) = delete;
+	void operator=(const IpcServer&) = delete;
+	~IpcServer();
+
+	// blocks until a client connects
+	IpcConnection accept();
+};
+
+// Throws std::runtime_error if there is no server listening
+IpcConnection ipc_connect(const std::string&);
+
+// Default endpoint name for the current user (and logon session, on Windows)
+std::string ipc_default_name();
+
+#ifndef _WIN32
+// Per-user directory for the socket and the state file: $XDG_RUNTIME_DIR, else /tmp/soundctl-<uid>
+std::string user_runtime_dir();
+// For a path in that directory: creates the /tmp one (0700) if missing, throws std::runtime_error unless it is a
+// directory of the user that nobody else can enter. Any other path is left alone.
+void prepare_runtime_path(const std::string&);
+#endif
@@ -0,0 +1,115 @@
+#include "LevelMath.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOUNDCTL_SSE2
+#include <emmintrin.h>
+#endif
+
+// 10^(db/20) = 2^(db * log2(10)/20), 20*log10(x) = log2(x) * 20*log10(2)
+static const float db_to_log2 = 0.166096404744368f;
+static const float log2_to_db = 6.02059991327962f;
+
+// 2^f for f in [-0.5, 0.5], Taylor series of e^(f ln2) up to the 7th power
+static const float exp2_c[] = { 1.0f, 0.693147180f, 0.240226507f, 0.0555041087f, 0.00961812911f, 0.00133335581f, 0.000154035304f, 0.0000152527338f };
+// log2(m) for m in [sqrt(0.5), sqrt(2)), as 2/ln2 * atanh((m-1)/(m+1))
+static const float log2_c[] = { 2.88539008f, 0.961796694f, 0.577078016f, 0.412198583f, 0.320598898f };
+
+static float _exp2(const float x)
+{
+    if (x < -126.0f) return 0.0f;
+    const float c = x > 127.0f ? 127.0f : x;
+    const float n = floorf(c + 0.5f);
+    const float f = c - n;
+
+    float p = exp2_c[7];
+    for (int a = 6; a >= 0; --a) p = p * f + exp2_c[a];
+
+    int32_t bits;
+    memcpy(&bits, &p, sizeof(bits));
+    bits += static_cast<int32_t>(n) << 23;
+    memcpy(&p, &bits, sizeof(p));
+    return p;
+}
+
+static float _log2(const float x)
+{
+    if (!(x >= FLT_MIN)) return -INFINITY;
+
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    // split around sqrt(0.5) so the mantissa stays close to 1
+    const int32_t e = ((bits - 0x3f3504f3) >> 23);
+    bits -= e << 23;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    float p = log2_c[4];
+    for (int a = 3; a >= 0; --a) p = p * t2 + log2_c[a];
+    return static_cast<float>(e) + t * p;
+}
+
+#ifdef SOUNDCTL_SSE2
+static __m128 _exp2_4(__m128 x)
+{
+    const __m128 under = _mm_cmplt_ps(x, _mm_set1_ps(-126.0f));
+    x = _mm_min_ps(x, _mm_set1_ps(127.0f));
+    x = _mm_max_ps(x, _mm_set1_ps(-126.0f));
+
+    const __m128i n = _mm_cvtps_epi32(x); // round to nearest
+    const __m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+
+    __m128 p = _mm_set1_ps(exp2_c[7]);
+    for (int a = 6; a >= 0; --a) p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(exp2_c[a]));
+
+    p = _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), _mm_slli_epi32(n, 23)));
+    return _mm_andnot_ps(under, p);
+}
+
+static __m128 _log2_4(const __m128 x)
+{
+    const __m128 bad = _mm_cmpnge_ps(x, _mm_set1_ps(FLT_MIN)); // also catches NaN
+
+    __m128i bits = _mm_castps_si128(x);
+    const __m128i e = _mm_srai_epi32(_mm_sub_epi32(bits, _mm_set1_epi32(0x3f3504f3)), 23);
+    bits = _mm_sub_epi32(bits, _mm_slli_epi32(e, 23));
+    const __m128 m = _mm_castsi128_ps(bits);
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+    const __m128 t2 = _mm_mul_ps(t, t);
+    __m128 p = _mm_set1_ps(log2_c[4]);
+    for (int a = 3; a >= 0; --a) p = _mm_add_ps(_mm_mul_ps(p, t2), _mm_set1_ps(log2_c[a]));
+
+    const __m128 r = _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(t, p));
+    return _mm_or_ps(_mm_andnot_ps(bad, r), _mm_and_ps(bad, _mm_set1_ps(-INFINITY)));
+}
+#endif
+
+void db_to_scalar(const float* in, float* out, const size_t n)
+{
+    size_t a = 0;
+#ifdef SOUNDCTL_SSE2
+    const __m128 k = _mm_set1_ps(db_to_log2);
+    for (; a + 4 <= n; a += 4)
+        _mm_storeu_ps(out + a, _exp2_4(_mm_mul_ps(_mm_loadu_ps(in + a), k)));
+#endif
+    for (; a < n; ++a) out[a] = _exp2(in[a] * db_to_log2);
+}
+
+void scalar_to_db(const float* in, float* out, const size_t n)
+{
+    size_t a = 0;
+#ifdef SOUNDCTL_SSE2
+    const __m128 k = _mm_set1_ps(log2_to_db);
+    for (; a + 4 <= n; a += 4)
+        _mm_storeu_ps(out + a, _mm_mul_ps(_log2_4(_mm_loadu_ps(in + a)), k));
+#endif
+    for (; a < n; ++a) out[a] = _log2(in[a]) * log2_to_db;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+
+// dB <-> scalar for whole buffers (channel vectors, automation curves).
+// Same results as 20*log10f(x) and powf(10, db/20) within ~1e-6 relative, 4 values per step on SSE2.
+// 0 (and anything under FLT_MIN) maps to -inf dB and back; in and out may be the same buffer.
+void db_to_scalar(const float*, float*, const size_t);
+void scalar_to_db(const float*, float*, const size_t);
@@ -0,0 +1,155 @@
+#include "MachineOutput.h"
+#include "Parallel.h"
+
+#include <stdio.h>
+
+static void _json_string(std::string& out, const std::string& s)
+{
+    out += '"';
+    for (const char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else out += c;
+    }
+    out += '"';
+}
+
+// tabs and line breaks would split the line
+static std::string _line_field(std::string s)
+{
+    for (auto& i : s) if (i == '\t' || i == '\r' || i == '\n') i = ' ';
+    return s;
+}
+
+static void _number(std::string& out, const float f)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.4f", f);
+    out += buf;
+}
+
+OutFormat parse_out_format(const std::string& s)
+{
+    if (s == "json") return OutFormat::JSON;
+    if (s == "line") return OutFormat::LINES;
+    throw std::invalid_argument("Invalid output format: " + s);
+}
+
+std::string get_default_id(const DeviceList& devl, const AudioFlow f)
+{
+    try {
+        return (f == AudioFlow::REC ? devl.get_default_rec(AudioType::CONSOLE) : devl.get_default_play(AudioType::CONSOLE)).get_id();
+    }
+    catch (...) {
+        return {}; // no endpoint of that flow at all
+    }
+}
+
+DeviceState read_state(Device& dev, const AudioFlow f, const bool is_default)
+{
+    DeviceState st;
+    st.flow = f;
+    st.id = dev.get_id();
+    st.name = dev.get_friendly_name();
+    st.is_default = is_default;
+    st.volume = dev.get_volume();
+    st.mute = dev.get_mute();
+    try {
+        st.levels = dev.get_underlying_volume(0).get_levels();
+    }
+    catch (...) {
+        // no volume node in the topology, the endpoint volume is all there is
+    }
+    return st;
+}
+
+std::vector<DeviceState> read_all_states(const DeviceList& devl)
+{
+    std::vector<DeviceState> vec;
+    for (const AudioFlow f : { AudioFlow::PLAY, AudioFlow::REC }) {
+        const std::string def = get_default_id(devl, f);
+        const auto opened = devl.open_all(f);
+
+        // the topology walks are the slow part, overlap them the same way
+        std::vector<DeviceState> states(opened.size());
+        std::vector<char> ok(opened.size(), 0);
+        parallel_for(opened.size(), devl.get_workers(), [&](const size_t p) {
+            if (!opened[p].dev) return;
+            try {
+                states[p] = read_state(*opened[p].dev, f, opened[p].id == def);
+                ok[p] = 1;
+            }
+            catch (...) {
+                // unplugged halfway, left out below
+            }
+        });
+
+        for (size_t p = 0; p < states.size(); ++p) if (ok[p]) vec.push_back(std::move(states[p]));
+    }
+    return vec;
+}
+
+std::string format_states(const OutFormat fmt, const std::vector<DeviceState>& vec)
+{
+    std::string out;
+
+    if (fmt == OutFormat::JSON) {
+        out = "{\"ok\":true,\"devices\":[";
+        for (size_t a = 0; a < vec.size(); ++a) {
+            const auto& i = vec[a];
+            if (a) out += ',';
+            out += "{\"flow\":";
+            out += (i.flow == AudioFlow::REC ? "\"IN\"" : "\"OUT\"");
+            out += ",\"id\":";
+            _json_string(out, i.id);
+            out += ",\"name\":";
+            _json_string(out, i.name);
+            out += ",\"default\":";
+            out += (i.is_default ? "true" : "false");
+            out += ",\"volume\":";
+            _number(out, i.volume);
+            out += ",\"mute\":";
+            out += (i.mute ? "true" : "false");
+            out += ",\"levels\":[";
+            for (size_t c = 0; c < i.levels.size(); ++c) {
+                if (c) out += ',';
+                _number(out, i.levels[c]);
+            }
+            out += "]}";
+        }
+        out += "]}\n";
+        return out;
+    }
+
+    for (const auto& i : vec) {
+        out += (i.flow == AudioFlow::REC ? "IN\t" : "OUT\t");
+        out += (i.is_default ? "1\t" : "0\t");
+        _number(out, i.volume);
+        out += (i.mute ? "\t1\t" : "\t0\t");
+        if (i.levels.empty()) out += '-';
+        for (size_t c = 0; c < i.levels.size(); ++c) {
+            if (c) out += ',';
+            _number(out, i.levels[c]);
+        }
+        out += '\t';
+        out += _line_field(i.id);
+        out += '\t';
+        out += _line_field(i.name);
+        out += '\n';
+    }
+    return out;
+}
+
+std::string format_error(const OutFormat fmt, const std::string& reason)
+{
+    if (fmt == OutFormat::JSON) {
+        std::string out = "{\"ok\":false,\"error\":";
+        _json_string(out, reason);
+        return out + "}\n";
+    }
+    return "ERR " + _line_field(reason) + "\n";
+}
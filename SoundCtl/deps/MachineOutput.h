@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DeviceManager.h"
+
+// Output of the machine mode (-out): no console, no waiting, state as JSON or one tab separated line per device.
+
+enum class OutFormat { NONE, JSON, LINES };
+
+// Process exit codes of the machine mode
+enum class ExitCode { OK = 0, FAILED = 1, USAGE = 2, NO_DEVICE = 3 };
+
+struct DeviceState {
+	AudioFlow flow = AudioFlow::PLAY;
+	std::string id, name;
+	bool is_default = false;
+	float volume = 0.0f;
+	bool mute = false;
+	std::vector<float> levels; // channels of the first topology volume node, empty if there is none
+};
+
+// "json" or "line"
+OutFormat parse_out_format(const std::string&);
+
+// ID of the default console endpoint of that flow (or the first one), empty if there is none
+std::string get_default_id(const DeviceList&, const AudioFlow);
+DeviceState read_state(Device&, const AudioFlow, const bool);
+// Every active endpoint of both flows, default console endpoints flagged
+std::vector<DeviceState> read_all_states(const DeviceList&);
+
+// JSON: {"ok":true,"devices":[...]}. Lines: "<IN|OUT>\t<default>\t<volume>\t<mute>\t<levels, comma separated or ->\t<id>\t<name>"
+std::string format_states(const OutFormat, const std::vector<DeviceState>&);
+// JSON: {"ok":false,"error":"..."}. Lines: "ERR <reason>", same as the resident mode replies.
+std::string format_error(const OutFormat, const std::string&);
@@ -0,0 +1,169 @@
+#include "NameIndex.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <stdlib.h>
+#include <unordered_map>
+
+static const char cache_header[] = "SoundCtl names 1";
+
+static std::string _clean(std::string s)
+{
+    // tabs and line breaks would break the cache format
+    for (auto& i : s) if (i == '\t' || i == '\n' || i == '\r') i = ' ';
+    return s;
+}
+
+std::string fold_name(std::string s)
+{
+    for (auto& i : s) if (i >= 'A' && i <= 'Z') i = static_cast<char>(i - 'A' + 'a');
+    return s;
+}
+
+std::string name_cache_default_path()
+{
+#ifdef _WIN32
+    const char* base = getenv("LOCALAPPDATA");
+    return std::string(base ? base : ".") + "\\SoundCtl.names";
+#else
+    const char* base = getenv("XDG_CACHE_HOME");
+    if (base) return std::string(base) + "/soundctl.names";
+    base = getenv("HOME");
+    return std::string(base ? base : "/tmp") + "/.cache/soundctl.names";
+#endif
+}
+
+void NameIndex::_build(const AudioFlow f)
+{
+    const size_t fl = static_cast<size_t>(f);
+    const auto& ents = entries[fl];
+    auto& pre = prefixes[fl];
+    auto& suf = suffixes[fl];
+
+    pre.clear();
+    suf.clear();
+    for (size_t e = 0; e < ents.size(); ++e) {
+        pre.push_back({ e, 0 });
+        for (size_t o = 0; o < ents[e].folded.size(); ++o) suf.push_back({ e, o });
+    }
+
+    const auto less = [&ents](const Suffix& a, const Suffix& b) {
+        return ents[a.entry].folded.compare(a.off, std::string::npos, ents[b.entry].folded, b.off, std::string::npos) < 0;
+    };
+    std::sort(pre.begin(), pre.end(), less);
+    std::sort(suf.begin(), suf.end(), less);
+}
+
+size_t NameIndex::_find(const std::vector<Suffix>& vec, const AudioFlow f, const std::string& text) const
+{
+    const auto& ents = entries[static_cast<size_t>(f)];
+    const std::string key = fold_name(text);
+
+    // every suffix starting with the key sits in one sorted run
+    auto it = std::lower_bound(vec.begin(), vec.end(), key, [&ents](const Suffix& s, const std::string& k) {
+        return ents[s.entry].folded.compare(s.off, std::string::npos, k) < 0;
+    });
+
+    size_t best = static_cast<size_t>(-1);
+    for (; it != vec.end() && ents[it->entry].folded.compare(it->off, key.size(), key) == 0; ++it)
+        best = std::min(best, it->entry);
+    return best;
+}
+
+bool NameIndex::load(const std::string& path)
+{
+    std::ifstream fp(path);
+    if (!fp) return false;
+
+    std::string line;
+    if (!std::getline(fp, line) || line != cache_header) return false;
+
+    std::vector<Entry> tmp[2];
+    while (std::getline(fp, line)) {
+        const size_t t1 = line.find('\t');
+        const size_t t2 = (t1 == std::string::npos ? t1 : line.find('\t', t1 + 1));
+        if (t2 == std::string::npos || (line[0] != '0' && line[0] != '1')) return false;
+
+        Entry e;
+        e.id = line.substr(t1 + 1, t2 - t1 - 1);
+        e.name = line.substr(t2 + 1);
+        e.folded = fold_name(e.name);
+        tmp[line[0] - '0'].push_back(std::move(e));
+    }
+
+    for (size_t f = 0; f < 2; ++f) {
+        entries[f] = std::move(tmp[f]);
+        _build(static_cast<AudioFlow>(f));
+    }
+    return true;
+}
+
+bool NameIndex::save(const std::string& path) const
+{
+    std::ofstream fp(path, std::ios::trunc);
+    if (!fp) return false;
+
+    fp << cache_header << '\n';
+    for (size_t f = 0; f < 2; ++f)
+        for (const auto& e : entries[f]) fp << f << '\t' << _clean(e.id) << '\t' << _clean(e.name) << '\n';
+    return static_cast<bool>(fp);
+}
+
+// below this, starting threads costs more than the calls they would overlap
+static const size_t parallel_min = 8;
+
+bool NameIndex::refresh(const AudioBackend& backend, const AudioFlow flow, const size_t workers, const bool all_names)
+{
+    std::atomic<bool> changed{ false };
+    const size_t f = static_cast<size_t>(flow);
+    const size_t num = backend.get_count(flow);
+
+    std::unordered_map<std::string, size_t> known;
+    for (size_t e = 0; e < entries[f].size(); ++e) known.emplace(entries[f][e].id, e);
+
+    // an empty entry keeps positions lined up with the collection if an endpoint cannot be opened
+    std::vector<Entry> now(num);
+    parallel_for(num, num >= parallel_min ? workers : 1, [&](const size_t p) {
+        auto ep = backend.get_endpoint(flow, p);
+        if (!ep) return;
+
+        Entry& e = now[p];
+        e.id = ep->get_id();
+
+        const auto it = (all_names ? known.end() : known.find(e.id));
+        if (it != known.end()) {
+            e.name = entries[f][it->second].name;
+            e.folded = entries[f][it->second].folded;
+            if (it->second != p) changed = true;
+        }
+        else {
+            e.name = ep->get_friendly_name();
+            e.folded = fold_name(e.name);
+            const auto old = known.find(e.id);
+            if (old == known.end() || old->second != p || entries[f][old->second].name != e.name) changed = true;
+        }
+    });
+
+    if (now.size() != entries[f].size()) changed = true;
+    entries[f] = std::move(now);
+    _build(flow);
+
+    return changed;
+}
+
+size_t NameIndex::find(const AudioFlow f, const std::string& text) const
+{
+    return _find(suffixes[static_cast<size_t>(f)], f, text);
+}
+
+size_t NameIndex::find_prefix(const AudioFlow f, const std::string& text) const
+{
+    return _find(prefixes[static_cast<size_t>(f)], f, text);
+}
+
+const std::vector<NameIndex::Entry>& NameIndex::get_entries(const AudioFlow f) const
+{
+    return entries[static_cast<size_t>(f)];
+}
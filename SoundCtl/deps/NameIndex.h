@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "AudioBackend.h"
+
+// Endpoint ID -> UTF-8 friendly name, per flow, in collection order.
+// Names are folded once so lookups are case-insensitive (ASCII only, other UTF-8 bytes are kept as they are).
+// Only active endpoints are listed, so a device changing state changes the ID list and invalidates the cache.
+class NameIndex {
+public:
+	struct Entry {
+		std::string id, name, folded;
+	};
+private:
+	struct Suffix {
+		size_t entry, off;
+	};
+
+	std::vector<Entry> entries[2];
+	std::vector<Suffix> prefixes[2]; // off is always 0 here
+	std::vector<Suffix> suffixes[2];
+
+	void _build(const AudioFlow);
+	size_t _find(const std::vector<Suffix>&, const AudioFlow, const std::string&) const;
+public:
+	// false if the file is missing or not a valid cache
+	bool load(const std::string&);
+	bool save(const std::string&) const;
+
+	// Compares the cached IDs of one flow with the backend (no property store is opened for that) and only
+	// reads the names of endpoints not seen before, or of every endpoint with all_names (a device was renamed).
+	// Returns true if anything changed. With many endpoints the reads are spread over that many threads (see parallel_for).
+	bool refresh(const AudioBackend&, const AudioFlow, const size_t = 1, const bool all_names = false);
+
+	// Position in the backend collection of the first endpoint whose name contains (or starts with) the text, or npos
+	size_t find(const AudioFlow, const std::string&) const;
+	size_t find_prefix(const AudioFlow, const std::string&) const;
+
+	const std::vector<Entry>& get_entries(const AudioFlow) const;
+};
+
+std::string fold_name(std::string);
+std::string name_cache_default_path();
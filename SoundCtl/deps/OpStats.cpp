@@ -0,0 +1,162 @@
+#include "OpStats.h"
+
+#include <fstream>
+#include <memory>
+#include <stdio.h>
+#include <unordered_map>
+
+static std::mutex registry_mtx;
+static std::unordered_map<std::string, std::unique_ptr<DeviceOpStats>> registry;
+
+static const char* const op_names[] = {
+    "get_id", "get_name", "get_volume", "set_volume", "get_mute", "set_mute", "get_peaks", "get_sessions", "watch_sessions", "watch_volume",
+    "get_topology", "open_node", "get_level", "set_level", "get_switch", "set_switch",
+    "count", "open", "find", "default"
+};
+static_assert(sizeof(op_names) / sizeof(op_names[0]) == static_cast<size_t>(DeviceOp::_SIZE), "one name per operation");
+
+static size_t _bucket(uint64_t us)
+{
+    size_t b = 0;
+    while (us && b < op_buckets - 1) {
+        us >>= 1;
+        ++b;
+    }
+    return b;
+}
+
+// upper bound of the bucket, in us
+static uint64_t _bucket_top(const size_t b)
+{
+    return static_cast<uint64_t>(1) << b;
+}
+
+// smallest bucket top that covers that fraction of the calls
+static uint64_t _percentile(const OpReport::Op& o, const double frac)
+{
+    const uint64_t want = static_cast<uint64_t>(o.calls * frac + 0.5);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < op_buckets; ++b) {
+        seen += o.buckets[b];
+        if (seen >= want && seen) return _bucket_top(b);
+    }
+    return _bucket_top(op_buckets - 1);
+}
+
+const char* op_name(const DeviceOp op)
+{
+    return op_names[static_cast<size_t>(op)];
+}
+
+void DeviceOpStats::record(const DeviceOp op, const std::chrono::steady_clock::duration d)
+{
+    Counters& c = ops[static_cast<size_t>(op)];
+    const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    c.buckets[_bucket(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t prev = c.max_ns.load(std::memory_order_relaxed);
+    while (prev < ns && !c.max_ns.compare_exchange_weak(prev, ns, std::memory_order_relaxed));
+}
+
+void DeviceOpStats::record_failure(const DeviceOp op, const long code)
+{
+    ops[static_cast<size_t>(op)].failures.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> l(codes_mtx);
+    ++codes[{ op, code }];
+}
+
+OpReport OpReport::read(const std::string& id, const DeviceOpStats& st)
+{
+    OpReport rep;
+    rep.id = id;
+
+    for (size_t a = 0; a < static_cast<size_t>(DeviceOp::_SIZE); ++a) {
+        const auto& c = st.ops[a];
+        Op o;
+        o.op = static_cast<DeviceOp>(a);
+        o.calls = c.calls.load(std::memory_order_relaxed);
+        if (!o.calls) continue;
+        o.failures = c.failures.load(std::memory_order_relaxed);
+        o.total_us = c.total_ns.load(std::memory_order_relaxed) / 1000.0;
+        o.max_us = c.max_ns.load(std::memory_order_relaxed) / 1000.0;
+        for (size_t b = 0; b < op_buckets; ++b) o.buckets[b] = c.buckets[b].load(std::memory_order_relaxed);
+        rep.ops.push_back(std::move(o));
+    }
+
+    std::lock_guard<std::mutex> l(st.codes_mtx);
+    for (const auto& i : st.codes) {
+        for (auto& o : rep.ops) if (o.op == i.first.first) o.codes[i.first.second] = i.second;
+    }
+    return rep;
+}
+
+DeviceOpStats* opstats_for(const std::string& id)
+{
+    std::lock_guard<std::mutex> l(registry_mtx);
+    auto& p = registry[id];
+    if (!p) p = std::make_unique<DeviceOpStats>();
+    return p.get();
+}
+
+std::vector<OpReport> opstats_get()
+{
+    std::map<std::string, const DeviceOpStats*> all;
+    {
+        std::lock_guard<std::mutex> l(registry_mtx);
+        for (const auto& i : registry) all.emplace(i.first, i.second.get());
+    }
+
+    std::vector<OpReport> vec;
+    for (const auto& i : all) vec.push_back(OpReport::read(i.first, *i.second));
+    return vec;
+}
+
+std::string format_opstats(const std::vector<OpReport>& reps)
+{
+#ifndef SOUNDCTL_OPSTATS
+    if (reps.empty()) return "Operation statistics are compiled out (SOUNDCTL_NO_OPSTATS)\n";
+#endif
+    std::string out;
+    char buf[160];
+
+    for (const auto& r : reps) {
+        if (r.ops.empty()) continue;
+        out += "# " + (r.id.empty() ? std::string("(device list)") : r.id) + "\n";
+
+        for (const auto& o : r.ops) {
+            snprintf(buf, sizeof(buf), "%-14s %8llu calls %6llu failed %10.1f avg %10.1f max  p50<%llu p99<%llu (us)\n",
+                op_name(o.op), static_cast<unsigned long long>(o.calls), static_cast<unsigned long long>(o.failures),
+                o.total_us / o.calls, o.max_us,
+                static_cast<unsigned long long>(_percentile(o, 0.5)), static_cast<unsigned long long>(_percentile(o, 0.99)));
+            out += buf;
+
+            // "<top us>:<calls>" for each bucket with something in it
+            out += "  hist";
+            for (size_t b = 0; b < op_buckets; ++b) {
+                if (!o.buckets[b]) continue;
+                snprintf(buf, sizeof(buf), " %s%llu:%llu", b == op_buckets - 1 ? ">" : "<",
+                    static_cast<unsigned long long>(_bucket_top(b == op_buckets - 1 ? b - 1 : b)), static_cast<unsigned long long>(o.buckets[b]));
+                out += buf;
+            }
+            out += "\n";
+
+            for (const auto& c : o.codes) {
+                snprintf(buf, sizeof(buf), "  error 0x%08lx x%llu\n", static_cast<unsigned long>(c.first) & 0xFFFFFFFFul, static_cast<unsigned long long>(c.second));
+                out += buf;
+            }
+        }
+    }
+    return out;
+}
+
+bool dump_opstats(const std::string& path)
+{
+    std::ofstream fp(path, std::ios::trunc);
+    if (!fp) return false;
+    fp << format_opstats(opstats_get());
+    return static_cast<bool>(fp);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AudioBackend.h"
+
+// Call counts, failures by error code and latency histograms for every operation of Device, VolumeDevice,
+// SwitchDevice and DeviceList, kept per endpoint ID (DeviceList lookups are not tied to one endpoint, they go under "").
+// Recording is a few relaxed atomic adds, failures take a lock. Build with SOUNDCTL_NO_OPSTATS to compile it out:
+// DEVICE_OP then expands to the bare call.
+
+#ifndef SOUNDCTL_NO_OPSTATS
+#define SOUNDCTL_OPSTATS
+#endif
+
+enum class DeviceOp {
+	GET_ID, GET_NAME, GET_VOLUME, SET_VOLUME, GET_MUTE, SET_MUTE, GET_PEAKS, GET_SESSIONS, WATCH_SESSIONS, WATCH_VOLUME,
+	GET_TOPOLOGY, OPEN_NODE, GET_LEVEL, SET_LEVEL, GET_SWITCH, SET_SWITCH,
+	COUNT, OPEN, FIND, DEFAULT,
+	_SIZE
+};
+
+const char* op_name(const DeviceOp);
+
+// bucket 0 is under 1 us, bucket n (n > 0) is [2^(n-1) .. 2^n) us, the last one is everything above
+const size_t op_buckets = 24;
+
+class DeviceOpStats {
+	struct Counters {
+		std::atomic<uint64_t> calls{ 0 }, failures{ 0 }, total_ns{ 0 }, max_ns{ 0 };
+		std::atomic<uint64_t> buckets[op_buckets]{};
+	};
+
+	Counters ops[static_cast<size_t>(DeviceOp::_SIZE)];
+	std::map<std::pair<DeviceOp, long>, uint64_t> codes; // failures by operation and error code
+	mutable std::mutex codes_mtx;
+	friend struct OpReport;
+public:
+	void record(const DeviceOp, const std::chrono::steady_clock::duration);
+	void record_failure(const DeviceOp, const long);
+};
+
+struct OpReport {
+	struct Op {
+		DeviceOp op;
+		uint64_t calls = 0, failures = 0;
+		double total_us = 0, max_us = 0;
+		uint64_t buckets[op_buckets] = {};
+		std::map<long, uint64_t> codes;
+	};
+	std::string id;
+	std::vector<Op> ops; // only the operations called at least once
+
+	static OpReport read(const std::string&, const DeviceOpStats&);
+};
+
+// The counters of that endpoint, created on first use. They live as long as the process, so the pointer can be kept.
+DeviceOpStats* opstats_for(const std::string&);
+// every endpoint seen so far, by ID
+std::vector<OpReport> opstats_get();
+
+// One "# <id>" block per endpoint, one line per operation with its histogram and failures
+std::string format_opstats(const std::vector<OpReport>&);
+bool dump_opstats(const std::string&);
+
+// Times one operation. Records when it goes out of scope, so it works for calls with or without a result.
+class OpRecord {
+	DeviceOpStats* const stats;
+	const DeviceOp op;
+	const std::chrono::steady_clock::time_point start;
+public:
+	OpRecord(DeviceOpStats* s, const DeviceOp o) : stats(s), op(o), start(std::chrono::steady_clock::now()) {}
+	OpRecord(const OpRecord&) = delete;
+	void operator=(const OpRecord&) = delete;
+	~OpRecord() { if (stats) stats->record(op, std::chrono::steady_clock::now() - start); }
+
+	void fail(const long code) { if (stats) stats->record_failure(op, code); }
+};
+
+template<typename F>
+auto op_timed(DeviceOpStats* stats, const DeviceOp op, F&& f) -> decltype(f())
+{
+	OpRecord r(stats, op);
+	try {
+		return f();
+	}
+	catch (const BackendError& e) {
+		r.fail(e.get_code());
+		throw;
+	}
+	catch (...) {
+		r.fail(0); // not a backend call that failed (bad argument, no such node...)
+		throw;
+	}
+}
+
+#ifdef SOUNDCTL_OPSTATS
+#define DEVICE_OP(stats, op, ...) op_timed((stats), (op), [&]() { return __VA_ARGS__; })
+#else
+#define DEVICE_OP(stats, op, ...) (__VA_ARGS__)
+#endif
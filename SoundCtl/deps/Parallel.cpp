@@ -0,0 +1,48 @@
+#include "Parallel.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <objbase.h>
+#endif
+
+void parallel_for(const size_t n, const size_t workers, const std::function<void(size_t)>& f)
+{
+    std::atomic<size_t> next{ 0 };
+    std::exception_ptr first;
+    std::mutex mtx;
+
+    const auto run = [&] {
+        for (size_t i = next++; i < n; i = next++) {
+            try {
+                f(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> l(mtx);
+                if (!first) first = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> thrs;
+    for (size_t t = 1; t < workers && t < n; ++t) {
+        thrs.emplace_back([&run] {
+#ifdef _WIN32
+            const bool com = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+            run();
+            if (com) CoUninitialize();
+#else
+            run();
+#endif
+        });
+    }
+    run();
+    for (auto& i : thrs) i.join();
+
+    if (first) std::rethrow_exception(first);
+}
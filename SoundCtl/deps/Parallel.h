@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+
+// Runs f(0) .. f(n - 1) on up to that many threads, the calling one included, and returns once all are done.
+// On Windows the extra threads join the process MTA first, so COM objects created on the caller work there as-is.
+// The first exception thrown by f is rethrown here; the other indices still run.
+void parallel_for(const size_t, const size_t, const std::function<void(size_t)>&);
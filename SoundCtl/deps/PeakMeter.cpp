@@ -0,0 +1,113 @@
+#include "PeakMeter.h"
+
+#include <algorithm>
+
+PeakMeter::PeakMeter(const std::chrono::microseconds p, const size_t cap)
+    : period(p), ring(cap)
+{
+    if (period.count() <= 0) throw std::invalid_argument("Invalid meter period");
+}
+
+PeakMeter::~PeakMeter()
+{
+    stop();
+}
+
+size_t PeakMeter::add(std::shared_ptr<Device> dev)
+{
+    if (!dev) throw std::invalid_argument("NULL DEVICE");
+    if (running) throw std::runtime_error("Meter already running");
+
+    auto src = std::make_unique<Source>();
+    src->peaks.resize(dev->get_meter_channel_count());
+    src->dev = std::move(dev);
+    sources.push_back(std::move(src));
+    return sources.size() - 1;
+}
+
+void PeakMeter::start()
+{
+    if (running.exchange(true)) return;
+    worker = std::thread(&PeakMeter::_work, this);
+}
+
+void PeakMeter::stop()
+{
+    running = false;
+    if (worker.joinable()) worker.join();
+}
+
+bool PeakMeter::pop(PeakSample& s)
+{
+    return ring.pop(s);
+}
+
+PeakMeter::Stats PeakMeter::get_stats() const
+{
+    Stats st;
+    st.ticks = ticks.load(std::memory_order_relaxed);
+    st.dropped = dropped.load(std::memory_order_relaxed);
+    if (st.ticks) {
+        st.jitter_avg_us = late_ns.load(std::memory_order_relaxed) / 1e3 / st.ticks;
+        st.busy_ratio = busy_ns.load(std::memory_order_relaxed) / 1e3 / (static_cast<double>(st.ticks) * period.count());
+    }
+
+    for (const auto& i : sources) {
+        SourceStats s;
+        s.polls = i->polls.load(std::memory_order_relaxed);
+        s.errors = i->errors.load(std::memory_order_relaxed);
+        if (s.polls) s.poll_avg_us = i->poll_ns.load(std::memory_order_relaxed) / 1e3 / s.polls;
+        s.poll_max_us = i->poll_max_ns.load(std::memory_order_relaxed) / 1e3;
+        st.sources.push_back(s);
+    }
+    return st;
+}
+
+void PeakMeter::_work()
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    auto next = start;
+
+    while (running.load(std::memory_order_relaxed)) {
+        next += period;
+        timer.wait_until(next);
+
+        const auto now = clock::now();
+        if (now > next) late_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(now - next).count(), std::memory_order_relaxed);
+        const uint64_t stamp = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+
+        auto t0 = now;
+        for (size_t a = 0; a < sources.size(); ++a) {
+            Source& src = *sources[a];
+            PeakSample s;
+            s.time_us = stamp;
+            s.source = static_cast<uint32_t>(a);
+            s.channels = static_cast<uint32_t>(std::min(src.peaks.size(), PeakSample::max_channels));
+
+            try {
+                src.dev->get_peaks(src.peaks.data(), src.peaks.size());
+                std::copy_n(src.peaks.begin(), s.channels, s.peak);
+            }
+            catch (...) {
+                src.errors.fetch_add(1, std::memory_order_relaxed);
+                s.channels = 0; // still queued so consumers see the gap
+            }
+
+            const auto t1 = clock::now();
+            const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            src.polls.fetch_add(1, std::memory_order_relaxed);
+            src.poll_ns.fetch_add(ns, std::memory_order_relaxed);
+            if (ns > src.poll_max_ns.load(std::memory_order_relaxed)) src.poll_max_ns.store(ns, std::memory_order_relaxed);
+            t0 = t1;
+
+            if (!ring.push(s)) dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ticks.fetch_add(1, std::memory_order_relaxed);
+        busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - now).count(), std::memory_order_relaxed);
+
+        // fell behind by more than a tick: skip the missed ones
+        while (next + period < now) next += period;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeviceManager.h"
+#include "PrecisionTimer.h"
+#include "SpscRing.h"
+
+struct PeakSample {
+	static const size_t max_channels = 8;
+
+	uint64_t time_us;  // since the meter started
+	uint32_t source;   // index returned by PeakMeter::add
+	uint32_t channels;
+	float peak[max_channels];
+};
+
+// Polls the peak meters of a set of endpoints on one thread at a fixed rate (up to ~1 kHz) and queues a sample
+// per endpoint per tick. Consumers drain the queue at their own pace; if they fall behind, new samples are
+// dropped and counted, the sampler never waits for them.
+class PeakMeter {
+public:
+	struct SourceStats {
+		uint64_t polls = 0;
+		uint64_t errors = 0;
+		double poll_avg_us = 0;  // time spent reading that endpoint, per tick
+		double poll_max_us = 0;
+	};
+	struct Stats {
+		uint64_t ticks = 0;
+		uint64_t dropped = 0;     // samples lost to a full queue
+		double jitter_avg_us = 0;
+		double busy_ratio = 0;    // time spent polling / time running
+		std::vector<SourceStats> sources;
+	};
+private:
+	struct Source {
+		std::shared_ptr<Device> dev;
+		std::vector<float> peaks; // every channel, the sample keeps the first max_channels
+		// written by the sampler only, read by get_stats at any time
+		std::atomic<uint64_t> polls{ 0 }, errors{ 0 }, poll_ns{ 0 }, poll_max_ns{ 0 };
+	};
+
+	const std::chrono::microseconds period;
+	std::vector<std::unique_ptr<Source>> sources;
+	SpscRing<PeakSample> ring;
+	std::atomic<uint64_t> ticks{ 0 }, dropped{ 0 }, late_ns{ 0 }, busy_ns{ 0 };
+	std::atomic<bool> running{ false };
+	PrecisionTimer timer;
+	std::thread worker;
+
+	void _work();
+public:
+	PeakMeter(const std::chrono::microseconds, const size_t = 4096);
+	PeakMeter(const PeakMeter&) = delete;
+	void operator=(const PeakMeter&) = delete;
+	~PeakMeter();
+
+	// Only before start(). Returns the source index used in the samples.
+	size_t add(std::shared_ptr<Device>);
+	void start();
+	void stop();
+
+	// consumer side, one thread
+	bool pop(PeakSample&);
+	Stats get_stats() const;
+};
@@ -0,0 +1,41 @@
+#include "PrecisionTimer.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+PrecisionTimer::PrecisionTimer()
+{
+#ifdef _WIN32
+    // high resolution timers exist since Windows 10 1803, plain ones are still better than Sleep
+    timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!timer) timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+#endif
+}
+
+PrecisionTimer::~PrecisionTimer()
+{
+#ifdef _WIN32
+    if (timer) CloseHandle(timer);
+#endif
+}
+
+void PrecisionTimer::wait_until(const std::chrono::steady_clock::time_point when)
+{
+#ifdef _WIN32
+    if (timer) {
+        const auto left = std::chrono::duration_cast<std::chrono::microseconds>(when - std::chrono::steady_clock::now());
+        if (left.count() <= 0) return;
+
+        LARGE_INTEGER due;
+        due.QuadPart = -static_cast<LONGLONG>(left.count()) * 10; // relative, in 100 ns units
+        if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+            WaitForSingleObject(timer, INFINITE);
+            return;
+        }
+    }
+#endif
+    std::this_thread::sleep_until(when);
+}
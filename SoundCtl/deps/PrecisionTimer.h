@@ -0,0 +1,18 @@
+#pragma once
+
+#include <chrono>
+
+// Sleeps until a steady_clock deadline. On Windows a high resolution waitable timer gets this well under the
+// 1-15 ms granularity of Sleep; elsewhere sleep_until is already that precise.
+class PrecisionTimer {
+#ifdef _WIN32
+	void* timer = nullptr;
+#endif
+public:
+	PrecisionTimer();
+	PrecisionTimer(const PrecisionTimer&) = delete;
+	void operator=(const PrecisionTimer&) = delete;
+	~PrecisionTimer();
+
+	void wait_until(const std::chrono::steady_clock::time_point);
+};
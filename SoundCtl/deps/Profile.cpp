@@ -0,0 +1,168 @@
+#include "Profile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+#include <math.h>
+
+static const char profile_magic[4] = { 'S', 'C', 'P', 'F' };
+static const uint32_t profile_version = 1;
+
+// the backends store levels in dB, a round trip through them moves a scalar by far less than this
+static const float same_level = 1e-4f;
+
+template<typename T>
+static void _put(std::ofstream& fp, const T& v)
+{
+    fp.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template<typename T>
+static bool _get(std::ifstream& fp, T& v)
+{
+    return static_cast<bool>(fp.read(reinterpret_cast<char*>(&v), sizeof(T)));
+}
+
+static bool _differs(const float a, const float b)
+{
+    return fabsf(a - b) > same_level;
+}
+
+// Every active endpoint, each opened once, in collection order
+template<typename F>
+static void _each_device(const DeviceList& devl, F&& f)
+{
+    for (const AudioFlow fl : { AudioFlow::PLAY, AudioFlow::REC }) {
+        const bool rec = (fl == AudioFlow::REC);
+        const size_t num = rec ? devl.get_num_rec() : devl.get_num_play();
+        for (size_t p = 0; p < num; ++p) {
+            Device dev = rec ? devl.get_rec(p) : devl.get_play(p);
+            f(dev);
+        }
+    }
+}
+
+static size_t _volume_nodes(Device& dev)
+{
+    try {
+        return dev.get_topology()->get_count(NodeKind::VOLUME);
+    }
+    catch (...) {
+        return 0; // no topology to walk, the endpoint volume is all there is
+    }
+}
+
+void Profile::capture(const DeviceList& devl)
+{
+    std::vector<Endpoint> now;
+    _each_device(devl, [&now](Device& dev) {
+        Endpoint e;
+        e.id = dev.get_id();
+        e.volume = dev.get_volume();
+        e.mute = dev.get_mute();
+        const size_t nodes = _volume_nodes(dev);
+        for (size_t n = 0; n < nodes; ++n) e.levels.push_back(dev.get_underlying_volume(n).get_levels());
+        now.push_back(std::move(e));
+    });
+    endpoints = std::move(now);
+}
+
+bool Profile::load(const std::string& path)
+{
+    std::ifstream fp(path, std::ios::binary);
+    if (!fp) return false;
+
+    char magic[4];
+    uint32_t ver = 0, count = 0;
+    if (!fp.read(magic, 4) || !std::equal(magic, magic + 4, profile_magic)) return false;
+    if (!_get(fp, ver) || ver != profile_version || !_get(fp, count)) return false;
+
+    std::vector<Endpoint> tmp;
+    for (uint32_t a = 0; a < count; ++a) {
+        Endpoint e;
+        uint32_t len = 0, nodes = 0;
+        uint8_t mute = 0;
+        if (!_get(fp, len) || len > 4096) return false;
+        e.id.resize(len);
+        if (!fp.read(&e.id[0], len) || !_get(fp, e.volume) || !_get(fp, mute) || !_get(fp, nodes) || nodes > 256) return false;
+        e.mute = (mute != 0);
+
+        for (uint32_t n = 0; n < nodes; ++n) {
+            uint32_t ch = 0;
+            if (!_get(fp, ch) || ch > 256) return false;
+            std::vector<float> lv(ch);
+            if (ch && !fp.read(reinterpret_cast<char*>(lv.data()), ch * sizeof(float))) return false;
+            e.levels.push_back(std::move(lv));
+        }
+        tmp.push_back(std::move(e));
+    }
+
+    endpoints = std::move(tmp);
+    return true;
+}
+
+bool Profile::save(const std::string& path) const
+{
+    std::ofstream fp(path, std::ios::binary | std::ios::trunc);
+    if (!fp) return false;
+
+    fp.write(profile_magic, 4);
+    _put(fp, profile_version);
+    _put(fp, static_cast<uint32_t>(endpoints.size()));
+    for (const auto& e : endpoints) {
+        _put(fp, static_cast<uint32_t>(e.id.size()));
+        fp.write(e.id.data(), e.id.size());
+        _put(fp, e.volume);
+        _put(fp, static_cast<uint8_t>(e.mute ? 1 : 0));
+        _put(fp, static_cast<uint32_t>(e.levels.size()));
+        for (const auto& lv : e.levels) {
+            _put(fp, static_cast<uint32_t>(lv.size()));
+            fp.write(reinterpret_cast<const char*>(lv.data()), lv.size() * sizeof(float));
+        }
+    }
+    return static_cast<bool>(fp);
+}
+
+Profile::ApplyStats Profile::apply(const DeviceList& devl) const
+{
+    ApplyStats st;
+    std::unordered_map<std::string, const Endpoint*> by_id;
+    for (const auto& e : endpoints) by_id.emplace(e.id, &e);
+
+    _each_device(devl, [&](Device& dev) {
+        const auto it = by_id.find(dev.get_id());
+        if (it == by_id.end()) return;
+        const Endpoint& e = *it->second;
+        ++st.endpoints;
+
+        if (dev.get_mute() != e.mute) { dev.set_mute(e.mute); ++st.writes; }
+        else ++st.skipped;
+        if (_differs(dev.get_volume(), e.volume)) { dev.set_volume(e.volume); ++st.writes; }
+        else ++st.skipped;
+
+        if (e.levels.empty()) return;
+        const size_t nodes = std::min(e.levels.size(), _volume_nodes(dev));
+        for (size_t n = 0; n < nodes; ++n) {
+            VolumeDevice vd = dev.get_underlying_volume(n);
+            const auto live = vd.get_levels();
+            if (live.size() != e.levels[n].size()) continue; // not the same hardware anymore
+
+            // only the channels that moved, all of them in one call
+            uint32_t mask = 0;
+            for (size_t c = 0; c < live.size(); ++c) {
+                if (!_differs(live[c], e.levels[n][c])) continue;
+                mask |= (c < 32 ? (1u << c) : VolumeDevice::all_channels);
+            }
+            if (mask) { vd.set_levels(e.levels[n], mask); ++st.writes; }
+            else ++st.skipped;
+        }
+    });
+
+    st.missing = endpoints.size() - st.endpoints;
+    return st;
+}
+
+const std::vector<Profile::Endpoint>& Profile::get_endpoints() const
+{
+    return endpoints;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "DeviceManager.h"
+
+// Mixer state of every active endpoint, keyed by endpoint ID: master volume, mute and the channel levels
+// (scalars) of each volume node in its topology. Saved as a small binary file in native byte order.
+class Profile {
+public:
+	struct Endpoint {
+		std::string id;
+		float volume = 0.0f;
+		bool mute = false;
+		std::vector<std::vector<float>> levels; // by topology volume node, one value per channel
+	};
+	struct ApplyStats {
+		size_t endpoints = 0; // in the profile and present now
+		size_t missing = 0;   // in the profile but not active now, skipped
+		size_t writes = 0;    // volume, mute or level writes issued
+		size_t skipped = 0;   // values already where the profile wants them
+	};
+private:
+	std::vector<Endpoint> endpoints;
+public:
+	// one pass over every active endpoint
+	void capture(const DeviceList&);
+
+	// false if the file is missing or not a valid profile
+	bool load(const std::string&);
+	bool save(const std::string&) const;
+
+	// One enumeration pass: reads the live state of each endpoint in the profile and writes only what differs
+	ApplyStats apply(const DeviceList&) const;
+
+	const std::vector<Endpoint>& get_endpoints() const;
+};
@@ -0,0 +1,743 @@
+#include "PulseAudioBackend.h"
+
+#ifdef SOUNDCTL_PULSE
+
+#include <algorithm>
+#include <math.h>
+
+#include "Trace.h"
+
+static const std::string sink_prefix = "{sink}";
+static const std::string source_prefix = "{source}";
+
+// Scoped pa_threaded_mainloop_lock, never taken from the mainloop thread itself (callbacks already hold it)
+class PulseLock {
+    pa_threaded_mainloop* const loop;
+public:
+    PulseLock(pa_threaded_mainloop* m) : loop(m) { pa_threaded_mainloop_lock(loop); }
+    PulseLock(const PulseLock&) = delete;
+    void operator=(const PulseLock&) = delete;
+    ~PulseLock() { pa_threaded_mainloop_unlock(loop); }
+};
+
+// scalar (1.0 = PA_VOLUME_NORM, what pactl shows as 100%) <-> server volume
+static pa_volume_t _to_pa(const float f)
+{
+    if (!(f > 0.0f)) return PA_VOLUME_MUTED;
+    const double v = static_cast<double>(f) * PA_VOLUME_NORM + 0.5;
+    return v >= static_cast<double>(PA_VOLUME_MAX) ? PA_VOLUME_MAX : static_cast<pa_volume_t>(v);
+}
+
+static float _from_pa(const pa_volume_t v)
+{
+    return static_cast<float>(v) / PA_VOLUME_NORM;
+}
+
+// the server maps volumes to gain on a cubic curve, its own conversion is the one pactl shows
+static float _db(const pa_volume_t v)
+{
+    return v == PA_VOLUME_MUTED ? -INFINITY : static_cast<float>(pa_sw_volume_to_dB(v));
+}
+
+static bool _is_monitor(const pa_sink_info&)
+{
+    return false;
+}
+
+// monitors loop a sink back, Core Audio does not list them as capture endpoints either
+static bool _is_monitor(const pa_source_info& i)
+{
+    return i.monitor_of_sink != PA_INVALID_INDEX;
+}
+
+template<typename T>
+static PulseInfo _to_info(const T& i)
+{
+    PulseInfo p;
+    p.index = i.index;
+    p.name = i.name ? i.name : "";
+    p.description = i.description ? i.description : p.name;
+    p.volume = i.volume;
+    p.mute = (i.mute != 0);
+    return p;
+}
+
+struct InfoRequest {
+    pa_threaded_mainloop* loop;
+    std::vector<PulseInfo> out;
+};
+
+template<typename T>
+static void _on_info(pa_context*, const T* i, int eol, void* data)
+{
+    auto* r = static_cast<InfoRequest*>(data);
+    if (eol) { // < 0 is an error (no such sink...), the request just ends empty
+        pa_threaded_mainloop_signal(r->loop, 0);
+        return;
+    }
+    if (i && !_is_monitor(*i)) r->out.push_back(_to_info(*i));
+}
+
+struct SuccessRequest {
+    pa_threaded_mainloop* loop;
+    int ok = 0;
+};
+
+static void _on_success(pa_context*, int ok, void* data)
+{
+    auto* r = static_cast<SuccessRequest*>(data);
+    r->ok = ok;
+    pa_threaded_mainloop_signal(r->loop, 0);
+}
+
+struct ServerRequest {
+    pa_threaded_mainloop* loop;
+    std::string defaults[2]; // by AudioFlow
+};
+
+static void _on_server(pa_context*, const pa_server_info* i, void* data)
+{
+    auto* r = static_cast<ServerRequest*>(data);
+    if (i) {
+        r->defaults[static_cast<size_t>(AudioFlow::PLAY)] = i->default_sink_name ? i->default_sink_name : "";
+        r->defaults[static_cast<size_t>(AudioFlow::REC)] = i->default_source_name ? i->default_source_name : "";
+    }
+    pa_threaded_mainloop_signal(r->loop, 0);
+}
+
+std::string pulse_id(const AudioFlow f, const std::string& name)
+{
+    return (f == AudioFlow::REC ? source_prefix : sink_prefix) + name;
+}
+
+bool pulse_parse_id(const std::string& id, AudioFlow& f, std::string& name)
+{
+    if (id.compare(0, sink_prefix.size(), sink_prefix) == 0) {
+        f = AudioFlow::PLAY;
+        name = id.substr(sink_prefix.size());
+        return true;
+    }
+    if (id.compare(0, source_prefix.size(), source_prefix) == 0) {
+        f = AudioFlow::REC;
+        name = id.substr(source_prefix.size());
+        return true;
+    }
+    return false;
+}
+
+
+PulseConnection::PulseConnection()
+{
+    TraceScope t("enumerator");
+
+    loop = pa_threaded_mainloop_new();
+    if (!loop) throw std::runtime_error("pa_threaded_mainloop_new FAILED!");
+    if (pa_threaded_mainloop_start(loop) < 0) {
+        _close();
+        throw std::runtime_error("pa_threaded_mainloop_start FAILED!");
+    }
+
+    std::exception_ptr failed;
+    {
+        PulseLock l(loop);
+        try {
+            _connect();
+        }
+        catch (...) {
+            failed = std::current_exception();
+        }
+    }
+    if (failed) {
+        _close();
+        std::rethrow_exception(failed);
+    }
+}
+
+PulseConnection::~PulseConnection()
+{
+    _close();
+}
+
+void PulseConnection::_close()
+{
+    // the mainloop thread goes first, then nothing can call back into us
+    if (loop) pa_threaded_mainloop_stop(loop);
+    if (ctx) {
+        pa_context_disconnect(ctx);
+        pa_context_unref(ctx);
+        ctx = nullptr;
+    }
+    if (loop) {
+        pa_threaded_mainloop_free(loop);
+        loop = nullptr;
+    }
+}
+
+void PulseConnection::_on_state(pa_context*, void* data)
+{
+    pa_threaded_mainloop_signal(static_cast<PulseConnection*>(data)->loop, 0);
+}
+
+void PulseConnection::_connect()
+{
+    if (ctx) {
+        pa_context_set_state_callback(ctx, nullptr, nullptr);
+        pa_context_set_subscribe_callback(ctx, nullptr, nullptr);
+        pa_context_disconnect(ctx);
+        pa_context_unref(ctx);
+        ctx = nullptr;
+    }
+
+    ctx = pa_context_new(pa_threaded_mainloop_get_api(loop), "SoundCtl");
+    if (!ctx) throw std::runtime_error("pa_context_new FAILED!");
+    pa_context_set_state_callback(ctx, _on_state, this);
+
+    // PULSE_SERVER picks another server, like for every other client
+    if (pa_context_connect(ctx, nullptr, PA_CONTEXT_NOAUTOSPAWN, nullptr) < 0) _fail("Cannot connect to the sound server");
+    while (true) {
+        const pa_context_state_t st = pa_context_get_state(ctx);
+        if (st == PA_CONTEXT_READY) break;
+        if (!PA_CONTEXT_IS_GOOD(st)) _fail("Cannot connect to the sound server");
+        pa_threaded_mainloop_wait(loop);
+    }
+
+    // indexes are only valid per server run
+    for (size_t f = 0; f < 2; ++f) {
+        listed[f] = false;
+        known[f].clear();
+    }
+    if (subscribed) _subscribe();
+}
+
+void PulseConnection::_ensure()
+{
+    if (pa_context_get_state(ctx) != PA_CONTEXT_READY) _connect();
+}
+
+void PulseConnection::_fail(const char* what) const
+{
+    const int err = pa_context_errno(ctx);
+    throw BackendError(std::string(what) + ": " + pa_strerror(err), err);
+}
+
+void PulseConnection::_wait(pa_operation* op) const
+{
+    if (!op) _fail("Request refused");
+    while (pa_operation_get_state(op) == PA_OPERATION_RUNNING) pa_threaded_mainloop_wait(loop);
+    pa_operation_unref(op);
+}
+
+void PulseConnection::_learn(const AudioFlow f, const PulseInfo& i)
+{
+    known[static_cast<size_t>(f)][i.index] = i;
+}
+
+std::vector<PulseInfo> PulseConnection::_list(const AudioFlow f)
+{
+    InfoRequest r{ loop, {} };
+    _wait(f == AudioFlow::REC ?
+        pa_context_get_source_info_list(ctx, _on_info<pa_source_info>, &r) :
+        pa_context_get_sink_info_list(ctx, _on_info<pa_sink_info>, &r));
+    for (const auto& i : r.out) _learn(f, i);
+    return std::move(r.out);
+}
+
+size_t PulseConnection::get_count(const AudioFlow f)
+{
+    PulseLock l(loop);
+    _ensure();
+    const size_t fl = static_cast<size_t>(f);
+    if (!listed[fl]) {
+        TraceScope t("enumerate");
+        lists[fl] = _list(f);
+        listed[fl] = true;
+    }
+    return lists[fl].size();
+}
+
+bool PulseConnection::get_at(const AudioFlow f, const size_t p, PulseInfo& out)
+{
+    PulseLock l(loop);
+    _ensure();
+    const size_t fl = static_cast<size_t>(f);
+    if (!listed[fl]) {
+        TraceScope t("enumerate");
+        lists[fl] = _list(f);
+        listed[fl] = true;
+    }
+    if (p >= lists[fl].size()) return false;
+    out = lists[fl][p];
+    return true;
+}
+
+bool PulseConnection::get_info(const AudioFlow f, const std::string& name, PulseInfo& out)
+{
+    PulseLock l(loop);
+    _ensure();
+    InfoRequest r{ loop, {} };
+    _wait(f == AudioFlow::REC ?
+        pa_context_get_source_info_by_name(ctx, name.c_str(), _on_info<pa_source_info>, &r) :
+        pa_context_get_sink_info_by_name(ctx, name.c_str(), _on_info<pa_sink_info>, &r));
+    if (r.out.empty()) return false;
+    out = std::move(r.out.front());
+    return true;
+}
+
+std::string PulseConnection::get_default(const AudioFlow f)
+{
+    PulseLock l(loop);
+    _ensure();
+    ServerRequest r{ loop, {} };
+    _wait(pa_context_get_server_info(ctx, _on_server, &r));
+    // the cached defaults are left alone: they tell the subscription what changed
+    return r.defaults[static_cast<size_t>(f)];
+}
+
+void PulseConnection::_set_volume(const AudioFlow f, const std::string& name, const pa_cvolume& cv)
+{
+    SuccessRequest r{ loop };
+    _wait(f == AudioFlow::REC ?
+        pa_context_set_source_volume_by_name(ctx, name.c_str(), &cv, _on_success, &r) :
+        pa_context_set_sink_volume_by_name(ctx, name.c_str(), &cv, _on_success, &r));
+    if (!r.ok) _fail("Failed to set volume");
+}
+
+void PulseConnection::set_master(const AudioFlow f, const std::string& name, const float value)
+{
+    PulseInfo i;
+    if (!get_info(f, name, i)) throw BackendError("Device is gone: " + name, PA_ERR_NOENTITY);
+
+    PulseLock l(loop);
+    pa_cvolume_scale(&i.volume, _to_pa(value));
+    _set_volume(f, name, i.volume);
+}
+
+void PulseConnection::set_channels(const AudioFlow f, const std::string& name, const pa_volume_t* in, const size_t n, const uint32_t mask)
+{
+    PulseInfo i;
+    if (!get_info(f, name, i)) throw BackendError("Device is gone: " + name, PA_ERR_NOENTITY);
+
+    PulseLock l(loop);
+    for (size_t c = 0; c < n && c < i.volume.channels; ++c)
+        if (channel_in_mask(mask, c)) i.volume.values[c] = in[c];
+    _set_volume(f, name, i.volume);
+}
+
+void PulseConnection::set_mute(const AudioFlow f, const std::string& name, const bool b)
+{
+    PulseLock l(loop);
+    _ensure();
+    SuccessRequest r{ loop };
+    _wait(f == AudioFlow::REC ?
+        pa_context_set_source_mute_by_name(ctx, name.c_str(), b ? 1 : 0, _on_success, &r) :
+        pa_context_set_sink_mute_by_name(ctx, name.c_str(), b ? 1 : 0, _on_success, &r));
+    if (!r.ok) _fail("Failed to set mute");
+}
+
+void PulseConnection::subscribe(BackendListener* l)
+{
+    PulseLock lk(loop);
+    sink = l;
+    if (!l || subscribed) return;
+
+    _ensure();
+    _subscribe();
+    subscribed = true;
+}
+
+void PulseConnection::watch_volume(const std::string& id, VolumeListener* old, VolumeListener* now)
+{
+    PulseLock lk(loop);
+    if (old) {
+        const auto range = volume_sinks.equal_range(id);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second != old) continue;
+            volume_sinks.erase(it);
+            break;
+        }
+    }
+    if (!now) return;
+
+    volume_sinks.emplace(id, now);
+    if (subscribed) return;
+    _ensure();
+    _subscribe();
+    subscribed = true;
+}
+
+void PulseConnection::_subscribe()
+{
+    pa_context_set_subscribe_callback(ctx, _on_event, this);
+    SuccessRequest r{ loop };
+    _wait(pa_context_subscribe(ctx,
+        static_cast<pa_subscription_mask_t>(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SERVER),
+        _on_success, &r));
+    if (!r.ok) _fail("Failed to subscribe");
+
+    // what the events are compared with
+    ServerRequest s{ loop, {} };
+    _wait(pa_context_get_server_info(ctx, _on_server, &s));
+    for (size_t f = 0; f < 2; ++f) {
+        defaults[f] = s.defaults[f];
+        _list(static_cast<AudioFlow>(f));
+    }
+}
+
+// From here on, the mainloop thread with the lock held: nothing may wait for a reply, requests are sent and left
+void PulseConnection::_on_event(pa_context* c, pa_subscription_event_type_t t, uint32_t index, void* data)
+{
+    auto* self = static_cast<PulseConnection*>(data);
+    const unsigned facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    const unsigned type = t & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+    pa_operation* op = nullptr;
+
+    if (facility == PA_SUBSCRIPTION_EVENT_SERVER) {
+        op = pa_context_get_server_info(c, _on_server_event, self);
+    }
+    else if (facility == PA_SUBSCRIPTION_EVENT_SINK || facility == PA_SUBSCRIPTION_EVENT_SOURCE) {
+        const AudioFlow f = (facility == PA_SUBSCRIPTION_EVENT_SOURCE ? AudioFlow::REC : AudioFlow::PLAY);
+        const size_t fl = static_cast<size_t>(f);
+
+        if (type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+            const auto it = self->known[fl].find(index);
+            if (it == self->known[fl].end()) return; // a monitor, or never seen
+            const std::string id = pulse_id(f, it->second.name);
+            self->known[fl].erase(it);
+            self->listed[fl] = false;
+            if (self->sink) self->sink->on_device_changed(id);
+            return;
+        }
+        // new, or changed: only a rename matters, the reply tells
+        op = (f == AudioFlow::REC ?
+            pa_context_get_source_info_by_index(c, index, _on_source_event, self) :
+            pa_context_get_sink_info_by_index(c, index, _on_sink_event, self));
+    }
+    if (op) pa_operation_unref(op);
+}
+
+void PulseConnection::_on_sink_event(pa_context*, const pa_sink_info* i, int eol, void* data)
+{
+    if (eol || !i) return;
+    static_cast<PulseConnection*>(data)->_changed(AudioFlow::PLAY, _to_info(*i));
+}
+
+void PulseConnection::_on_source_event(pa_context*, const pa_source_info* i, int eol, void* data)
+{
+    if (eol || !i || _is_monitor(*i)) return;
+    static_cast<PulseConnection*>(data)->_changed(AudioFlow::REC, _to_info(*i));
+}
+
+void PulseConnection::_on_server_event(pa_context*, const pa_server_info* i, void* data)
+{
+    if (!i) return;
+    auto* self = static_cast<PulseConnection*>(data);
+    const char* now[2] = { i->default_sink_name, i->default_source_name }; // by AudioFlow
+
+    for (size_t f = 0; f < 2; ++f) {
+        const std::string name = now[f] ? now[f] : "";
+        if (name == self->defaults[f]) continue;
+        self->defaults[f] = name;
+        if (!self->sink) continue;
+
+        const AudioFlow fl = static_cast<AudioFlow>(f);
+        for (const AudioType t : { AudioType::CONSOLE, AudioType::MULTIMEDIA, AudioType::COMMUNICATIONS })
+            self->sink->on_default_changed(fl, t, name.empty() ? std::string() : pulse_id(fl, name));
+    }
+}
+
+void PulseConnection::_changed(const AudioFlow f, const PulseInfo& i)
+{
+    auto& map = known[static_cast<size_t>(f)];
+    const auto it = map.find(i.index);
+    std::string old;
+    if (it != map.end()) {
+        const bool moved = !pa_cvolume_equal(&it->second.volume, &i.volume) || it->second.mute != i.mute;
+        // a volume or mute change: nothing an ID or a name depends on
+        if (it->second.name == i.name && it->second.description == i.description) {
+            it->second = i;
+            if (moved) _volume_changed(f, i);
+            return;
+        }
+        if (it->second.name != i.name) old = pulse_id(f, it->second.name);
+    }
+
+    map[i.index] = i;
+    listed[static_cast<size_t>(f)] = false;
+    if (!sink) return;
+    if (!old.empty()) sink->on_device_changed(old);
+    sink->on_device_changed(pulse_id(f, i.name));
+}
+
+
+void PulseConnection::_volume_changed(const AudioFlow f, const PulseInfo& i)
+{
+    const std::string id = pulse_id(f, i.name);
+    const auto range = volume_sinks.equal_range(id);
+    if (range.first == range.second) return;
+
+    // same scale as PulseEndpoint::get_volume
+    const float v = std::min(1.0f, _from_pa(pa_cvolume_max(&i.volume)));
+    for (auto it = range.first; it != range.second; ++it) it->second->on_volume_changed(id, v, i.mute);
+}
+
+
+PulseLevel::PulseLevel(std::shared_ptr<PulseConnection> c, const AudioFlow f, const PulseInfo& i)
+    : conn(std::move(c)), flow(f), server_name(i.name), name(i.description), channels(i.volume.channels)
+{
+    if (!conn) throw std::invalid_argument("NULL CONNECTION");
+}
+
+const std::string& PulseLevel::get_name() const
+{
+    return name;
+}
+
+size_t PulseLevel::get_channel_count() const
+{
+    return channels;
+}
+
+float PulseLevel::get_level_db(const size_t ch) const
+{
+    PulseInfo i;
+    if (!conn->get_info(flow, server_name, i)) throw BackendError("Device is gone: " + server_name, PA_ERR_NOENTITY);
+    if (ch >= i.volume.channels) throw std::invalid_argument("Invalid channel");
+    return _db(i.volume.values[ch]);
+}
+
+void PulseLevel::set_level_db(const size_t ch, const float db)
+{
+    if (ch >= channels) throw std::invalid_argument("Invalid channel");
+    std::vector<pa_volume_t> v(channels, PA_VOLUME_MUTED);
+    v[ch] = pa_sw_volume_from_dB(db);
+    conn->set_channels(flow, server_name, v.data(), v.size(), 1u << ch); // PA_CHANNELS_MAX is 32
+}
+
+void PulseLevel::get_levels_db(float* out, const size_t n) const
+{
+    PulseInfo i;
+    if (!conn->get_info(flow, server_name, i)) throw BackendError("Device is gone: " + server_name, PA_ERR_NOENTITY);
+    for (size_t a = 0; a < n; ++a) out[a] = (a < i.volume.channels ? _db(i.volume.values[a]) : -INFINITY);
+}
+
+void PulseLevel::set_levels_db(const float* in, const size_t n, const uint32_t mask)
+{
+    std::vector<pa_volume_t> v(n);
+    for (size_t a = 0; a < n; ++a) v[a] = pa_sw_volume_from_dB(in[a]);
+    conn->set_channels(flow, server_name, v.data(), v.size(), mask);
+}
+
+PulseSwitch::PulseSwitch(std::shared_ptr<PulseConnection> c, const AudioFlow f, const PulseInfo& i)
+    : conn(std::move(c)), flow(f), server_name(i.name), name(i.description)
+{
+    if (!conn) throw std::invalid_argument("NULL CONNECTION");
+}
+
+const std::string& PulseSwitch::get_name() const
+{
+    return name;
+}
+
+bool PulseSwitch::get() const
+{
+    PulseInfo i;
+    if (!conn->get_info(flow, server_name, i)) throw BackendError("Device is gone: " + server_name, PA_ERR_NOENTITY);
+    return i.mute;
+}
+
+void PulseSwitch::set(const bool b)
+{
+    conn->set_mute(flow, server_name, b);
+}
+
+PulseTopology::PulseTopology(const std::string& name)
+{
+    const size_t part = _add_part(Part{ name, true, 0 });
+    _add_node(NodeKind::VOLUME, part);
+    _add_node(NodeKind::MUTE, part);
+}
+
+
+PulseEndpoint::PulseEndpoint(std::shared_ptr<PulseConnection> c, const AudioFlow f, std::string name, std::shared_ptr<TopologyCache> cache)
+    : conn(std::move(c)), flow(f), server_name(std::move(name)), topologies(std::move(cache))
+{
+    if (!conn) throw std::invalid_argument("NULL CONNECTION");
+}
+
+PulseEndpoint::~PulseEndpoint()
+{
+    if (volumes) conn->watch_volume(get_id(), volumes, nullptr);
+}
+
+PulseInfo PulseEndpoint::_info() const
+{
+    PulseInfo i;
+    if (!conn->get_info(flow, server_name, i)) throw BackendError("Device is gone: " + server_name, PA_ERR_NOENTITY);
+    return i;
+}
+
+std::string PulseEndpoint::get_id() const
+{
+    return pulse_id(flow, server_name);
+}
+
+std::string PulseEndpoint::get_friendly_name() const
+{
+    return _info().description;
+}
+
+AudioFlow PulseEndpoint::get_flow() const
+{
+    return flow;
+}
+
+bool PulseEndpoint::is_active() const
+{
+    PulseInfo i;
+    return conn->get_info(flow, server_name, i);
+}
+
+void PulseEndpoint::set_volume(const float f)
+{
+    conn->set_master(flow, server_name, f);
+}
+
+float PulseEndpoint::get_volume() const
+{
+    const PulseInfo i = _info();
+    // past 100% (software amplification) reads as full scale, like Core Audio has no such thing
+    return std::min(1.0f, _from_pa(pa_cvolume_max(&i.volume)));
+}
+
+void PulseEndpoint::set_mute(const bool b)
+{
+    conn->set_mute(flow, server_name, b);
+}
+
+bool PulseEndpoint::get_mute() const
+{
+    return _info().mute;
+}
+
+size_t PulseEndpoint::get_meter_channel_count() const
+{
+    throw std::runtime_error("No peak meter on this backend");
+}
+
+void PulseEndpoint::get_peaks(float*, const size_t) const
+{
+    throw std::runtime_error("No peak meter on this backend");
+}
+
+std::vector<std::shared_ptr<BackendSession>> PulseEndpoint::get_sessions()
+{
+    return {}; // sink inputs are not mapped to sessions (yet)
+}
+
+void PulseEndpoint::set_session_listener(SessionListener*)
+{
+}
+
+void PulseEndpoint::set_volume_listener(VolumeListener* l)
+{
+    conn->watch_volume(get_id(), volumes, l);
+    volumes = l;
+}
+
+std::shared_ptr<const TopologyGraph> PulseEndpoint::get_topology()
+{
+    const std::string id = get_id();
+    auto graph = topologies->get(id);
+    if (!graph) {
+        graph = std::make_shared<PulseTopology>(_info().description);
+        topologies->put(id, graph);
+    }
+    return graph;
+}
+
+std::unique_ptr<BackendLevel> PulseEndpoint::get_underlying_volume(const size_t undr)
+{
+    if (get_topology()->find(NodeKind::VOLUME, undr) == static_cast<size_t>(-1)) throw std::runtime_error("Invalid number or no audio interface here.");
+    return std::make_unique<PulseLevel>(conn, flow, _info());
+}
+
+std::unique_ptr<BackendSwitch> PulseEndpoint::get_underlying_switch(const NodeKind kind, const size_t undr)
+{
+    if (kind == NodeKind::VOLUME) throw std::invalid_argument("Volume nodes are not switches");
+    if (get_topology()->find(kind, undr) == static_cast<size_t>(-1)) throw std::runtime_error("Invalid number or no audio interface here.");
+    return std::make_unique<PulseSwitch>(conn, flow, _info());
+}
+
+
+PulseAudioBackend::PulseAudioBackend()
+{
+    topologies->set_hook([this] { _watch(); });
+}
+
+PulseAudioBackend::~PulseAudioBackend()
+{
+    topologies->set_hook(nullptr);
+    if (watching) conn->subscribe(nullptr);
+}
+
+void PulseAudioBackend::on_device_changed(const std::string& id)
+{
+    topologies->drop(id);
+
+    std::lock_guard<std::mutex> l(listener_mtx);
+    if (listener) listener->on_device_changed(id);
+}
+
+void PulseAudioBackend::on_default_changed(const AudioFlow f, const AudioType t, const std::string& id)
+{
+    std::lock_guard<std::mutex> l(listener_mtx);
+    if (listener) listener->on_default_changed(f, t, id);
+}
+
+void PulseAudioBackend::_watch()
+{
+    std::lock_guard<std::mutex> l(notify_mtx);
+    if (watching) return;
+
+    conn->subscribe(this);
+    watching = true;
+}
+
+size_t PulseAudioBackend::get_count(const AudioFlow f) const
+{
+    return conn->get_count(f);
+}
+
+std::unique_ptr<BackendEndpoint> PulseAudioBackend::get_endpoint(const AudioFlow f, const size_t p) const
+{
+    PulseInfo i;
+    if (!conn->get_at(f, p, i)) return nullptr;
+    return std::make_unique<PulseEndpoint>(conn, f, i.name, topologies);
+}
+
+std::unique_ptr<BackendEndpoint> PulseAudioBackend::get_endpoint(const std::string& id) const
+{
+    AudioFlow f;
+    std::string name;
+    PulseInfo i;
+    if (!pulse_parse_id(id, f, name) || !conn->get_info(f, name, i)) return nullptr;
+    return std::make_unique<PulseEndpoint>(conn, f, std::move(name), topologies);
+}
+
+std::unique_ptr<BackendEndpoint> PulseAudioBackend::get_default(const AudioFlow f, const AudioType) const
+{
+    std::string name = conn->get_default(f);
+    if (name.empty()) return nullptr;
+    return std::make_unique<PulseEndpoint>(conn, f, std::move(name), topologies);
+}
+
+void PulseAudioBackend::set_listener(BackendListener* l)
+{
+    {
+        std::lock_guard<std::mutex> lk(listener_mtx);
+        listener = l;
+    }
+    if (l) _watch();
+}
+
+#endif
@@ -0,0 +1,193 @@
+#pragma once
+
+// Built when the libpulse headers are there (CMakeLists.txt links libpulse then, tests/pulse_smoke.sh runs it). PipeWire serves the same client API through pipewire-pulse.
+#if defined(__linux__) && __has_include(<pulse/pulseaudio.h>)
+#define SOUNDCTL_PULSE
+
+#include <pulse/pulseaudio.h>
+#include <stdexcept>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "AudioBackend.h"
+
+// What the server says about one sink (PLAY) or source (REC)
+struct PulseInfo {
+	uint32_t index = PA_INVALID_INDEX;
+	std::string name, description;
+	pa_cvolume volume{};
+	bool mute = false;
+};
+
+// The one connection to the sound server, on its own threaded mainloop. Every call locks the mainloop, sends one
+// request and waits for the reply, so callers see blocking calls like on Core Audio. Shared by the backend and every
+// endpoint it hands out, they may outlive each other.
+// Endpoint IDs are "{sink}<name>" or "{source}<name>": the server names are stable across restarts, the indexes are not.
+class PulseConnection {
+	pa_threaded_mainloop* loop = nullptr;
+	pa_context* ctx = nullptr;
+
+	// collection order, read once per flow until something changes (like the lazy collections of WinAudioBackend)
+	std::vector<PulseInfo> lists[2];
+	bool listed[2] = { false, false };
+	// what the subscription needs to turn an index into an ID, and to tell a rename from a volume change
+	std::unordered_map<uint32_t, PulseInfo> known[2];
+	std::string defaults[2];
+	BackendListener* sink = nullptr;
+	std::unordered_multimap<std::string, VolumeListener*> volume_sinks; // by endpoint ID
+	bool subscribed = false;
+
+	static void _on_state(pa_context*, void*);
+	static void _on_event(pa_context*, pa_subscription_event_type_t, uint32_t, void*);
+	static void _on_sink_event(pa_context*, const pa_sink_info*, int, void*);
+	static void _on_source_event(pa_context*, const pa_source_info*, int, void*);
+	static void _on_server_event(pa_context*, const pa_server_info*, void*);
+
+	void _connect();
+	void _close();
+	// the server may have restarted since the last call: connect again, once
+	void _ensure();
+	void _subscribe();
+	void _fail(const char*) const;
+	void _wait(pa_operation*) const;
+	void _learn(const AudioFlow, const PulseInfo&);
+	void _changed(const AudioFlow, const PulseInfo&);
+	void _volume_changed(const AudioFlow, const PulseInfo&);
+	std::vector<PulseInfo> _list(const AudioFlow);
+	void _set_volume(const AudioFlow, const std::string&, const pa_cvolume&);
+public:
+	// Throws if there is no server to talk to
+	PulseConnection();
+	PulseConnection(const PulseConnection&) = delete;
+	void operator=(const PulseConnection&) = delete;
+	~PulseConnection();
+
+	size_t get_count(const AudioFlow);
+	// false if the position is past the end
+	bool get_at(const AudioFlow, const size_t, PulseInfo&);
+	// false if there is no such sink or source
+	bool get_info(const AudioFlow, const std::string&, PulseInfo&);
+	// server name of the default sink or source, empty if none
+	std::string get_default(const AudioFlow);
+
+	// Keeps the channel balance: the loudest channel ends at the value, the others follow
+	void set_master(const AudioFlow, const std::string&, const float);
+	// Only channels with their bit set in the mask, values as the server takes them
+	void set_channels(const AudioFlow, const std::string&, const pa_volume_t*, const size_t, const uint32_t);
+	void set_mute(const AudioFlow, const std::string&, const bool);
+
+	// Sink, source and default changes go to that listener from the mainloop thread, nullptr to stop
+	void subscribe(BackendListener*);
+	// Replaces one volume listener of that endpoint ID by another, either may be nullptr. Same thread as above.
+	void watch_volume(const std::string&, VolumeListener*, VolumeListener*);
+};
+
+// The channel volumes of a sink or source, as the only volume node of its topology
+class PulseLevel : public BackendLevel {
+	std::shared_ptr<PulseConnection> conn;
+	const AudioFlow flow;
+	const std::string server_name;
+	std::string name;
+	size_t channels;
+public:
+	PulseLevel(std::shared_ptr<PulseConnection>, const AudioFlow, const PulseInfo&);
+
+	const std::string& get_name() const override;
+	size_t get_channel_count() const override;
+	float get_level_db(const size_t) const override;
+	void set_level_db(const size_t, const float) override;
+	void get_levels_db(float*, const size_t) const override;
+	void set_levels_db(const float*, const size_t, const uint32_t) override;
+};
+
+// The mute of a sink or source, as the only mute node of its topology
+class PulseSwitch : public BackendSwitch {
+	std::shared_ptr<PulseConnection> conn;
+	const AudioFlow flow;
+	const std::string server_name;
+	std::string name;
+public:
+	PulseSwitch(std::shared_ptr<PulseConnection>, const AudioFlow, const PulseInfo&);
+
+	const std::string& get_name() const override;
+	bool get() const override;
+	void set(const bool) override;
+};
+
+// The server has no device topology: one part (the sink or source) with one volume node and one mute node
+class PulseTopology : public TopologyGraph {
+public:
+	PulseTopology(const std::string&);
+};
+
+// Volume, mute and channel levels. No peak meter (the server only gives peaks to a recording stream) and no sessions.
+class PulseEndpoint : public BackendEndpoint {
+	std::shared_ptr<PulseConnection> conn;
+	const AudioFlow flow;
+	const std::string server_name;
+	const std::shared_ptr<TopologyCache> topologies;
+	VolumeListener* volumes = nullptr;
+
+	PulseInfo _info() const;
+public:
+	PulseEndpoint(std::shared_ptr<PulseConnection>, const AudioFlow, std::string, std::shared_ptr<TopologyCache>);
+	PulseEndpoint(const PulseEndpoint&) = delete;
+	void operator=(const PulseEndpoint&) = delete;
+	~PulseEndpoint();
+
+	std::string get_id() const override;
+	std::string get_friendly_name() const override;
+	AudioFlow get_flow() const override;
+	bool is_active() const override;
+	void set_volume(const float) override;
+	float get_volume() const override;
+	void set_mute(const bool) override;
+	bool get_mute() const override;
+	size_t get_meter_channel_count() const override;
+	void get_peaks(float*, const size_t) const override;
+
+	std::vector<std::shared_ptr<BackendSession>> get_sessions() override;
+	void set_session_listener(SessionListener*) override;
+	void set_volume_listener(VolumeListener*) override;
+
+	std::shared_ptr<const TopologyGraph> get_topology() override;
+	std::unique_ptr<BackendLevel> get_underlying_volume(const size_t) override;
+	std::unique_ptr<BackendSwitch> get_underlying_switch(const NodeKind, const size_t) override;
+};
+
+// Same notification plumbing as WinAudioBackend: subscribed once a listener or a cached topology needs it.
+// Every AudioType maps to the one default sink or source the server has.
+class PulseAudioBackend : public AudioBackend, private BackendListener {
+	const std::shared_ptr<PulseConnection> conn = std::make_shared<PulseConnection>();
+	BackendListener* listener = nullptr;
+	const std::shared_ptr<TopologyCache> topologies = std::make_shared<TopologyCache>();
+	bool watching = false;
+	std::mutex notify_mtx, listener_mtx;
+
+	void on_device_changed(const std::string&) override;
+	void on_default_changed(const AudioFlow, const AudioType, const std::string&) override;
+
+	void _watch();
+public:
+	PulseAudioBackend();
+	PulseAudioBackend(const PulseAudioBackend&) = delete;
+	void operator=(const PulseAudioBackend&) = delete;
+	~PulseAudioBackend();
+
+	size_t get_count(const AudioFlow) const override;
+	std::unique_ptr<BackendEndpoint> get_endpoint(const AudioFlow, const size_t) const override;
+	std::unique_ptr<BackendEndpoint> get_endpoint(const std::string&) const override;
+	std::unique_ptr<BackendEndpoint> get_default(const AudioFlow, const AudioType) const override;
+
+	void set_listener(BackendListener*) override;
+};
+
+// "{sink}<name>" or "{source}<name>"
+std::string pulse_id(const AudioFlow, const std::string&);
+// false if it is not one of ours
+bool pulse_parse_id(const std::string&, AudioFlow&, std::string&);
+
+#endif
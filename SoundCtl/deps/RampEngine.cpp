@@ -0,0 +1,170 @@
+#include "RampEngine.h"
+
+#include <algorithm>
+#include <math.h>
+
+float ramp_value(const float from, const float to, const float t, const RampCurve curve)
+{
+    if (t >= 1.0f) return to;
+    if (t <= 0.0f) return from;
+
+    switch (curve) {
+    case RampCurve::S_CURVE:
+    {
+        const float s = t * t * (3.0f - 2.0f * t);
+        return from + (to - from) * s;
+    }
+    case RampCurve::DB_LINEAR:
+    {
+        // straight line in dB, with -60 dB standing in for silence
+        const float floor_db = -60.0f;
+        const float a = from > 0.001f ? 20.0f * log10f(from) : floor_db;
+        const float b = to > 0.001f ? 20.0f * log10f(to) : floor_db;
+        const float db = a + (b - a) * t;
+        return db <= floor_db ? 0.0f : powf(10.0f, db / 20.0f);
+    }
+    default:
+        return from + (to - from) * t;
+    }
+}
+
+RampEngine::RampEngine(const std::chrono::microseconds p)
+    : period(p)
+{
+    if (period.count() <= 0) throw std::invalid_argument("Invalid ramp period");
+    worker = std::thread(&RampEngine::_work, this);
+}
+
+RampEngine::~RampEngine()
+{
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        stop = true;
+    }
+    cond.notify_all();
+    worker.join();
+}
+
+void RampEngine::add(std::shared_ptr<Device> dev, const float target, const std::chrono::milliseconds len, const RampCurve curve)
+{
+    if (!dev) throw std::invalid_argument("NULL DEVICE");
+    if (target < 0.0f || target > 1.0f) throw std::invalid_argument("Invalid volume");
+
+    const float now = dev->get_volume();
+    _add(Ramp{ std::move(dev), nullptr, 0, now, target, now, curve, std::chrono::steady_clock::now(), len });
+}
+
+void RampEngine::add(std::shared_ptr<VolumeDevice> lvl, const size_t ch, const float target, const std::chrono::milliseconds len, const RampCurve curve)
+{
+    if (!lvl) throw std::invalid_argument("NULL LEVEL");
+    if (target < 0.0f || target > 1.0f) throw std::invalid_argument("Invalid volume");
+
+    const float now = lvl->get_level(ch);
+    _add(Ramp{ nullptr, std::move(lvl), ch, now, target, now, curve, std::chrono::steady_clock::now(), len });
+}
+
+void RampEngine::_add(Ramp&& r)
+{
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        r.serial = ++next_serial;
+        const auto it = std::find_if(ramps.begin(), ramps.end(), [&r](const Ramp& o) {
+            return o.dev == r.dev && o.lvl == r.lvl && o.channel == r.channel;
+        });
+        if (it != ramps.end()) {
+            r.from = r.last = it->last;
+            *it = std::move(r);
+        }
+        else ramps.push_back(std::move(r));
+        stats.active = ramps.size();
+    }
+    cond.notify_all();
+}
+
+void RampEngine::wait_idle() const
+{
+    std::unique_lock<std::mutex> l(mtx);
+    idle.wait(l, [this] { return ramps.empty(); });
+}
+
+RampEngine::Stats RampEngine::get_stats() const
+{
+    std::lock_guard<std::mutex> l(mtx);
+    Stats s = stats;
+    if (s.ticks) {
+        s.jitter_avg_us = jitter_sum_us / s.ticks;
+        s.busy_ratio = busy_us / (static_cast<double>(s.ticks) * period.count());
+    }
+    return s;
+}
+
+void RampEngine::_work()
+{
+    using clock = std::chrono::steady_clock;
+
+    std::unique_lock<std::mutex> l(mtx);
+    clock::time_point next = clock::now();
+
+    while (true) {
+        if (ramps.empty()) {
+            idle.notify_all();
+            cond.wait(l, [this] { return stop || !ramps.empty(); });
+            next = clock::now();
+        }
+        if (stop) return;
+
+        next += period;
+        l.unlock();
+        timer.wait_until(next);
+        l.lock();
+        if (stop) return;
+
+        const auto now = clock::now();
+        const double late = std::chrono::duration<double, std::micro>(now - next).count();
+        ++stats.ticks;
+        jitter_sum_us += std::max(0.0, late);
+        stats.jitter_max_us = std::max(stats.jitter_max_us, late);
+
+        for (auto it = ramps.begin(); it != ramps.end();) {
+            const float t = it->length.count() <= 0 ? 1.0f :
+                std::min(1.0f, std::chrono::duration<float>(now - it->start) / std::chrono::duration<float>(it->length));
+            const float v = ramp_value(it->from, it->to, t, it->curve);
+            const bool done = (t >= 1.0f);
+
+            if (v != it->last) steps.push_back(Step{ it->serial, it->dev, it->lvl, it->channel, v, done, false });
+            else if (done) {
+                it = ramps.erase(it);
+                continue;
+            }
+            ++it;
+        }
+
+        // a slow endpoint holds up the other ramps of this tick, but not add(), wait_idle() or the stats
+        l.unlock();
+        for (auto& s : steps) {
+            try {
+                if (s.dev) s.dev->set_volume(s.value);
+                else s.lvl->set_level(s.value, s.channel);
+                s.ok = true;
+            }
+            catch (...) {
+            }
+        }
+        l.lock();
+
+        for (const auto& s : steps) {
+            if (s.ok) ++stats.writes;
+            const auto it = std::find_if(ramps.begin(), ramps.end(), [&s](const Ramp& r) { return r.serial == s.serial; });
+            if (it == ramps.end()) continue; // replaced meanwhile, the new one starts from the last value it saw
+            if (s.ok) it->last = s.value;
+            if (!s.ok || s.done) ramps.erase(it); // failed: device gone, nothing left to fade
+        }
+        steps.clear(); // the devices are not kept alive until the next tick
+
+        stats.active = ramps.size();
+        busy_us += std::chrono::duration<double, std::micro>(clock::now() - now).count();
+
+        // fell behind by more than a tick: drop the missed ones instead of bursting to catch up
+        while (next + period < now) next += period;
+    }
+}
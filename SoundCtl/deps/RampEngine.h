@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "DeviceManager.h"
+#include "PrecisionTimer.h"
+
+enum class RampCurve { LINEAR, DB_LINEAR, S_CURVE };
+
+// Runs any number of volume fades on one thread, stepping all of them on the same fixed-period tick.
+// Values are scalars in [0.0..1.0] for both endpoints and VolumeDevice channels.
+class RampEngine {
+public:
+	struct Stats {
+		uint64_t ticks = 0;        // timer ticks while something was ramping
+		uint64_t writes = 0;       // volume writes issued (unchanged values are skipped)
+		double jitter_avg_us = 0;  // how late the ticks fired
+		double jitter_max_us = 0;
+		double busy_ratio = 0;     // time spent stepping / time ramping
+		size_t active = 0;
+	};
+private:
+	struct Ramp {
+		std::shared_ptr<Device> dev;
+		std::shared_ptr<VolumeDevice> lvl;
+		size_t channel;
+		float from, to, last;
+		RampCurve curve;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::duration length;
+		uint64_t serial = 0; // tells a ramp replaced while its write was out
+	};
+	// one write of a tick, issued without the lock
+	struct Step {
+		uint64_t serial;
+		std::shared_ptr<Device> dev;
+		std::shared_ptr<VolumeDevice> lvl;
+		size_t channel;
+		float value;
+		bool done, ok;
+	};
+
+	const std::chrono::microseconds period;
+	std::vector<Ramp> ramps;
+	std::vector<Step> steps; // worker only
+	uint64_t next_serial = 0;
+	Stats stats;
+	double jitter_sum_us = 0, busy_us = 0;
+	mutable std::mutex mtx;
+	std::condition_variable cond;
+	mutable std::condition_variable idle;
+	bool stop = false;
+	PrecisionTimer timer;
+	std::thread worker;
+
+	void _add(Ramp&&);
+	void _work();
+public:
+	RampEngine(const std::chrono::microseconds = std::chrono::milliseconds(5));
+	RampEngine(const RampEngine&) = delete;
+	void operator=(const RampEngine&) = delete;
+	~RampEngine();
+
+	// A new ramp on the same endpoint (or the same channel) replaces the running one, starting where it is now
+	void add(std::shared_ptr<Device>, const float, const std::chrono::milliseconds, const RampCurve = RampCurve::LINEAR);
+	void add(std::shared_ptr<VolumeDevice>, const size_t, const float, const std::chrono::milliseconds, const RampCurve = RampCurve::LINEAR);
+
+	// blocks until every ramp is done
+	void wait_idle() const;
+	Stats get_stats() const;
+};
+
+float ramp_value(const float, const float, const float, const RampCurve);
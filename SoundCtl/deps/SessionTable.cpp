@@ -0,0 +1,137 @@
+#include "SessionTable.h"
+
+static std::string _process_key(const std::string& name)
+{
+    std::string key = fold_name(name);
+    if (key.size() > 4 && key.compare(key.size() - 4, 4, ".exe") == 0) key.resize(key.size() - 4);
+    return key;
+}
+
+template<typename K>
+static void _erase_pair(std::unordered_multimap<K, std::string>& map, const K& key, const std::string& id)
+{
+    const auto range = map.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second != id) continue;
+        map.erase(it);
+        return;
+    }
+}
+
+SessionTable::SessionTable(std::shared_ptr<Device> d, const bool l)
+    : dev(std::move(d)), live(l)
+{
+    if (!dev) throw std::invalid_argument("NULL DEVICE");
+
+    // subscribe before enumerating so nothing that happens in between is lost (adding a session twice is harmless)
+    if (live) dev->set_session_listener(this);
+
+    try {
+        auto vec = dev->get_sessions();
+
+        std::lock_guard<std::mutex> lk(mtx);
+        for (auto& i : vec) if (!gone.count(i->get_instance_id())) _insert(std::move(i));
+        gone.clear();
+        loading = false;
+    }
+    catch (...) {
+        if (live) dev->set_session_listener(nullptr);
+        throw;
+    }
+}
+
+SessionTable::~SessionTable()
+{
+    if (live) dev->set_session_listener(nullptr);
+}
+
+void SessionTable::on_session_added(std::shared_ptr<BackendSession> s)
+{
+    std::lock_guard<std::mutex> l(mtx);
+    _insert(std::move(s));
+}
+
+void SessionTable::on_session_expired(const std::string& id)
+{
+    std::lock_guard<std::mutex> l(mtx);
+    if (loading) gone.insert(id);
+    _erase(id);
+}
+
+void SessionTable::_insert(std::shared_ptr<BackendSession> s)
+{
+    const std::string& id = s->get_instance_id();
+    if (by_instance.count(id)) return;
+
+    by_session.emplace(s->get_session_id(), id);
+    by_pid.emplace(s->get_pid(), id);
+    if (!s->get_process_name().empty()) by_process.emplace(_process_key(s->get_process_name()), id);
+    by_instance.emplace(id, std::move(s));
+    ++version;
+}
+
+void SessionTable::_erase(const std::string& id)
+{
+    const auto it = by_instance.find(id);
+    if (it == by_instance.end()) return;
+    const auto& s = it->second;
+
+    _erase_pair(by_session, s->get_session_id(), id);
+    _erase_pair(by_process, _process_key(s->get_process_name()), id);
+    _erase_pair(by_pid, s->get_pid(), id);
+
+    by_instance.erase(it);
+    ++version;
+}
+
+std::vector<std::shared_ptr<BackendSession>> SessionTable::_collect(const std::unordered_multimap<std::string, std::string>& map, const std::string& key) const
+{
+    std::vector<std::shared_ptr<BackendSession>> vec;
+    const auto range = map.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) vec.push_back(by_instance.at(it->second));
+    return vec;
+}
+
+std::vector<std::shared_ptr<BackendSession>> SessionTable::find(const std::string& text) const
+{
+    std::lock_guard<std::mutex> l(mtx);
+
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) {
+        std::vector<std::shared_ptr<BackendSession>> vec;
+        const auto range = by_pid.equal_range(static_cast<uint32_t>(std::stoul(text)));
+        for (auto it = range.first; it != range.second; ++it) vec.push_back(by_instance.at(it->second));
+        return vec;
+    }
+
+    const auto it = by_instance.find(text);
+    if (it != by_instance.end()) return { it->second };
+
+    auto vec = _collect(by_session, text);
+    if (!vec.empty()) return vec;
+    return _collect(by_process, _process_key(text));
+}
+
+std::vector<std::shared_ptr<BackendSession>> SessionTable::get_all() const
+{
+    std::lock_guard<std::mutex> l(mtx);
+    std::vector<std::shared_ptr<BackendSession>> vec;
+    for (const auto& i : by_instance) vec.push_back(i.second);
+    return vec;
+}
+
+size_t SessionTable::size() const
+{
+    std::lock_guard<std::mutex> l(mtx);
+    return by_instance.size();
+}
+
+uint64_t SessionTable::get_version() const
+{
+    std::lock_guard<std::mutex> l(mtx);
+    return version;
+}
+
+const std::shared_ptr<Device>& SessionTable::get_device() const
+{
+    return dev;
+}
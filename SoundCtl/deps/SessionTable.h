@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "DeviceManager.h"
+
+// The audio sessions of one endpoint, indexed by instance ID, session ID, PID and folded process name.
+// A live table follows session notifications, so it is enumerated once and then patched as applications
+// start and stop streams; a lookup is a hash hit either way.
+class SessionTable : private SessionListener {
+	const std::shared_ptr<Device> dev;
+	const bool live;
+
+	std::unordered_map<std::string, std::shared_ptr<BackendSession>> by_instance;
+	std::unordered_multimap<std::string, std::string> by_session, by_process; // -> instance ID
+	std::unordered_multimap<uint32_t, std::string> by_pid;
+	std::unordered_set<std::string> gone; // expired while the first enumeration ran
+	bool loading = true;
+	uint64_t version = 0;
+	mutable std::mutex mtx;
+
+	void on_session_added(std::shared_ptr<BackendSession>) override;
+	void on_session_expired(const std::string&) override;
+
+	void _insert(std::shared_ptr<BackendSession>);
+	void _erase(const std::string&);
+	std::vector<std::shared_ptr<BackendSession>> _collect(const std::unordered_multimap<std::string, std::string>&, const std::string&) const;
+public:
+	// not live: one enumeration and no notifications, for a single command
+	SessionTable(std::shared_ptr<Device>, const bool = true);
+	SessionTable(const SessionTable&) = delete;
+	void operator=(const SessionTable&) = delete;
+	~SessionTable();
+
+	// A PID if the text is all digits, else an exact session or instance ID, else the process name
+	// (case-insensitive, ".exe" optional). Every match, empty if none.
+	std::vector<std::shared_ptr<BackendSession>> find(const std::string&) const;
+	std::vector<std::shared_ptr<BackendSession>> get_all() const;
+
+	size_t size() const;
+	// bumped on every change
+	uint64_t get_version() const;
+	const std::shared_ptr<Device>& get_device() const;
+};
@@ -0,0 +1,713 @@
+#include "SimAudioBackend.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <math.h>
+#include <thread>
+
+SimConfig SimConfig::parse(const std::string& spec)
+{
+    SimConfig cfg;
+    size_t pos = 0;
+
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+
+        const std::string item = spec.substr(pos, end - pos);
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos) throw std::invalid_argument("Invalid sim option: " + item);
+
+        const std::string key = item.substr(0, eq);
+        const unsigned long val = std::stoul(item.substr(eq + 1));
+
+        if (key == "play") cfg.num_play = val;
+        else if (key == "rec") cfg.num_rec = val;
+        else if (key == "ch") cfg.channels = val;
+        else if (key == "depth") cfg.topology_depth = val;
+        else if (key == "apps") cfg.apps = val;
+        else if (key == "lat") cfg.latency = std::chrono::microseconds(val);
+        else if (key == "fail") cfg.fail_every = val;
+        else if (key == "stall") cfg.stall = std::chrono::milliseconds(val);
+        else throw std::invalid_argument("Unknown sim option: " + key);
+
+        pos = end + 1;
+    }
+
+    return cfg;
+}
+
+SimWorld::SimWorld(const SimConfig& c)
+    : cfg(c)
+{
+    for (size_t a = 0; a < cfg.num_play; ++a) _add(AudioFlow::PLAY, "Sim Speakers " + std::to_string(a));
+    for (size_t a = 0; a < cfg.num_rec; ++a) _add(AudioFlow::REC, "Sim Microphone " + std::to_string(a));
+    _rebuild_active(AudioFlow::PLAY);
+    _rebuild_active(AudioFlow::REC);
+}
+
+std::string SimWorld::_add(const AudioFlow f, const std::string& name)
+{
+    const size_t fl = static_cast<size_t>(f);
+
+    auto ep = std::make_shared<Endpoint>();
+    ep->id = std::string("{sim.") + (f == AudioFlow::REC ? "rec." : "play.") + std::to_string(next_id[fl]++) + "}";
+    ep->name = name;
+    ep->flow = f;
+    for (size_t n = 0; n < cfg.topology_depth; ++n)
+        ep->nodes.push_back(Node{ "Sim Node " + std::to_string(n), std::vector<float>(cfg.channels, 0.0f) });
+    ep->nodes.push_back(Node{ "Sim Mute", {}, NodeKind::MUTE });
+    if (f == AudioFlow::REC) ep->nodes.push_back(Node{ "Sim AGC", {}, NodeKind::AGC });
+    else for (size_t a = 0; a < cfg.apps; ++a) _add_session(*ep, "simapp" + std::to_string(a) + ".exe", static_cast<uint32_t>(1000 + a));
+
+    by_id[ep->id] = ep;
+    all[fl].push_back(ep);
+    return ep->id;
+}
+
+std::shared_ptr<SimWorld::Session> SimWorld::_add_session(Endpoint& ep, const std::string& process, const uint32_t pid)
+{
+    auto ses = std::make_shared<Session>();
+    // same shape as the Core Audio identifiers: the instance ID extends the session ID
+    ses->session_id = ep.id + "|" + process;
+    ses->instance_id = ses->session_id + "%b" + std::to_string(next_session++);
+    ses->process = process;
+    ses->pid = pid;
+    ep.sessions.push_back(ses);
+    return ses;
+}
+
+void SimWorld::_rebuild_active(const AudioFlow f)
+{
+    const size_t fl = static_cast<size_t>(f);
+    active[fl].clear();
+    for (const auto& i : all[fl]) if (i->active) active[fl].push_back(i);
+}
+
+std::vector<BackendListener*> SimWorld::_listeners() const
+{
+    std::lock_guard<std::mutex> l(list_mtx);
+    return listeners;
+}
+
+const SimConfig& SimWorld::get_config() const
+{
+    return cfg;
+}
+
+uint64_t SimWorld::get_call_count() const
+{
+    return calls.load(std::memory_order_relaxed);
+}
+
+void SimWorld::call(const size_t num) const
+{
+    calls.fetch_add(num, std::memory_order_relaxed);
+    if (cfg.latency.count() == 0) return;
+
+    // spin instead of sleep: sleep granularity is far coarser than the latencies being simulated
+    const auto until = std::chrono::steady_clock::now() + cfg.latency * num;
+    while (std::chrono::steady_clock::now() < until) std::this_thread::yield();
+}
+
+void SimWorld::activate(const Endpoint& e) const
+{
+    call();
+    if (cfg.stall.count() && cfg.num_play && e.id == "{sim.play." + std::to_string(cfg.num_play - 1) + "}")
+        std::this_thread::sleep_for(cfg.stall);
+}
+
+void SimWorld::write() const
+{
+    call();
+    if (cfg.fail_every && writes.fetch_add(1, std::memory_order_relaxed) % cfg.fail_every == cfg.fail_every - 1)
+        throw BackendError("Simulated write failure", static_cast<long>(0x88890004)); // AUDCLNT_E_DEVICE_INVALIDATED
+}
+
+size_t SimWorld::get_count(const AudioFlow f) const
+{
+    std::lock_guard<std::mutex> l(list_mtx);
+    return active[static_cast<size_t>(f)].size();
+}
+
+std::shared_ptr<SimWorld::Endpoint> SimWorld::get(const AudioFlow f, const size_t p) const
+{
+    std::lock_guard<std::mutex> l(list_mtx);
+    const auto& vec = active[static_cast<size_t>(f)];
+    if (p >= vec.size()) return nullptr;
+    return vec[p];
+}
+
+std::shared_ptr<SimWorld::Endpoint> SimWorld::get(const std::string& id) const
+{
+    std::lock_guard<std::mutex> l(list_mtx);
+    const auto it = by_id.find(id);
+    return it == by_id.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<SimWorld::Endpoint> SimWorld::get_default(const AudioFlow f) const
+{
+    std::lock_guard<std::mutex> l(list_mtx);
+    const size_t fl = static_cast<size_t>(f);
+    const auto it = by_id.find(default_id[fl]);
+    if (it != by_id.end() && it->second->active) return it->second;
+    return active[fl].empty() ? nullptr : active[fl].front();
+}
+
+void SimWorld::add_listener(BackendListener* lis) const
+{
+    std::lock_guard<std::mutex> l(list_mtx);
+    listeners.push_back(lis);
+}
+
+void SimWorld::remove_listener(BackendListener* lis) const
+{
+    std::lock_guard<std::mutex> l(list_mtx);
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), lis), listeners.end());
+}
+
+std::string SimWorld::add_endpoint(const AudioFlow f, const std::string& name)
+{
+    std::string id;
+    {
+        std::lock_guard<std::mutex> l(list_mtx);
+        id = _add(f, name);
+        _rebuild_active(f);
+    }
+    for (auto* i : _listeners()) i->on_device_changed(id);
+    return id;
+}
+
+void SimWorld::set_active(const std::string& id, const bool act)
+{
+    {
+        std::lock_guard<std::mutex> l(list_mtx);
+        const auto it = by_id.find(id);
+        if (it == by_id.end()) throw std::invalid_argument("Unknown sim endpoint " + id);
+        {
+            std::lock_guard<std::mutex> le(it->second->mtx);
+            it->second->active = act;
+        }
+        _rebuild_active(it->second->flow);
+    }
+    for (auto* i : _listeners()) i->on_device_changed(id);
+}
+
+void SimWorld::rename(const std::string& id, const std::string& name)
+{
+    const auto ep = get(id);
+    if (!ep) throw std::invalid_argument("Unknown sim endpoint " + id);
+    {
+        std::lock_guard<std::mutex> l(ep->mtx);
+        ep->name = name;
+    }
+    for (auto* i : _listeners()) i->on_device_changed(id);
+}
+
+void SimWorld::set_default(const AudioFlow f, const std::string& id)
+{
+    {
+        std::lock_guard<std::mutex> l(list_mtx);
+        default_id[static_cast<size_t>(f)] = id;
+    }
+    for (auto* i : _listeners())
+        for (const AudioType t : { AudioType::CONSOLE, AudioType::MULTIMEDIA, AudioType::COMMUNICATIONS })
+            i->on_default_changed(f, t, id);
+}
+
+std::string SimWorld::add_session(const std::string& id, const std::string& process, const uint32_t pid)
+{
+    const auto ep = get(id);
+    if (!ep) throw std::invalid_argument("Unknown sim endpoint " + id);
+    const auto self = shared_from_this();
+
+    std::lock_guard<std::mutex> l(list_mtx);
+    std::lock_guard<std::mutex> le(ep->mtx);
+    const auto ses = _add_session(*ep, process, pid);
+    // under the endpoint lock, so once a listener is removed nothing reaches it anymore
+    for (auto* i : ep->session_listeners) i->on_session_added(std::make_shared<SimSession>(self, ep, ses));
+    return ses->instance_id;
+}
+
+void SimWorld::expire_session(const std::string& instance)
+{
+    std::vector<std::shared_ptr<Endpoint>> eps;
+    {
+        std::lock_guard<std::mutex> l(list_mtx);
+        for (const auto& i : by_id) eps.push_back(i.second);
+    }
+
+    for (const auto& ep : eps) {
+        std::lock_guard<std::mutex> l(ep->mtx);
+        auto& vec = ep->sessions;
+        const auto it = std::find_if(vec.begin(), vec.end(), [&instance](const std::shared_ptr<Session>& s) { return s->instance_id == instance; });
+        if (it == vec.end()) continue;
+
+        (*it)->expired = true;
+        vec.erase(it);
+        for (auto* i : ep->session_listeners) i->on_session_expired(instance);
+        return;
+    }
+    throw std::invalid_argument("Unknown sim session " + instance);
+}
+
+
+SimLevel::SimLevel(std::shared_ptr<const SimWorld> w, std::shared_ptr<SimWorld::Endpoint> e, const size_t n)
+    : world(std::move(w)), ep(std::move(e)), node(n)
+{
+    std::lock_guard<std::mutex> l(ep->mtx);
+    name = ep->nodes[node].name;
+}
+
+const std::string& SimLevel::get_name() const
+{
+    return name;
+}
+
+size_t SimLevel::get_channel_count() const
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    return ep->nodes[node].levels_db.size();
+}
+
+float SimLevel::get_level_db(const size_t ch) const
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    const auto& lv = ep->nodes[node].levels_db;
+    if (ch >= lv.size()) throw std::runtime_error("Failed to get level of vol");
+    return lv[ch];
+}
+
+void SimLevel::set_level_db(const size_t ch, const float db)
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    auto& lv = ep->nodes[node].levels_db;
+    if (ch < lv.size()) lv[ch] = db;
+}
+
+void SimLevel::get_levels_db(float* out, const size_t n) const
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    const auto& lv = ep->nodes[node].levels_db;
+    if (n > lv.size()) throw std::runtime_error("Failed to get level of vol");
+    for (size_t a = 0; a < n; ++a) out[a] = lv[a];
+}
+
+void SimLevel::set_levels_db(const float* in, const size_t n, const uint32_t mask)
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    auto& lv = ep->nodes[node].levels_db;
+    for (size_t a = 0; a < n && a < lv.size(); ++a) if (channel_in_mask(mask, a)) lv[a] = in[a];
+}
+
+
+SimSwitch::SimSwitch(std::shared_ptr<const SimWorld> w, std::shared_ptr<SimWorld::Endpoint> e, const size_t n)
+    : world(std::move(w)), ep(std::move(e)), node(n)
+{
+    std::lock_guard<std::mutex> l(ep->mtx);
+    name = ep->nodes[node].name;
+}
+
+const std::string& SimSwitch::get_name() const
+{
+    return name;
+}
+
+bool SimSwitch::get() const
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    return ep->nodes[node].on;
+}
+
+void SimSwitch::set(const bool b)
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    ep->nodes[node].on = b;
+}
+
+
+SimSession::SimSession(std::shared_ptr<const SimWorld> w, std::shared_ptr<SimWorld::Endpoint> e, std::shared_ptr<SimWorld::Session> s)
+    : world(std::move(w)), ep(std::move(e)), ses(std::move(s))
+{
+}
+
+const std::string& SimSession::get_instance_id() const
+{
+    return ses->instance_id;
+}
+
+const std::string& SimSession::get_session_id() const
+{
+    return ses->session_id;
+}
+
+uint32_t SimSession::get_pid() const
+{
+    return ses->pid;
+}
+
+const std::string& SimSession::get_process_name() const
+{
+    return ses->process;
+}
+
+void SimSession::set_volume(const float f)
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    if (ses->expired) throw std::runtime_error("Failed to set session volume");
+    ses->volume = f;
+}
+
+float SimSession::get_volume() const
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    if (ses->expired) throw std::runtime_error("Failed to get session volume");
+    return ses->volume;
+}
+
+void SimSession::set_mute(const bool b)
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    if (ses->expired) throw std::runtime_error("Failed to set session mute");
+    ses->mute = b;
+}
+
+bool SimSession::get_mute() const
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    if (ses->expired) throw std::runtime_error("Failed to get session mute");
+    return ses->mute;
+}
+
+
+SimTopology::SimTopology(const SimWorld& world, const SimWorld::Endpoint& ep)
+{
+    std::lock_guard<std::mutex> l(ep.mtx);
+
+    // GetConnectorCount, then GetConnector + GetConnectedTo + QueryInterface
+    world.call(4);
+    _add_part({ "Sim Connector", true, 0 });
+
+    for (size_t n = 0; n < ep.nodes.size(); ++n) {
+        // EnumParts + GetPart + GetLocalId + GetName + GetPartType + GetControlInterfaceCount + GetControlInterface + GetIID
+        world.call(8);
+        const size_t part = _add_part({ ep.nodes[n].name, false, n + 1 });
+        _add_node(ep.nodes[n].kind, part);
+        node_of.push_back(n);
+    }
+}
+
+size_t SimTopology::get_sim_node(const size_t node) const
+{
+    return node_of[node];
+}
+
+
+SimEndpoint::SimEndpoint(std::shared_ptr<const SimWorld> w, std::shared_ptr<SimWorld::Endpoint> e, std::shared_ptr<TopologyCache> cache)
+    : world(std::move(w)), ep(std::move(e)), topologies(std::move(cache))
+{
+    if (!ep) throw std::invalid_argument("NULL DEVICE");
+}
+
+SimEndpoint::~SimEndpoint()
+{
+    if (sessions) set_session_listener(nullptr);
+    if (volumes) set_volume_listener(nullptr);
+}
+
+void SimEndpoint::_activate(bool& done) const
+{
+    std::lock_guard<std::mutex> l(lazy_mtx);
+    if (done) return;
+    TraceScope t("activate");
+    world->activate(*ep); // OpenPropertyStore or Activate
+    done = true;
+}
+
+std::string SimEndpoint::get_id() const
+{
+    world->call();
+    return ep->id;
+}
+
+std::string SimEndpoint::get_friendly_name() const
+{
+    _activate(props);
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    return ep->name;
+}
+
+AudioFlow SimEndpoint::get_flow() const
+{
+    world->call(2); // QueryInterface(IMMEndpoint) + GetDataFlow
+    return ep->flow;
+}
+
+bool SimEndpoint::is_active() const
+{
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    return ep->active;
+}
+
+void SimEndpoint::set_volume(const float f)
+{
+    _activate(vol);
+    world->write();
+    {
+        std::lock_guard<std::mutex> l(ep->mtx);
+        ep->volume = f;
+    }
+    _notify_volume();
+}
+
+float SimEndpoint::get_volume() const
+{
+    _activate(vol);
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    return ep->volume;
+}
+
+void SimEndpoint::set_mute(const bool b)
+{
+    _activate(vol);
+    world->write();
+    {
+        std::lock_guard<std::mutex> l(ep->mtx);
+        ep->mute = b;
+    }
+    _notify_volume();
+}
+
+bool SimEndpoint::get_mute() const
+{
+    _activate(vol);
+    world->call();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    return ep->mute;
+}
+
+size_t SimEndpoint::get_meter_channel_count() const
+{
+    _activate(meter);
+    world->call();
+    return world->get_config().channels;
+}
+
+void SimEndpoint::get_peaks(float* out, const size_t n) const
+{
+    _activate(meter);
+    world->call();
+    if (n != world->get_config().channels) throw BackendError("Failed to get peak values", static_cast<long>(0x80070057)); // E_INVALIDARG
+
+    // a slow wobble per channel, scaled by the endpoint volume like the real meter is
+    const float t = std::chrono::duration<float>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> l(ep->mtx);
+    const float gain = ep->mute ? 0.0f : ep->volume;
+    for (size_t a = 0; a < n; ++a) out[a] = gain * (0.5f + 0.5f * sinf(t * 6.2831853f * (1.0f + 0.25f * a)));
+}
+
+std::vector<std::shared_ptr<BackendSession>> SimEndpoint::get_sessions()
+{
+    _activate(smgr);
+    world->call(2); // GetSessionEnumerator + GetCount
+
+    std::vector<std::shared_ptr<SimWorld::Session>> tmp;
+    {
+        std::lock_guard<std::mutex> l(ep->mtx);
+        tmp = ep->sessions;
+    }
+
+    std::vector<std::shared_ptr<BackendSession>> vec;
+    for (auto& i : tmp) {
+        // GetSession + GetState + QueryInterface x2 + GetSessionInstanceIdentifier + GetSessionIdentifier + GetProcessId
+        world->call(7);
+        vec.push_back(std::make_shared<SimSession>(world, ep, std::move(i)));
+    }
+    return vec;
+}
+
+void SimEndpoint::set_session_listener(SessionListener* l)
+{
+    _activate(smgr);
+    std::lock_guard<std::mutex> lk(ep->mtx);
+
+    auto& vec = ep->session_listeners;
+    if (sessions) {
+        world->call(1 + ep->sessions.size()); // UnregisterSessionNotification + one UnregisterAudioSessionNotification per session
+        vec.erase(std::remove(vec.begin(), vec.end(), sessions), vec.end());
+    }
+    sessions = l;
+    if (l) {
+        world->call(2 + ep->sessions.size()); // GetSessionEnumerator + RegisterSessionNotification + one per session
+        vec.push_back(l);
+    }
+}
+
+void SimEndpoint::set_volume_listener(VolumeListener* l)
+{
+    _activate(vol);
+    world->call(); // RegisterControlChangeNotify or UnregisterControlChangeNotify
+    std::lock_guard<std::mutex> lk(ep->mtx);
+
+    auto& vec = ep->volume_listeners;
+    if (volumes) vec.erase(std::remove(vec.begin(), vec.end(), volumes), vec.end());
+    volumes = l;
+    if (l) vec.push_back(l);
+}
+
+void SimEndpoint::_notify_volume() const
+{
+    std::vector<VolumeListener*> tmp;
+    float v;
+    bool m;
+    {
+        std::lock_guard<std::mutex> l(ep->mtx);
+        tmp = ep->volume_listeners;
+        v = ep->volume;
+        m = ep->mute;
+    }
+    // every write notifies, even one that changes nothing, like Core Audio
+    for (auto* i : tmp) i->on_volume_changed(ep->id, v, m);
+}
+
+std::shared_ptr<const TopologyGraph> SimEndpoint::get_topology()
+{
+    const std::string id = get_id();
+
+    auto graph = topologies->get(id);
+    if (!graph) {
+        _activate(topo);
+        graph = std::make_shared<SimTopology>(*world, *ep);
+        topologies->put(id, graph);
+    }
+    return graph;
+}
+
+std::unique_ptr<BackendLevel> SimEndpoint::get_underlying_volume(const size_t undr)
+{
+    const auto graph = get_topology();
+    const size_t node = graph->find(NodeKind::VOLUME, undr);
+    if (node == static_cast<size_t>(-1)) throw std::runtime_error("Invalid number or no audio interface here.");
+
+    world->call(); // Activate on the part
+    return std::make_unique<SimLevel>(world, ep, static_cast<const SimTopology&>(*graph).get_sim_node(node));
+}
+
+std::unique_ptr<BackendSwitch> SimEndpoint::get_underlying_switch(const NodeKind kind, const size_t undr)
+{
+    if (kind == NodeKind::VOLUME) throw std::invalid_argument("Volume nodes are not switches");
+
+    const auto graph = get_topology();
+    const size_t node = graph->find(kind, undr);
+    if (node == static_cast<size_t>(-1)) throw std::runtime_error("Invalid number or no audio interface here.");
+
+    world->call();
+    return std::make_unique<SimSwitch>(world, ep, static_cast<const SimTopology&>(*graph).get_sim_node(node));
+}
+
+
+void SimAudioBackend::on_device_changed(const std::string& id)
+{
+    topologies->drop(id);
+
+    std::lock_guard<std::mutex> l(listener_mtx);
+    if (listener) listener->on_device_changed(id);
+}
+
+void SimAudioBackend::on_default_changed(const AudioFlow f, const AudioType t, const std::string& id)
+{
+    std::lock_guard<std::mutex> l(listener_mtx);
+    if (listener) listener->on_default_changed(f, t, id);
+}
+
+void SimAudioBackend::_watch()
+{
+    std::lock_guard<std::mutex> l(notify_mtx);
+    if (watching) return;
+
+    world->call(); // RegisterEndpointNotificationCallback
+    world->add_listener(this);
+    watching = true;
+}
+
+SimAudioBackend::SimAudioBackend(std::shared_ptr<const SimWorld> w)
+    : world(std::move(w))
+{
+    if (!world) throw std::invalid_argument("NULL WORLD");
+    {
+        TraceScope t("enumerator");
+        world->call(); // CoCreateInstance
+    }
+    topologies->set_hook([this] { _watch(); });
+}
+
+SimAudioBackend::~SimAudioBackend()
+{
+    topologies->set_hook(nullptr);
+    if (watching) world->remove_listener(this);
+}
+
+void SimAudioBackend::_enumerate(const AudioFlow f) const
+{
+    std::lock_guard<std::mutex> l(enum_mtx);
+    bool& done = enumerated[f == AudioFlow::REC ? 1 : 0];
+    if (done) return;
+    TraceScope t("enumerate");
+    world->call(); // EnumAudioEndpoints
+    done = true;
+}
+
+size_t SimAudioBackend::get_count(const AudioFlow f) const
+{
+    _enumerate(f);
+    world->call();
+    return world->get_count(f);
+}
+
+std::unique_ptr<BackendEndpoint> SimAudioBackend::get_endpoint(const AudioFlow f, const size_t p) const
+{
+    _enumerate(f);
+    world->call();
+    auto ep = world->get(f, p);
+    if (!ep) return nullptr;
+    return std::make_unique<SimEndpoint>(world, std::move(ep), topologies);
+}
+
+std::unique_ptr<BackendEndpoint> SimAudioBackend::get_endpoint(const std::string& id) const
+{
+    world->call();
+    auto ep = world->get(id);
+    if (!ep) return nullptr;
+    return std::make_unique<SimEndpoint>(world, std::move(ep), topologies);
+}
+
+std::unique_ptr<BackendEndpoint> SimAudioBackend::get_default(const AudioFlow f, const AudioType) const
+{
+    world->call();
+    auto ep = world->get_default(f);
+    if (!ep) return nullptr;
+    return std::make_unique<SimEndpoint>(world, std::move(ep), topologies);
+}
+
+void SimAudioBackend::set_listener(BackendListener* l)
+{
+    {
+        std::lock_guard<std::mutex> lk(listener_mtx);
+        listener = l;
+    }
+    if (l) _watch();
+}
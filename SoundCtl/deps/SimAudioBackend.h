@@ -0,0 +1,232 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AudioBackend.h"
+
+// In-process fake of the Core Audio stack. Every method that would be a COM call on Windows
+// counts as one simulated call and burns the configured latency, so timings follow the same call pattern.
+
+struct SimConfig {
+	size_t num_play = 4;
+	size_t num_rec = 2;
+	size_t channels = 2;
+	size_t topology_depth = 1;
+	size_t apps = 2; // sessions per play endpoint
+	std::chrono::microseconds latency{ 0 }; // per simulated call
+	size_t fail_every = 0; // every n-th endpoint volume or mute write fails, as if the device was pulled (0 = never)
+	std::chrono::milliseconds stall{ 0 }; // activating the last playback endpoint takes that long, like a Bluetooth device going away
+
+	// "play=8,rec=4,ch=2,depth=2,apps=2,lat=50,fail=10,stall=5000" (lat in microseconds, stall in ms).
+	// Missing keys keep their defaults.
+	static SimConfig parse(const std::string&);
+};
+
+// The "system" state. It outlives any backend built on it, like the real audio service does.
+// The non-const methods play the part of the user plugging, unplugging or switching devices and notify the listeners.
+class SimWorld : public std::enable_shared_from_this<SimWorld> {
+public:
+	struct Node {
+		std::string name;
+		std::vector<float> levels_db; // VOLUME only
+		NodeKind kind = NodeKind::VOLUME;
+		bool on = false;              // MUTE and AGC
+	};
+	struct Session {
+		std::string instance_id, session_id, process;
+		uint32_t pid = 0;
+		float volume = 1.0f;          // volume, mute and expired are guarded by the endpoint mutex
+		bool mute = false;
+		bool expired = false;
+	};
+	struct Endpoint {
+		std::string id, name;
+		AudioFlow flow = AudioFlow::PLAY;
+		bool active = true;
+		float volume = 1.0f;
+		bool mute = false;
+		std::vector<Node> nodes;
+		std::vector<std::shared_ptr<Session>> sessions;
+		std::vector<SessionListener*> session_listeners;
+		std::vector<VolumeListener*> volume_listeners;
+		mutable std::mutex mtx;
+	};
+private:
+	const SimConfig cfg;
+	std::vector<std::shared_ptr<Endpoint>> all[2], active[2]; // by flow
+	std::unordered_map<std::string, std::shared_ptr<Endpoint>> by_id;
+	std::string default_id[2];
+	size_t next_id[2] = { 0, 0 };
+	size_t next_session = 0;
+	mutable std::vector<BackendListener*> listeners;
+	mutable std::mutex list_mtx;
+	mutable std::atomic<uint64_t> calls{ 0 }, writes{ 0 };
+
+	std::string _add(const AudioFlow, const std::string&);
+	std::shared_ptr<Session> _add_session(Endpoint&, const std::string&, const uint32_t);
+	void _rebuild_active(const AudioFlow);
+	std::vector<BackendListener*> _listeners() const;
+public:
+	SimWorld(const SimConfig&);
+	SimWorld(const SimWorld&) = delete;
+	void operator=(const SimWorld&) = delete;
+
+	const SimConfig& get_config() const;
+	uint64_t get_call_count() const;
+
+	// one simulated backend call
+	void call(const size_t = 1) const;
+	// an interface of that endpoint is activated
+	void activate(const Endpoint&) const;
+	// one simulated endpoint write, throws BackendError every SimConfig::fail_every of them
+	void write() const;
+
+	// active endpoints only, like EnumAudioEndpoints(DEVICE_STATE_ACTIVE)
+	size_t get_count(const AudioFlow) const;
+	std::shared_ptr<Endpoint> get(const AudioFlow, const size_t) const;
+	std::shared_ptr<Endpoint> get(const std::string&) const;
+	std::shared_ptr<Endpoint> get_default(const AudioFlow) const;
+
+	void add_listener(BackendListener*) const;
+	void remove_listener(BackendListener*) const;
+
+	// returns the new endpoint ID
+	std::string add_endpoint(const AudioFlow, const std::string&);
+	void set_active(const std::string&, const bool);
+	void rename(const std::string&, const std::string&);
+	void set_default(const AudioFlow, const std::string&);
+	// an application starting or stopping a stream on that endpoint. Returns the session instance ID.
+	std::string add_session(const std::string&, const std::string&, const uint32_t);
+	void expire_session(const std::string&);
+};
+
+class SimLevel : public BackendLevel {
+	std::shared_ptr<const SimWorld> world;
+	std::shared_ptr<SimWorld::Endpoint> ep;
+	const size_t node;
+	std::string name;
+public:
+	SimLevel(std::shared_ptr<const SimWorld>, std::shared_ptr<SimWorld::Endpoint>, const size_t);
+
+	const std::string& get_name() const override;
+	size_t get_channel_count() const override;
+	float get_level_db(const size_t) const override;
+	void set_level_db(const size_t, const float) override;
+	void get_levels_db(float*, const size_t) const override;
+	void set_levels_db(const float*, const size_t, const uint32_t) override;
+};
+
+class SimSwitch : public BackendSwitch {
+	std::shared_ptr<const SimWorld> world;
+	std::shared_ptr<SimWorld::Endpoint> ep;
+	const size_t node;
+	std::string name;
+public:
+	SimSwitch(std::shared_ptr<const SimWorld>, std::shared_ptr<SimWorld::Endpoint>, const size_t);
+
+	const std::string& get_name() const override;
+	bool get() const override;
+	void set(const bool) override;
+};
+
+class SimSession : public BackendSession {
+	std::shared_ptr<const SimWorld> world;
+	std::shared_ptr<SimWorld::Endpoint> ep;
+	std::shared_ptr<SimWorld::Session> ses;
+public:
+	SimSession(std::shared_ptr<const SimWorld>, std::shared_ptr<SimWorld::Endpoint>, std::shared_ptr<SimWorld::Session>);
+
+	const std::string& get_instance_id() const override;
+	const std::string& get_session_id() const override;
+	uint32_t get_pid() const override;
+	const std::string& get_process_name() const override;
+	void set_volume(const float) override;
+	float get_volume() const override;
+	void set_mute(const bool) override;
+	bool get_mute() const override;
+};
+
+// One connector part, then a chain with one part per SimWorld node
+class SimTopology : public TopologyGraph {
+	std::vector<size_t> node_of; // graph node -> SimWorld node
+public:
+	SimTopology(const SimWorld&, const SimWorld::Endpoint&);
+
+	size_t get_sim_node(const size_t) const;
+};
+
+class SimEndpoint : public BackendEndpoint {
+	std::shared_ptr<const SimWorld> world;
+	std::shared_ptr<SimWorld::Endpoint> ep;
+	const std::shared_ptr<TopologyCache> topologies;
+	// interfaces "activated" so far, same lazy pattern as WinEndpoint
+	mutable bool props = false, vol = false, meter = false, smgr = false, topo = false;
+	mutable std::mutex lazy_mtx; // guards the flags above, used from any thread
+	SessionListener* sessions = nullptr;
+	VolumeListener* volumes = nullptr;
+
+	void _activate(bool&) const;
+	// what Core Audio does after a write, from the writing thread here
+	void _notify_volume() const;
+public:
+	SimEndpoint(std::shared_ptr<const SimWorld>, std::shared_ptr<SimWorld::Endpoint>, std::shared_ptr<TopologyCache>);
+	SimEndpoint(const SimEndpoint&) = delete;
+	void operator=(const SimEndpoint&) = delete;
+	~SimEndpoint();
+
+	std::string get_id() const override;
+	std::string get_friendly_name() const override;
+	AudioFlow get_flow() const override;
+	bool is_active() const override;
+	void set_volume(const float) override;
+	float get_volume() const override;
+	void set_mute(const bool) override;
+	bool get_mute() const override;
+	size_t get_meter_channel_count() const override;
+	void get_peaks(float*, const size_t) const override;
+
+	std::vector<std::shared_ptr<BackendSession>> get_sessions() override;
+	void set_session_listener(SessionListener*) override;
+	void set_volume_listener(VolumeListener*) override;
+
+	std::shared_ptr<const TopologyGraph> get_topology() override;
+	std::unique_ptr<BackendLevel> get_underlying_volume(const size_t) override;
+	std::unique_ptr<BackendSwitch> get_underlying_switch(const NodeKind, const size_t) override;
+};
+
+// One "enumerator session" over a SimWorld. Construction costs what CoCreateInstance + two EnumAudioEndpoints would.
+// Same notification plumbing as WinAudioBackend: registered in the world once a listener or a cached topology needs it.
+class SimAudioBackend : public AudioBackend, private BackendListener {
+	std::shared_ptr<const SimWorld> world;
+	BackendListener* listener = nullptr;
+	const std::shared_ptr<TopologyCache> topologies = std::make_shared<TopologyCache>();
+	bool watching = false;
+	mutable bool enumerated[2] = { false, false }; // by flow, like the lazy collections of the real one
+	std::mutex notify_mtx, listener_mtx;
+	mutable std::mutex enum_mtx;
+
+	void on_device_changed(const std::string&) override;
+	void on_default_changed(const AudioFlow, const AudioType, const std::string&) override;
+
+	void _watch();
+	void _enumerate(const AudioFlow) const;
+public:
+	SimAudioBackend(std::shared_ptr<const SimWorld>);
+	SimAudioBackend(const SimAudioBackend&) = delete;
+	void operator=(const SimAudioBackend&) = delete;
+	~SimAudioBackend();
+
+	size_t get_count(const AudioFlow) const override;
+	std::unique_ptr<BackendEndpoint> get_endpoint(const AudioFlow, const size_t) const override;
+	std::unique_ptr<BackendEndpoint> get_endpoint(const std::string&) const override;
+	std::unique_ptr<BackendEndpoint> get_default(const AudioFlow, const AudioType) const override;
+
+	void set_listener(BackendListener*) override;
+};
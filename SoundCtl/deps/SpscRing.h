@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+// Fixed size queue for exactly one producer thread and one consumer thread. Neither side ever waits:
+// push fails when full and pop fails when empty. Capacity is rounded up to a power of two.
+template<typename T>
+class SpscRing {
+	std::vector<T> slots;
+	size_t mask;
+	// on separate cache lines so the two threads do not keep stealing each other's line
+	alignas(64) std::atomic<size_t> head{ 0 }; // next slot to read, owned by the consumer
+	alignas(64) std::atomic<size_t> tail{ 0 }; // next slot to write, owned by the producer
+public:
+	SpscRing(const size_t cap)
+	{
+		if (cap == 0) throw std::invalid_argument("Invalid ring capacity");
+		size_t n = 1;
+		while (n < cap) n <<= 1;
+		slots.resize(n);
+		mask = n - 1;
+	}
+	SpscRing(const SpscRing&) = delete;
+	void operator=(const SpscRing&) = delete;
+
+	// producer side
+	bool push(const T& v)
+	{
+		const size_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) > mask) return false;
+		slots[t & mask] = v;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side
+	bool pop(T& v)
+	{
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		v = slots[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t capacity() const
+	{
+		return mask + 1;
+	}
+};
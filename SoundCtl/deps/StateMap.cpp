@@ -0,0 +1,231 @@
+#include "StateMap.h"
+#include "Ipc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string.h>
+#include <utility>
+
+#ifdef _WIN32
+static std::wstring _widen(const std::string& s)
+{
+    return std::wstring(s.begin(), s.end());
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+    "the counters are shared between processes");
+
+// how often a reader tries again before it gives up on a slot or on the set
+static const size_t read_tries = 64;
+
+// cut at the last whole UTF-8 character that fits
+static void _copy_text(char* dst, const std::string& s)
+{
+    size_t n = std::min(s.size(), state_max_text - 1);
+    if (n < s.size()) while (n && (static_cast<unsigned char>(s[n]) & 0xC0) == 0x80) --n;
+    memcpy(dst, s.data(), n);
+    dst[n] = '\0';
+}
+
+#ifdef _WIN32
+StateMap StateMap::create(const std::string& name)
+{
+    StateMap m;
+    m.h = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(SharedState), _widen(name).c_str());
+    if (!m.h) throw std::runtime_error("Cannot create " + name);
+    m.view = static_cast<SharedState*>(MapViewOfFile(m.h, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedState)));
+    if (!m.view) throw std::runtime_error("Cannot map " + name);
+    m.view->magic.store(0, std::memory_order_release);
+    memset(reinterpret_cast<char*>(m.view) + sizeof(m.view->magic), 0, sizeof(SharedState) - sizeof(m.view->magic));
+    return m;
+}
+
+StateMap StateMap::open(const std::string& name)
+{
+    StateMap m;
+    m.h = OpenFileMappingW(FILE_MAP_READ, FALSE, _widen(name).c_str());
+    if (!m.h) throw std::runtime_error("Nothing published at " + name);
+    m.view = static_cast<SharedState*>(MapViewOfFile(m.h, FILE_MAP_READ, 0, 0, sizeof(SharedState)));
+    if (!m.view) throw std::runtime_error("Cannot map " + name);
+    return m;
+}
+
+StateMap::StateMap(StateMap&& m) noexcept
+    : h(std::exchange(m.h, nullptr)), view(std::exchange(m.view, nullptr))
+{
+}
+
+void StateMap::_close()
+{
+    if (view) { UnmapViewOfFile(view); view = nullptr; }
+    if (h) { CloseHandle(h); h = nullptr; }
+}
+
+std::string state_default_name()
+{
+    return "Local\\SoundCtl.state";
+}
+#else
+StateMap StateMap::create(const std::string& name)
+{
+    prepare_runtime_path(name);
+
+    StateMap m;
+    // never through a symlink, and only a file of our own: the truncation below would hit whatever it is
+    m.fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (m.fd < 0) throw std::runtime_error("Cannot create " + name);
+    struct stat st;
+    if (fstat(m.fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid()) throw std::runtime_error("Not a state file of ours: " + name);
+    if (ftruncate(m.fd, sizeof(SharedState)) != 0) throw std::runtime_error("Cannot size " + name);
+    void* p = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, m.fd, 0);
+    if (p == MAP_FAILED) throw std::runtime_error("Cannot map " + name);
+    m.view = static_cast<SharedState*>(p);
+    // readers still mapping the last run see no magic until the header is whole again
+    m.view->magic.store(0, std::memory_order_release);
+    memset(reinterpret_cast<char*>(m.view) + sizeof(m.view->magic), 0, sizeof(SharedState) - sizeof(m.view->magic));
+    return m;
+}
+
+StateMap StateMap::open(const std::string& name)
+{
+    StateMap m;
+    m.fd = ::open(name.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (m.fd < 0) throw std::runtime_error("Nothing published at " + name);
+    struct stat st;
+    if (fstat(m.fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_uid != geteuid() || static_cast<size_t>(st.st_size) < sizeof(SharedState))
+        throw std::runtime_error("Not a state file: " + name);
+    void* p = mmap(nullptr, sizeof(SharedState), PROT_READ, MAP_SHARED, m.fd, 0);
+    if (p == MAP_FAILED) throw std::runtime_error("Cannot map " + name);
+    m.view = static_cast<SharedState*>(p);
+    return m;
+}
+
+StateMap::StateMap(StateMap&& m) noexcept
+    : fd(std::exchange(m.fd, -1)), view(std::exchange(m.view, nullptr))
+{
+}
+
+void StateMap::_close()
+{
+    if (view) { munmap(view, sizeof(SharedState)); view = nullptr; }
+    if (fd >= 0) { close(fd); fd = -1; }
+}
+
+std::string state_default_name()
+{
+    return user_runtime_dir() + "/soundctl.state";
+}
+#endif
+
+StateMap::~StateMap()
+{
+    _close();
+}
+
+SharedState& StateMap::get()
+{
+    return *view;
+}
+
+const SharedState& StateMap::get() const
+{
+    return *view;
+}
+
+void state_write(SharedDevice& d, const PublishedDevice& p)
+{
+    const uint32_t s = d.seq.load(std::memory_order_relaxed);
+    d.seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release); // odd before any field changes
+
+    const DeviceState& st = p.state;
+    uint32_t flags = 0;
+    if (st.flow == AudioFlow::REC) flags |= STATE_REC;
+    if (st.is_default) flags |= STATE_DEFAULT;
+    if (st.mute) flags |= STATE_MUTE;
+    if (p.has_peak) flags |= STATE_PEAK;
+    d.flags = flags;
+    d.volume = st.volume;
+    d.peak = p.has_peak ? p.peak : 0.0f;
+    d.channels = static_cast<uint32_t>(std::min(st.levels.size(), state_max_channels));
+    for (size_t c = 0; c < d.channels; ++c) d.levels[c] = st.levels[c];
+    _copy_text(d.id, st.id);
+    _copy_text(d.name, st.name);
+
+    d.seq.store(s + 2, std::memory_order_release);
+}
+
+void state_begin_set(SharedState& s)
+{
+    s.generation.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void state_end_set(SharedState& s, const uint32_t count)
+{
+    s.count.store(count, std::memory_order_relaxed);
+    s.generation.fetch_add(1, std::memory_order_release);
+    if (s.magic.load(std::memory_order_relaxed) != state_magic) {
+        s.layout = state_layout;
+        s.capacity = static_cast<uint32_t>(state_max_devices);
+        s.magic.store(state_magic, std::memory_order_release);
+    }
+}
+
+static bool _read(const SharedDevice& d, PublishedDevice& p)
+{
+    SharedDevice copy;
+    for (size_t t = 0; t < read_tries; ++t) {
+        const uint32_t s = d.seq.load(std::memory_order_acquire);
+        if (s & 1) continue;
+        // the copy may be torn, it is only looked at once the sequence proves it was not
+        copy.flags = d.flags;
+        copy.volume = d.volume;
+        copy.peak = d.peak;
+        copy.channels = d.channels;
+        memcpy(copy.levels, d.levels, sizeof(copy.levels));
+        memcpy(copy.id, d.id, sizeof(copy.id));
+        memcpy(copy.name, d.name, sizeof(copy.name));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (d.seq.load(std::memory_order_relaxed) != s) continue;
+
+        p.state.flow = (copy.flags & STATE_REC) ? AudioFlow::REC : AudioFlow::PLAY;
+        p.state.is_default = (copy.flags & STATE_DEFAULT) != 0;
+        p.state.mute = (copy.flags & STATE_MUTE) != 0;
+        p.state.volume = copy.volume;
+        p.state.levels.assign(copy.levels, copy.levels + std::min<size_t>(copy.channels, state_max_channels));
+        copy.id[state_max_text - 1] = copy.name[state_max_text - 1] = '\0';
+        p.state.id = copy.id;
+        p.state.name = copy.name;
+        p.has_peak = (copy.flags & STATE_PEAK) != 0;
+        p.peak = copy.peak;
+        return true;
+    }
+    return false;
+}
+
+bool state_read(const SharedState& s, std::vector<PublishedDevice>& out)
+{
+    if (s.magic.load(std::memory_order_acquire) != state_magic || s.layout != state_layout) return false;
+
+    for (size_t t = 0; t < read_tries; ++t) {
+        const uint64_t gen = s.generation.load(std::memory_order_acquire);
+        if (gen & 1) continue;
+
+        const size_t n = std::min<size_t>(s.count.load(std::memory_order_relaxed), std::min<size_t>(s.capacity, state_max_devices));
+        out.resize(n);
+        bool ok = true;
+        for (size_t p = 0; p < n && ok; ++p) ok = _read(s.devices[p], out[p]);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (ok && s.generation.load(std::memory_order_relaxed) == gen) return true;
+    }
+    return false;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#include "MachineOutput.h"
+
+// State of every endpoint in shared memory, for any number of local readers: once mapped, reading is plain loads,
+// no syscall and no lock. A named mapping on Windows, a file in the user's runtime directory elsewhere (see user_runtime_dir).
+// One publisher writes it (see StatePublisher). Every slot is a seqlock: its sequence is odd while it is rewritten,
+// a reader copies the slot and keeps the copy only if the sequence was even and did not move. The slot set itself is
+// versioned the same way by the generation, odd while devices are added or removed.
+// The layout only ever grows at the end of a slot or of the header; anything else bumps state_layout.
+
+const uint32_t state_magic = 0x54534353; // "SCST"
+const uint32_t state_layout = 1;
+const size_t state_max_devices = 64;
+const size_t state_max_channels = 16;
+const size_t state_max_text = 256; // bytes, UTF-8, always zero terminated
+
+enum StateFlags : uint32_t {
+	STATE_REC = 1,     // capture endpoint, else playback
+	STATE_DEFAULT = 2, // default console endpoint of its flow
+	STATE_MUTE = 4,
+	STATE_PEAK = 8     // peak is filled in
+};
+
+// Fields past seq are plain memory: only ever read between two loads of seq
+struct alignas(64) SharedDevice {
+	std::atomic<uint32_t> seq;
+	uint32_t flags;
+	float volume;     // endpoint volume [0..1]
+	float peak;       // last peak [0..1], if STATE_PEAK
+	uint32_t channels; // levels in use
+	float levels[state_max_channels]; // scalars, channels of the first topology volume node
+	char id[state_max_text];
+	char name[state_max_text];
+};
+
+struct SharedState {
+	std::atomic<uint32_t> magic;   // written last when the publisher starts, zero before
+	uint32_t layout;
+	uint32_t capacity;             // state_max_devices of the publisher
+	std::atomic<uint32_t> count;   // slots in use
+	std::atomic<uint64_t> generation;
+	std::atomic<uint64_t> updated_ms; // wall clock of the last sample (ms since 1970), to tell a publisher that died
+	alignas(64) SharedDevice devices[state_max_devices];
+};
+
+// What a slot holds, as the rest of the program sees it
+struct PublishedDevice {
+	DeviceState state;
+	bool has_peak = false;
+	float peak = 0.0f;
+};
+
+class StateMap {
+#ifdef _WIN32
+	HANDLE h = nullptr;
+#else
+	int fd = -1;
+#endif
+	SharedState* view = nullptr;
+
+	void _close();
+public:
+	// Publisher side: creates the mapping (or takes over an existing one) and clears it. Throws if it cannot.
+	static StateMap create(const std::string&);
+	// Reader side, read only. Throws if there is no such mapping or it is too small.
+	static StateMap open(const std::string&);
+
+	StateMap() = default;
+	StateMap(const StateMap&) = delete;
+	StateMap(StateMap&&) noexcept;
+	void operator=(const StateMap&) = delete;
+	void operator=(StateMap&&) = delete;
+	~StateMap();
+
+	SharedState& get();
+	const SharedState& get() const;
+};
+
+// Default mapping name for the current user
+std::string state_default_name();
+
+// Publisher side, the only writer of that slot
+void state_write(SharedDevice&, const PublishedDevice&);
+// Brackets a change of the slot set (count and which endpoint sits in which slot)
+void state_begin_set(SharedState&);
+void state_end_set(SharedState&, const uint32_t);
+
+// Reader side. false if nothing was published yet, or if the publisher kept rewriting under every retry (try again later)
+bool state_read(const SharedState&, std::vector<PublishedDevice>&);
@@ -0,0 +1,152 @@
+#include "StatePublisher.h"
+
+#include <algorithm>
+
+static bool _same(const PublishedDevice& a, const PublishedDevice& b)
+{
+    return a.state.volume == b.state.volume && a.state.mute == b.state.mute && a.state.is_default == b.state.is_default &&
+        a.state.levels == b.state.levels && a.has_peak == b.has_peak && a.peak == b.peak;
+}
+
+static uint64_t _now_ms()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+StatePublisher::StatePublisher(std::shared_ptr<AudioBackend> b, const std::string& name, const std::chrono::microseconds per, const bool pk)
+    : registry(std::move(b)), map(StateMap::create(name)), period(per), peaks(pk)
+{
+    worker = std::thread(&StatePublisher::_work, this);
+}
+
+StatePublisher::~StatePublisher()
+{
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        stop = true;
+    }
+    cond.notify_all();
+    worker.join();
+}
+
+StatePublisher::Stats StatePublisher::get_stats()
+{
+    std::lock_guard<std::mutex> l(mtx);
+    return stats;
+}
+
+void StatePublisher::_work()
+{
+    auto next = std::chrono::steady_clock::now();
+    while (true) {
+        const auto snap = registry.get_snapshot();
+        if (snap->version != seen_version) _rebuild(*snap); // reads every slot anyway
+        else _sample();
+        map.get().updated_ms.store(_now_ms(), std::memory_order_release);
+
+        next += period;
+        const auto now = std::chrono::steady_clock::now();
+        if (next < now) next = now; // fell behind (slow device), do not try to catch up
+
+        std::unique_lock<std::mutex> l(mtx);
+        if (cond.wait_until(l, next, [this] { return stop; })) return;
+    }
+}
+
+// an endpoint came, went or became the default: open the set again, every slot is written once
+void StatePublisher::_rebuild(const DeviceRegistry::Snapshot& snap)
+{
+    std::vector<Slot> fresh;
+    for (const AudioFlow f : { AudioFlow::PLAY, AudioFlow::REC }) {
+        const DeviceRegistry::Entry* def = snap.find_default(f, AudioType::CONSOLE);
+        for (const auto& e : snap.devices[static_cast<size_t>(f)]) {
+            if (fresh.size() == state_max_devices) break;
+
+            Slot s;
+            // the one already open is kept, its stats and topology with it
+            const auto it = std::find_if(slots.begin(), slots.end(), [&](const Slot& o) { return o.last.state.id == e.id; });
+            if (it != slots.end()) {
+                s.dev = it->dev;
+                s.level = it->level;
+            }
+            else {
+                try {
+                    s.dev = std::make_shared<Device>(registry.open(e.id));
+                }
+                catch (...) {
+                    continue; // gone again, the next snapshot says so
+                }
+                try {
+                    s.level = std::make_shared<VolumeDevice>(s.dev->get_underlying_volume(0));
+                }
+                catch (...) {
+                    // no volume node in the topology, the endpoint volume is all there is
+                }
+            }
+            s.last.state.flow = f;
+            s.last.state.id = e.id;
+            s.last.state.name = e.name;
+            s.last.state.is_default = (def == &e);
+            fresh.push_back(std::move(s));
+        }
+    }
+
+    // device calls first: readers retry while the generation is odd, a slow endpoint must not keep it odd
+    for (auto& i : fresh) _read(i, i.last);
+
+    SharedState& sh = map.get();
+    state_begin_set(sh);
+    for (size_t p = 0; p < fresh.size(); ++p) state_write(sh.devices[p], fresh[p].last);
+    state_end_set(sh, static_cast<uint32_t>(fresh.size()));
+
+    slots = std::move(fresh);
+    seen_version = snap.version;
+
+    std::lock_guard<std::mutex> l(mtx);
+    ++stats.rebuilds;
+    stats.writes += slots.size();
+}
+
+bool StatePublisher::_read(const Slot& s, PublishedDevice& out) const
+{
+    try {
+        // what read_state() gives, without asking for the ID and name every time
+        out.state.volume = s.dev->get_volume();
+        out.state.mute = s.dev->get_mute();
+        if (s.level) out.state.levels = s.level->get_levels();
+    }
+    catch (...) {
+        return false; // unplugged, the registry hears about it
+    }
+
+    out.has_peak = false;
+    if (!peaks) return true;
+    try {
+        const auto v = s.dev->get_peaks();
+        out.peak = v.empty() ? 0.0f : *std::max_element(v.begin(), v.end());
+        out.has_peak = true;
+    }
+    catch (...) {
+        // no meter on this endpoint (or backend)
+    }
+    return true;
+}
+
+void StatePublisher::_sample()
+{
+    SharedState& sh = map.get();
+    uint64_t writes = 0;
+
+    for (size_t p = 0; p < slots.size(); ++p) {
+        PublishedDevice now = slots[p].last;
+        if (!_read(slots[p], now) || _same(now, slots[p].last)) continue;
+        state_write(sh.devices[p], now);
+        slots[p].last = std::move(now);
+        ++writes;
+    }
+
+    std::lock_guard<std::mutex> l(mtx);
+    ++stats.samples;
+    stats.writes += writes;
+}
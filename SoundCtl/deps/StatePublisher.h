@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeviceRegistry.h"
+#include "StateMap.h"
+
+// Keeps a StateMap current on its own thread. The DeviceRegistry follows endpoints coming and going and the default
+// switching (notifications); volume, mute, channel levels and, if asked, the peak are sampled through the Device
+// accessors at the given rate. Only slots whose values changed are rewritten, so readers rarely retry.
+class StatePublisher {
+public:
+	struct Stats {
+		uint64_t samples = 0, writes = 0, rebuilds = 0;
+	};
+private:
+	struct Slot {
+		std::shared_ptr<Device> dev;
+		std::shared_ptr<VolumeDevice> level; // first topology volume node, nullptr if there is none
+		PublishedDevice last;
+	};
+
+	DeviceRegistry registry;
+	StateMap map;
+	const std::chrono::microseconds period;
+	const bool peaks;
+	std::vector<Slot> slots;
+	uint64_t seen_version = static_cast<uint64_t>(-1);
+	Stats stats; // under mtx
+
+	std::mutex mtx;
+	std::condition_variable cond;
+	bool stop = false;
+	std::thread worker;
+
+	void _work();
+	void _rebuild(const DeviceRegistry::Snapshot&);
+	void _sample();
+	bool _read(const Slot&, PublishedDevice&) const;
+public:
+	// Starts publishing right away. Throws if the mapping cannot be created.
+	StatePublisher(std::shared_ptr<AudioBackend>, const std::string&, const std::chrono::microseconds, const bool);
+	StatePublisher(const StatePublisher&) = delete;
+	void operator=(const StatePublisher&) = delete;
+	~StatePublisher();
+
+	Stats get_stats();
+};
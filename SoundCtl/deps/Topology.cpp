@@ -0,0 +1,91 @@
+#include "Topology.h"
+
+size_t TopologyGraph::_add_part(Part&& p)
+{
+    parts.push_back(std::move(p));
+    return parts.size() - 1;
+}
+
+void TopologyGraph::_add_node(const NodeKind k, const size_t part)
+{
+    by_kind[static_cast<size_t>(k)].push_back(nodes.size());
+    nodes.push_back({ k, part });
+}
+
+const std::vector<TopologyGraph::Part>& TopologyGraph::get_parts() const
+{
+    return parts;
+}
+
+const std::vector<TopologyGraph::Node>& TopologyGraph::get_nodes() const
+{
+    return nodes;
+}
+
+size_t TopologyGraph::get_count(const NodeKind k) const
+{
+    return by_kind[static_cast<size_t>(k)].size();
+}
+
+size_t TopologyGraph::find(const NodeKind k, const size_t n) const
+{
+    const auto& vec = by_kind[static_cast<size_t>(k)];
+    return n < vec.size() ? vec[n] : static_cast<size_t>(-1);
+}
+
+const std::string& TopologyGraph::get_name(const size_t node) const
+{
+    return parts[nodes[node].part].name;
+}
+
+std::shared_ptr<const TopologyGraph> TopologyCache::get(const std::string& id) const
+{
+    std::lock_guard<std::mutex> l(mtx);
+    const auto it = graphs.find(id);
+    return it == graphs.end() ? nullptr : it->second;
+}
+
+void TopologyCache::put(const std::string& id, std::shared_ptr<const TopologyGraph> g)
+{
+    std::unique_lock<std::mutex> l(mtx);
+    if (!hooked && hook) {
+        if (hooking) return; // another thread is starting the watch, this graph is just not kept
+        hooking = true;
+        const auto f = hook;
+        l.unlock();
+        bool ok = false;
+        try {
+            f();
+            ok = true;
+        }
+        catch (...) {
+            // not watched: built again next time, and the hook tried again
+        }
+        l.lock();
+        hooking = false;
+        hooked = ok;
+        hook_done.notify_all();
+        if (!ok) return;
+    }
+    ++builds;
+    graphs[id] = std::move(g);
+}
+
+void TopologyCache::drop(const std::string& id)
+{
+    std::lock_guard<std::mutex> l(mtx);
+    graphs.erase(id);
+}
+
+void TopologyCache::set_hook(std::function<void()> f)
+{
+    std::unique_lock<std::mutex> l(mtx);
+    hook_done.wait(l, [this] { return !hooking; });
+    hook = std::move(f);
+}
+
+uint64_t TopologyCache::get_build_count() const
+{
+    std::lock_guard<std::mutex> l(mtx);
+    return builds;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class NodeKind { VOLUME = 0, MUTE = 1, AGC = 2 };
+
+// Every part reached walking the device topology from the endpoint connectors, and the controls found on them.
+// Built once per endpoint, then looking up the n-th control of a kind is an index. Backends derive from it to
+// keep their own handles next to the nodes (same position as in get_nodes()).
+class TopologyGraph {
+public:
+	struct Part {
+		std::string name;
+		bool connector;
+		size_t depth; // parts between the endpoint and this one
+	};
+	struct Node {
+		NodeKind kind;
+		size_t part;
+	};
+private:
+	std::vector<Part> parts;
+	std::vector<Node> nodes;
+	std::vector<size_t> by_kind[3];
+protected:
+	size_t _add_part(Part&&);
+	void _add_node(const NodeKind, const size_t);
+public:
+	virtual ~TopologyGraph() = default;
+
+	const std::vector<Part>& get_parts() const;
+	const std::vector<Node>& get_nodes() const;
+	size_t get_count(const NodeKind) const;
+	// position in get_nodes() of the n-th control of that kind, npos if there is none
+	size_t find(const NodeKind, const size_t) const;
+	const std::string& get_name(const size_t) const;
+};
+
+// Graphs by endpoint ID, shared between a backend and the endpoints it hands out.
+// The backend drops a graph when its device changes; the hook runs on the first graph stored so it can start watching.
+// Until it succeeded once, nothing is kept: a graph nobody drops would go stale.
+class TopologyCache {
+	std::unordered_map<std::string, std::shared_ptr<const TopologyGraph>> graphs;
+	std::function<void()> hook;
+	bool hooked = false, hooking = false;
+	uint64_t builds = 0;
+	mutable std::mutex mtx;
+	std::condition_variable hook_done;
+public:
+	std::shared_ptr<const TopologyGraph> get(const std::string&) const;
+	void put(const std::string&, std::shared_ptr<const TopologyGraph>);
+	void drop(const std::string&);
+
+	// Called without the cache locked, until it does not throw. nullptr before the owner goes away: that waits for a
+	// call in progress.
+	void set_hook(std::function<void()>);
+	uint64_t get_build_count() const;
+};
@@ -0,0 +1,50 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+static std::atomic<bool> trace_on{ false };
+static std::mutex trace_mtx;
+static std::vector<TraceEntry> trace_entries;
+
+void trace_enable()
+{
+    trace_on.store(true, std::memory_order_relaxed);
+}
+
+bool trace_enabled()
+{
+    return trace_on.load(std::memory_order_relaxed);
+}
+
+void trace_add(const char* name, const std::chrono::steady_clock::duration d)
+{
+    const double us = std::chrono::duration<double, std::micro>(d).count();
+
+    std::lock_guard<std::mutex> l(trace_mtx);
+    auto it = std::find_if(trace_entries.begin(), trace_entries.end(), [name](const TraceEntry& e) { return e.name == name; });
+    if (it == trace_entries.end()) {
+        trace_entries.push_back(TraceEntry{ name });
+        it = trace_entries.end() - 1;
+    }
+    ++it->count;
+    it->total_us += us;
+    it->max_us = std::max(it->max_us, us);
+}
+
+std::vector<TraceEntry> trace_get()
+{
+    std::lock_guard<std::mutex> l(trace_mtx);
+    return trace_entries;
+}
+
+TraceScope::TraceScope(const char* n)
+    : name(n), on(trace_enabled()), start(on ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{})
+{
+}
+
+TraceScope::~TraceScope()
+{
+    if (on) trace_add(name, std::chrono::steady_clock::now() - start);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Startup phase timings for -trace (COM init, enumerator, enumerate, match, activate, apply).
+// Off until trace_enable(); then each TraceScope costs two clock reads and a short lock. Phases with the same
+// name add up, so "activate" is every interface activated during the run. A phase includes the ones nested in it.
+
+struct TraceEntry {
+	std::string name;
+	uint64_t count = 0;
+	double total_us = 0;
+	double max_us = 0;
+};
+
+void trace_enable();
+bool trace_enabled();
+void trace_add(const char*, const std::chrono::steady_clock::duration);
+// in order of first appearance
+std::vector<TraceEntry> trace_get();
+
+class TraceScope {
+	const char* const name;
+	const bool on;
+	const std::chrono::steady_clock::time_point start;
+public:
+	TraceScope(const char*);
+	TraceScope(const TraceScope&) = delete;
+	void operator=(const TraceScope&) = delete;
+	~TraceScope();
+};
@@ -0,0 +1,1105 @@
+#include "WinAudioBackend.h"
+#include "Trace.h"
+
+#include <deque>
+#include <unordered_set>
+
+#ifdef _WIN32
+
+static_assert(static_cast<int>(AudioType::CONSOLE) == eConsole, "AudioType must match ERole");
+static_assert(static_cast<int>(AudioType::MULTIMEDIA) == eMultimedia, "AudioType must match ERole");
+static_assert(static_cast<int>(AudioType::COMMUNICATIONS) == eCommunications, "AudioType must match ERole");
+
+bool WinAudioBackend::coinit = false;
+
+static std::string _to_utf8(const wchar_t* w)
+{
+    if (!w) return {};
+    const int len = WideCharToMultiByte(CP_UTF8, 0, w, -1, nullptr, 0, nullptr, nullptr);
+    if (len <= 1) return {};
+
+    std::string s(static_cast<size_t>(len - 1), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, w, -1, &s[0], len, nullptr, nullptr);
+    return s;
+}
+
+static std::wstring _from_utf8(const std::string& s)
+{
+    if (s.empty()) return {};
+    const int len = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, nullptr, 0);
+    if (len <= 1) return {};
+
+    std::wstring w(static_cast<size_t>(len - 1), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, s.c_str(), -1, &w[0], len);
+    return w;
+}
+
+
+WinLevel::WinLevel(IAudioVolumeLevel* lvl, std::string s)
+    : level(lvl), name(std::move(s))
+{
+    if (!level) throw std::invalid_argument("NULL LEVEL");
+}
+
+const std::string& WinLevel::get_name() const
+{
+    return name;
+}
+
+size_t WinLevel::get_channel_count() const
+{
+    UINT _c;
+    HRESULT hr = level->GetChannelCount(&_c);
+    if (FAILED(hr)) throw BackendError("Failed to get channel count", hr);
+    return static_cast<size_t>(_c);
+}
+
+float WinLevel::get_level_db(const size_t ch) const
+{
+    float _f = 0;
+    HRESULT hr = level->GetLevel(static_cast<UINT>(ch), &_f);
+    if (FAILED(hr)) throw BackendError("Failed to get level of vol", hr);
+    return _f;
+}
+
+void WinLevel::set_level_db(const size_t ch, const float db)
+{
+    HRESULT hr = level->SetLevel(static_cast<UINT>(ch), db, NULL);
+    if (FAILED(hr)) throw BackendError("Failed to set level of vol", hr);
+}
+
+void WinLevel::get_levels_db(float* out, const size_t n) const
+{
+    for (size_t a = 0; a < n; ++a) {
+        HRESULT hr = level->GetLevel(static_cast<UINT>(a), &out[a]);
+        if (FAILED(hr)) throw BackendError("Failed to get level of vol", hr);
+    }
+}
+
+void WinLevel::set_levels_db(const float* in, const size_t n, const uint32_t mask)
+{
+    bool all = true;
+    for (size_t a = 0; a < n && all; ++a) all = channel_in_mask(mask, a);
+
+    if (all) {
+        // one call (and one notification) for the whole vector
+        std::vector<float> tmp(in, in + n);
+        HRESULT hr = level->SetLevelAllChannels(tmp.data(), static_cast<UINT>(n), NULL);
+        if (FAILED(hr)) throw BackendError("Failed to set level of vol", hr);
+        return;
+    }
+
+    for (size_t a = 0; a < n; ++a) if (channel_in_mask(mask, a)) set_level_db(a, in[a]);
+}
+
+WinSwitch::WinSwitch(IAudioMute* m, IAudioAutoGainControl* a, std::string s)
+    : mute(m), agc(a), name(std::move(s))
+{
+    if (!mute && !agc) throw std::invalid_argument("NULL SWITCH");
+}
+
+const std::string& WinSwitch::get_name() const
+{
+    return name;
+}
+
+bool WinSwitch::get() const
+{
+    BOOL b = FALSE;
+    HRESULT hr = mute ? mute->GetMute(&b) : agc->GetEnabled(&b);
+    if (FAILED(hr)) throw BackendError("Failed to get switch", hr);
+    return b != FALSE;
+}
+
+void WinSwitch::set(const bool b)
+{
+    HRESULT hr = mute ? mute->SetMute(b, NULL) : agc->SetEnabled(b, NULL);
+    if (FAILED(hr)) throw BackendError("Failed to set switch", hr);
+}
+
+void WinTopology::_visit(IPart* pPart, const size_t depth)
+{
+    HRESULT hr{};
+    Part p;
+
+    {
+        LPWSTR pwszPartName = NULL;
+        hr = pPart->GetName(&pwszPartName);
+        if (SUCCEEDED(hr)) p.name = _to_utf8(pwszPartName);
+        CoTaskMemFree(pwszPartName);
+    }
+
+    PartType type = Subunit;
+    pPart->GetPartType(&type);
+    p.connector = (type == Connector);
+    p.depth = depth;
+
+    const size_t idx = _add_part(std::move(p));
+    handles.push_back(pPart);
+
+    // the IIDs are enough here, nothing gets activated until someone asks for that control
+    UINT ifaces = 0;
+    if (FAILED(pPart->GetControlInterfaceCount(&ifaces))) return;
+
+    for (UINT i = 0; i < ifaces; ++i) {
+        IControlInterface* pCtl = NULL;
+        if (FAILED(pPart->GetControlInterface(i, &pCtl))) continue;
+
+        IID iid{};
+        if (SUCCEEDED(pCtl->GetIID(&iid))) {
+            if (IsEqualIID(iid, __uuidof(IAudioVolumeLevel))) _add_node(NodeKind::VOLUME, idx);
+            else if (IsEqualIID(iid, __uuidof(IAudioMute))) _add_node(NodeKind::MUTE, idx);
+            else if (IsEqualIID(iid, __uuidof(IAudioAutoGainControl))) _add_node(NodeKind::AGC, idx);
+        }
+        pCtl->Release();
+    }
+}
+
+WinTopology::WinTopology(IDeviceTopology* topo, const AudioFlow flow)
+{
+    HRESULT hr{};
+
+    UINT conns = 0;
+    hr = topo->GetConnectorCount(&conns);
+    if (FAILED(hr)) throw BackendError("Could not get connector count", hr);
+
+    // each entry holds one reference
+    std::deque<std::pair<IPart*, size_t>> todo;
+
+    for (UINT c = 0; c < conns; ++c) {
+        IConnector* pConnEndpoint = NULL;
+        if (FAILED(topo->GetConnector(c, &pConnEndpoint))) continue;
+
+        IConnector* pConnDevice = NULL;
+        hr = pConnEndpoint->GetConnectedTo(&pConnDevice);
+        pConnEndpoint->Release();
+        if (FAILED(hr)) continue;
+
+        IPart* pPart = NULL;
+        hr = pConnDevice->QueryInterface(__uuidof(IPart), (void**)&pPart);
+        pConnDevice->Release();
+        if (SUCCEEDED(hr)) todo.emplace_back(pPart, 0);
+    }
+
+    std::unordered_set<UINT> seen;
+    while (!todo.empty()) {
+        IPart* pPart = todo.front().first;
+        const size_t depth = todo.front().second;
+        todo.pop_front();
+
+        UINT local = 0;
+        if (FAILED(pPart->GetLocalId(&local)) || !seen.insert(local).second) {
+            pPart->Release();
+            continue;
+        }
+
+        _visit(pPart, depth);
+        // a connector past the first hop is the far end of the path
+        if (depth > 0 && get_parts().back().connector) continue;
+
+        IPartsList* pList = NULL;
+        hr = (flow == AudioFlow::REC) ? pPart->EnumPartsOutgoing(&pList) : pPart->EnumPartsIncoming(&pList);
+        if (FAILED(hr)) continue;
+
+        UINT num = 0;
+        pList->GetCount(&num);
+        for (UINT i = 0; i < num; ++i) {
+            IPart* pNext = NULL;
+            if (SUCCEEDED(pList->GetPart(i, &pNext))) todo.emplace_back(pNext, depth + 1);
+        }
+        pList->Release();
+    }
+}
+
+WinTopology::~WinTopology()
+{
+    for (auto& i : handles) i->Release();
+}
+
+IPart* WinTopology::get_part(const size_t node) const
+{
+    return handles[get_nodes()[node].part];
+}
+
+static std::string _process_name(const DWORD pid)
+{
+    if (pid == 0) return {};
+
+    HANDLE proc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!proc) return {};
+
+    wchar_t path[MAX_PATH];
+    DWORD len = MAX_PATH;
+    std::string name;
+    if (QueryFullProcessImageNameW(proc, 0, path, &len)) {
+        name = _to_utf8(path);
+        const size_t slash = name.find_last_of('\\');
+        if (slash != std::string::npos) name.erase(0, slash + 1);
+    }
+    CloseHandle(proc);
+    return name;
+}
+
+WinSession::WinSession(IAudioSessionControl* c)
+{
+    if (!c) throw std::invalid_argument("NULL SESSION");
+
+    HRESULT hr = c->QueryInterface(__uuidof(IAudioSessionControl2), (void**)ctl.put());
+    c->Release();
+    if (FAILED(hr)) {
+        ctl.forget();
+        throw BackendError("Could not query session control", hr);
+    }
+
+    // a throw from here on releases ctl with the member
+    hr = ctl->QueryInterface(__uuidof(ISimpleAudioVolume), (void**)vol.put());
+    if (FAILED(hr)) {
+        vol.forget();
+        throw BackendError("Could not query session volume", hr);
+    }
+
+    LPWSTR str = NULL;
+    if (SUCCEEDED(ctl->GetSessionInstanceIdentifier(&str))) instance_id = _to_utf8(str);
+    CoTaskMemFree(str);
+    str = NULL;
+    if (SUCCEEDED(ctl->GetSessionIdentifier(&str))) session_id = _to_utf8(str);
+    CoTaskMemFree(str);
+
+    // sessions spanning processes report no single PID, leaving it at 0
+    DWORD _p = 0;
+    if (ctl->GetProcessId(&_p) == S_OK) pid = static_cast<uint32_t>(_p);
+    if (ctl->IsSystemSoundsSession() != S_OK) process = _process_name(_p);
+}
+
+const std::string& WinSession::get_instance_id() const
+{
+    return instance_id;
+}
+
+const std::string& WinSession::get_session_id() const
+{
+    return session_id;
+}
+
+uint32_t WinSession::get_pid() const
+{
+    return pid;
+}
+
+const std::string& WinSession::get_process_name() const
+{
+    return process;
+}
+
+void WinSession::set_volume(const float f)
+{
+    HRESULT hr = vol->SetMasterVolume(f, NULL);
+    if (FAILED(hr)) throw BackendError("Failed to set session volume", hr);
+}
+
+float WinSession::get_volume() const
+{
+    float f = 0;
+    HRESULT hr = vol->GetMasterVolume(&f);
+    if (FAILED(hr)) throw BackendError("Failed to get session volume", hr);
+    return f;
+}
+
+void WinSession::set_mute(const bool b)
+{
+    HRESULT hr = vol->SetMute(b, NULL);
+    if (FAILED(hr)) throw BackendError("Failed to set session mute", hr);
+}
+
+bool WinSession::get_mute() const
+{
+    BOOL b = FALSE;
+    HRESULT hr = vol->GetMute(&b);
+    if (FAILED(hr)) throw BackendError("Failed to get session mute", hr);
+    return b != FALSE;
+}
+
+WinSessionEvents::WinSessionEvents(WinSessionWatch* w, std::string s)
+    : owner(w), id(std::move(s))
+{
+    owner->AddRef();
+}
+
+WinSessionEvents::~WinSessionEvents()
+{
+    owner->Release();
+}
+
+HRESULT WinSessionEvents::QueryInterface(REFIID riid, void** ppv)
+{
+    if (IsEqualIID(riid, __uuidof(IUnknown)) || IsEqualIID(riid, __uuidof(IAudioSessionEvents))) {
+        AddRef();
+        *ppv = static_cast<IAudioSessionEvents*>(this);
+        return S_OK;
+    }
+    *ppv = nullptr;
+    return E_NOINTERFACE;
+}
+
+ULONG WinSessionEvents::AddRef()
+{
+    return ++refs;
+}
+
+ULONG WinSessionEvents::Release()
+{
+    const ULONG left = --refs;
+    if (left == 0) delete this;
+    return left;
+}
+
+HRESULT WinSessionEvents::OnStateChanged(AudioSessionState state)
+{
+    if (state == AudioSessionStateExpired) owner->expired(id);
+    return S_OK;
+}
+
+HRESULT WinSessionEvents::OnSessionDisconnected(AudioSessionDisconnectReason)
+{
+    owner->expired(id);
+    return S_OK;
+}
+
+WinSessionWatch::WinSessionWatch(IAudioSessionManager2* m, SessionListener* l)
+    : mgr(m), listener(l)
+{
+    mgr->AddRef();
+}
+
+WinSessionWatch::~WinSessionWatch()
+{
+    mgr->Release();
+}
+
+void WinSessionWatch::_watch(IAudioSessionControl* c, const std::string& id)
+{
+    WinSessionEvents* ev = new WinSessionEvents(this, id);
+    if (FAILED(c->RegisterAudioSessionNotification(ev))) {
+        ev->Release();
+        return;
+    }
+    c->AddRef();
+    std::lock_guard<std::mutex> l(mtx);
+    watched.emplace_back(c, ev);
+}
+
+void WinSessionWatch::start()
+{
+    // the session manager only sends OnSessionCreated once an enumerator was asked for
+    IAudioSessionEnumerator* en = NULL;
+    if (FAILED(mgr->GetSessionEnumerator(&en))) throw std::runtime_error("Could not enumerate sessions");
+
+    int num = 0;
+    en->GetCount(&num);
+    for (int i = 0; i < num; ++i) {
+        IAudioSessionControl* c = NULL;
+        if (FAILED(en->GetSession(i, &c))) continue;
+
+        IAudioSessionControl2* c2 = NULL;
+        if (SUCCEEDED(c->QueryInterface(__uuidof(IAudioSessionControl2), (void**)&c2))) {
+            LPWSTR str = NULL;
+            if (SUCCEEDED(c2->GetSessionInstanceIdentifier(&str))) _watch(c, _to_utf8(str));
+            CoTaskMemFree(str);
+            c2->Release();
+        }
+        c->Release();
+    }
+    en->Release();
+
+    if (FAILED(mgr->RegisterSessionNotification(this))) throw std::runtime_error("RegisterSessionNotification FAILED!");
+}
+
+void WinSessionWatch::stop()
+{
+    mgr->UnregisterSessionNotification(this);
+
+    std::vector<std::pair<IAudioSessionControl*, WinSessionEvents*>> tmp;
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        tmp.swap(watched);
+        listener = nullptr;
+    }
+    // outside the lock: unregistering waits for callbacks in flight, and those take it
+    for (auto& i : tmp) {
+        i.first->UnregisterAudioSessionNotification(i.second);
+        i.first->Release();
+        i.second->Release();
+    }
+}
+
+void WinSessionWatch::expired(const std::string& id)
+{
+    std::lock_guard<std::mutex> l(mtx);
+    if (listener) listener->on_session_expired(id);
+}
+
+HRESULT WinSessionWatch::QueryInterface(REFIID riid, void** ppv)
+{
+    if (IsEqualIID(riid, __uuidof(IUnknown)) || IsEqualIID(riid, __uuidof(IAudioSessionNotification))) {
+        AddRef();
+        *ppv = static_cast<IAudioSessionNotification*>(this);
+        return S_OK;
+    }
+    *ppv = nullptr;
+    return E_NOINTERFACE;
+}
+
+ULONG WinSessionWatch::AddRef()
+{
+    return ++refs;
+}
+
+ULONG WinSessionWatch::Release()
+{
+    const ULONG left = --refs;
+    if (left == 0) delete this;
+    return left;
+}
+
+HRESULT WinSessionWatch::OnSessionCreated(IAudioSessionControl* c)
+{
+    if (!c) return S_OK;
+    try {
+        c->AddRef(); // WinSession takes it over
+        auto s = std::make_shared<WinSession>(c);
+        _watch(c, s->get_instance_id());
+
+        std::lock_guard<std::mutex> l(mtx);
+        if (listener) listener->on_session_added(std::move(s));
+    }
+    catch (...) {
+        // not a session we can control, skip it
+    }
+    return S_OK;
+}
+
+WinVolumeWatch::WinVolumeWatch(IAudioEndpointVolume* v, VolumeListener* l, std::string i)
+    : vol(v), listener(l), id(std::move(i))
+{
+    vol->AddRef();
+}
+
+WinVolumeWatch::~WinVolumeWatch()
+{
+    vol->Release();
+}
+
+void WinVolumeWatch::start()
+{
+    const HRESULT hr = vol->RegisterControlChangeNotify(this);
+    if (FAILED(hr)) throw BackendError("RegisterControlChangeNotify FAILED!", hr);
+}
+
+void WinVolumeWatch::stop()
+{
+    // waits for a callback in flight, which takes the lock: not held here
+    vol->UnregisterControlChangeNotify(this);
+    std::lock_guard<std::mutex> l(mtx);
+    listener = nullptr;
+}
+
+HRESULT WinVolumeWatch::QueryInterface(REFIID riid, void** ppv)
+{
+    if (IsEqualIID(riid, __uuidof(IUnknown)) || IsEqualIID(riid, __uuidof(IAudioEndpointVolumeCallback))) {
+        AddRef();
+        *ppv = static_cast<IAudioEndpointVolumeCallback*>(this);
+        return S_OK;
+    }
+    *ppv = nullptr;
+    return E_NOINTERFACE;
+}
+
+ULONG WinVolumeWatch::AddRef()
+{
+    return ++refs;
+}
+
+ULONG WinVolumeWatch::Release()
+{
+    const ULONG left = --refs;
+    if (left == 0) delete this;
+    return left;
+}
+
+HRESULT WinVolumeWatch::OnNotify(PAUDIO_VOLUME_NOTIFICATION_DATA d)
+{
+    if (!d) return S_OK;
+    std::lock_guard<std::mutex> l(mtx);
+    if (listener) listener->on_volume_changed(id, d->fMasterVolume, d->bMuted != FALSE);
+    return S_OK;
+}
+
+WinEndpoint::WinEndpoint(IMMDevice* dev, std::shared_ptr<TopologyCache> cache)
+    : device(dev), topologies(std::move(cache))
+{
+    if (!dev) throw std::invalid_argument("NULL DEVICE");
+}
+
+IPropertyStore* WinEndpoint::_props() const
+{
+    std::lock_guard<std::mutex> l(lazy_mtx);
+    if (!pProps) {
+        TraceScope t("activate");
+        HRESULT hr = device->OpenPropertyStore(STGM_READ, pProps.put());
+        if (FAILED(hr)) {
+            pProps.forget();
+            throw BackendError("CANNOT LOAD PROPERTIES OF DEVICE!", hr);
+        }
+    }
+    return pProps.get();
+}
+
+IAudioEndpointVolume* WinEndpoint::_vol() const
+{
+    std::lock_guard<std::mutex> l(lazy_mtx);
+    if (!vol) {
+        TraceScope t("activate");
+        HRESULT hr = device->Activate(__uuidof(IAudioEndpointVolume), CLSCTX_INPROC_SERVER, NULL, (LPVOID*)vol.put());
+        if (FAILED(hr)) {
+            vol.forget();
+            throw BackendError("CANNOT LOAD VOLUME PROPERTY OF DEVICE!", hr);
+        }
+    }
+    return vol.get();
+}
+
+IAudioMeterInformation* WinEndpoint::_meter() const
+{
+    std::lock_guard<std::mutex> l(lazy_mtx);
+    if (!meter) {
+        TraceScope t("activate");
+        HRESULT hr = device->Activate(__uuidof(IAudioMeterInformation), CLSCTX_INPROC_SERVER, NULL, (LPVOID*)meter.put());
+        if (FAILED(hr)) {
+            meter.forget();
+            throw BackendError("CANNOT LOAD METER OF DEVICE!", hr);
+        }
+    }
+    return meter.get();
+}
+
+IAudioSessionManager2* WinEndpoint::_smgr() const
+{
+    std::lock_guard<std::mutex> l(lazy_mtx);
+    if (!smgr) {
+        TraceScope t("activate");
+        HRESULT hr = device->Activate(__uuidof(IAudioSessionManager2), CLSCTX_INPROC_SERVER, NULL, (LPVOID*)smgr.put());
+        if (FAILED(hr)) {
+            smgr.forget();
+            throw BackendError("CANNOT LOAD SESSIONS OF DEVICE!", hr);
+        }
+    }
+    return smgr.get();
+}
+
+IDeviceTopology* WinEndpoint::_topo() const
+{
+    std::lock_guard<std::mutex> l(lazy_mtx);
+    if (!topo) {
+        TraceScope t("activate");
+        HRESULT hr = device->Activate(__uuidof(IDeviceTopology), CLSCTX_INPROC_SERVER, NULL, (LPVOID*)topo.put());
+        if (FAILED(hr)) {
+            topo.forget();
+            throw BackendError("CANNOT LOAD TOPOLOGY PROPERTY OF DEVICE!", hr);
+        }
+    }
+    return topo.get();
+}
+
+WinEndpoint::~WinEndpoint()
+{
+    if (watch) { watch->stop(); watch->Release(); }
+    if (vwatch) { vwatch->stop(); vwatch->Release(); }
+}
+
+std::string WinEndpoint::get_id() const
+{
+    LPWSTR pwszID = NULL;
+    HRESULT hr = device->GetId(&pwszID);
+    if (FAILED(hr)) throw BackendError("CANNOT GET DEVICE ID!", hr);
+
+    std::string id = _to_utf8(pwszID);
+    CoTaskMemFree(pwszID);
+    return id;
+}
+
+std::string WinEndpoint::get_friendly_name() const
+{
+    HRESULT hr{};
+    PROPVARIANT varName;
+
+    PropVariantInit(&varName);
+    hr = _props()->GetValue(
+        PKEY_Device_FriendlyName, &varName);
+    if (FAILED(hr) || !varName.pwszVal) {
+        PropVariantClear(&varName);
+        throw std::runtime_error("CANNOT GET DEVICE NAME!");
+    }
+
+    std::string name = _to_utf8(varName.pwszVal);
+
+    PropVariantClear(&varName);
+    return name;
+}
+
+AudioFlow WinEndpoint::get_flow() const
+{
+    IMMEndpoint* endp = nullptr;
+    HRESULT hr = device->QueryInterface(__uuidof(IMMEndpoint), (void**)&endp);
+    if (FAILED(hr)) throw BackendError("CANNOT GET DEVICE FLOW!", hr);
+
+    EDataFlow flow = eRender;
+    hr = endp->GetDataFlow(&flow);
+    endp->Release();
+    if (FAILED(hr)) throw BackendError("CANNOT GET DEVICE FLOW!", hr);
+
+    return flow == eCapture ? AudioFlow::REC : AudioFlow::PLAY;
+}
+
+bool WinEndpoint::is_active() const
+{
+    DWORD state = 0;
+    HRESULT hr = device->GetState(&state);
+    return SUCCEEDED(hr) && state == DEVICE_STATE_ACTIVE;
+}
+
+void WinEndpoint::set_volume(const float f)
+{
+    HRESULT hr = _vol()->SetMasterVolumeLevelScalar(f, NULL);
+    if (FAILED(hr)) throw BackendError("Failed to set volume", hr);
+}
+
+float WinEndpoint::get_volume() const
+{
+    float f = 0.0f;
+    HRESULT hr = _vol()->GetMasterVolumeLevelScalar(&f);
+    if (FAILED(hr)) throw BackendError("Failed to get volume", hr);
+    return f;
+}
+
+void WinEndpoint::set_mute(const bool b)
+{
+    HRESULT hr = _vol()->SetMute(b, NULL);
+    if (FAILED(hr)) throw BackendError("Failed to set mute", hr);
+}
+
+bool WinEndpoint::get_mute() const
+{
+    BOOL b = FALSE;
+    HRESULT hr = _vol()->GetMute(&b);
+    if (FAILED(hr)) throw BackendError("Failed to get mute", hr);
+    return b != FALSE;
+}
+
+size_t WinEndpoint::get_meter_channel_count() const
+{
+    UINT _c = 0;
+    HRESULT hr = _meter()->GetMeteringChannelCount(&_c);
+    if (FAILED(hr)) throw BackendError("Failed to get meter channel count", hr);
+    return static_cast<size_t>(_c);
+}
+
+void WinEndpoint::get_peaks(float* out, const size_t n) const
+{
+    HRESULT hr = _meter()->GetChannelsPeakValues(static_cast<UINT>(n), out);
+    if (FAILED(hr)) throw BackendError("Failed to get peak values", hr);
+}
+
+std::vector<std::shared_ptr<BackendSession>> WinEndpoint::get_sessions()
+{
+    IAudioSessionEnumerator* en = NULL;
+    HRESULT hr = _smgr()->GetSessionEnumerator(&en);
+    if (FAILED(hr)) throw BackendError("Could not enumerate sessions", hr);
+
+    std::vector<std::shared_ptr<BackendSession>> vec;
+    int num = 0;
+    en->GetCount(&num);
+    for (int i = 0; i < num; ++i) {
+        IAudioSessionControl* c = NULL;
+        if (FAILED(en->GetSession(i, &c))) continue;
+
+        AudioSessionState state = AudioSessionStateExpired;
+        if (FAILED(c->GetState(&state)) || state == AudioSessionStateExpired) {
+            c->Release();
+            continue;
+        }
+        try {
+            vec.push_back(std::make_shared<WinSession>(c));
+        }
+        catch (...) {
+        }
+    }
+    en->Release();
+    return vec;
+}
+
+void WinEndpoint::set_session_listener(SessionListener* l)
+{
+    std::lock_guard<std::mutex> lk(watch_mtx);
+    if (watch) {
+        watch->stop();
+        watch->Release();
+        watch = nullptr;
+    }
+    if (!l) return;
+
+    watch = new WinSessionWatch(_smgr(), l);
+    try {
+        watch->start();
+    }
+    catch (...) {
+        watch->stop();
+        watch->Release();
+        watch = nullptr;
+        throw;
+    }
+}
+
+void WinEndpoint::set_volume_listener(VolumeListener* l)
+{
+    std::lock_guard<std::mutex> lk(watch_mtx);
+    if (vwatch) {
+        vwatch->stop();
+        vwatch->Release();
+        vwatch = nullptr;
+    }
+    if (!l) return;
+
+    vwatch = new WinVolumeWatch(_vol(), l, get_id());
+    try {
+        vwatch->start();
+    }
+    catch (...) {
+        vwatch->Release();
+        vwatch = nullptr;
+        throw;
+    }
+}
+
+std::shared_ptr<const TopologyGraph> WinEndpoint::get_topology()
+{
+    const std::string id = get_id();
+
+    auto graph = topologies->get(id);
+    if (!graph) {
+        graph = std::make_shared<WinTopology>(_topo(), get_flow());
+        topologies->put(id, graph);
+    }
+    return graph;
+}
+
+std::unique_ptr<BackendLevel> WinEndpoint::get_underlying_volume(const size_t undr)
+{
+    const auto graph = get_topology();
+    const size_t node = graph->find(NodeKind::VOLUME, undr);
+    if (node == static_cast<size_t>(-1)) throw std::runtime_error("Invalid number or no audio interface here.");
+
+    IAudioVolumeLevel* pVolume = NULL;
+    HRESULT hr = static_cast<const WinTopology&>(*graph).get_part(node)->Activate(CLSCTX_ALL, __uuidof(IAudioVolumeLevel), (void**)&pVolume);
+    if (FAILED(hr)) throw BackendError("Could not get sub device", hr);
+
+    return std::make_unique<WinLevel>(pVolume, graph->get_name(node));
+}
+
+std::unique_ptr<BackendSwitch> WinEndpoint::get_underlying_switch(const NodeKind kind, const size_t undr)
+{
+    if (kind == NodeKind::VOLUME) throw std::invalid_argument("Volume nodes are not switches");
+
+    const auto graph = get_topology();
+    const size_t node = graph->find(kind, undr);
+    if (node == static_cast<size_t>(-1)) throw std::runtime_error("Invalid number or no audio interface here.");
+
+    IPart* pPart = static_cast<const WinTopology&>(*graph).get_part(node);
+    IAudioMute* pMute = NULL;
+    IAudioAutoGainControl* pAgc = NULL;
+    HRESULT hr = (kind == NodeKind::MUTE)
+        ? pPart->Activate(CLSCTX_ALL, __uuidof(IAudioMute), (void**)&pMute)
+        : pPart->Activate(CLSCTX_ALL, __uuidof(IAudioAutoGainControl), (void**)&pAgc);
+    if (FAILED(hr)) throw BackendError("Could not get sub device", hr);
+
+    return std::make_unique<WinSwitch>(pMute, pAgc, graph->get_name(node));
+}
+
+
+WinNotificationClient::WinNotificationClient(BackendListener* l)
+    : listener(l)
+{
+}
+
+HRESULT WinNotificationClient::QueryInterface(REFIID riid, void** ppv)
+{
+    if (IsEqualIID(riid, __uuidof(IUnknown)) || IsEqualIID(riid, __uuidof(IMMNotificationClient))) {
+        AddRef();
+        *ppv = static_cast<IMMNotificationClient*>(this);
+        return S_OK;
+    }
+    *ppv = nullptr;
+    return E_NOINTERFACE;
+}
+
+ULONG WinNotificationClient::AddRef()
+{
+    return ++refs;
+}
+
+ULONG WinNotificationClient::Release()
+{
+    const ULONG left = --refs;
+    if (left == 0) delete this;
+    return left;
+}
+
+HRESULT WinNotificationClient::OnDeviceStateChanged(LPCWSTR id, DWORD)
+{
+    listener->on_device_changed(_to_utf8(id));
+    return S_OK;
+}
+
+HRESULT WinNotificationClient::OnDeviceAdded(LPCWSTR id)
+{
+    listener->on_device_changed(_to_utf8(id));
+    return S_OK;
+}
+
+HRESULT WinNotificationClient::OnDeviceRemoved(LPCWSTR id)
+{
+    listener->on_device_changed(_to_utf8(id));
+    return S_OK;
+}
+
+HRESULT WinNotificationClient::OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR id)
+{
+    if (flow != eRender && flow != eCapture) return S_OK;
+    listener->on_default_changed(flow == eCapture ? AudioFlow::REC : AudioFlow::PLAY, static_cast<AudioType>(role), _to_utf8(id));
+    return S_OK;
+}
+
+HRESULT WinNotificationClient::OnPropertyValueChanged(LPCWSTR id, const PROPERTYKEY key)
+{
+    // only the name matters to us
+    if (IsEqualGUID(key.fmtid, PKEY_Device_FriendlyName.fmtid) && key.pid == PKEY_Device_FriendlyName.pid)
+        listener->on_device_changed(_to_utf8(id));
+    return S_OK;
+}
+
+
+void WinAudioBackend::on_device_changed(const std::string& id)
+{
+    topologies->drop(id);
+
+    std::lock_guard<std::mutex> l(listener_mtx);
+    if (listener) listener->on_device_changed(id);
+}
+
+void WinAudioBackend::on_default_changed(const AudioFlow f, const AudioType t, const std::string& id)
+{
+    std::lock_guard<std::mutex> l(listener_mtx);
+    if (listener) listener->on_default_changed(f, t, id);
+}
+
+void WinAudioBackend::_watch()
+{
+    std::lock_guard<std::mutex> l(notify_mtx);
+    if (notify) return;
+
+    notify = new WinNotificationClient(this);
+    if (FAILED(devenum->RegisterEndpointNotificationCallback(notify))) {
+        notify->Release();
+        notify = nullptr;
+        throw std::runtime_error("RegisterEndpointNotificationCallback FAILED!");
+    }
+}
+
+void WinAudioBackend::_delete_all()
+{
+    if (notify) {
+        if (devenum) devenum->UnregisterEndpointNotificationCallback(notify);
+        notify->Release();
+        notify = nullptr;
+    }
+    __funky_release(devenum);
+    __funky_release(rec);
+    __funky_release(play);
+}
+
+IMMDeviceCollection* WinAudioBackend::_collection(const AudioFlow f) const
+{
+    std::lock_guard<std::mutex> l(collection_mtx);
+    IMMDeviceCollection*& coll = (f == AudioFlow::REC ? rec : play);
+    if (!coll) {
+        TraceScope t("enumerate");
+        HRESULT hr = devenum->EnumAudioEndpoints(f == AudioFlow::REC ? eCapture : eRender, DEVICE_STATE_ACTIVE, &coll);
+        if (FAILED(hr)) {
+            coll = nullptr;
+            throw BackendError(f == AudioFlow::REC ? "EnumAudioEndpoints eCapture FAILED!" : "EnumAudioEndpoints eRender FAILED!", hr);
+        }
+    }
+    return coll;
+}
+
+WinAudioBackend::WinAudioBackend()
+{
+    if (!coinit) {
+        TraceScope t("com init");
+        if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED))) {
+            _delete_all();
+            throw std::runtime_error("COINIT FAILED!");
+        }
+        coinit = true;
+    }
+
+    HRESULT hr;
+    {
+        TraceScope t("enumerator");
+        hr = CoCreateInstance(
+            __uuidof(MMDeviceEnumerator), nullptr,
+            CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
+            (void**)&devenum);
+    }
+
+    if (FAILED(hr)) {
+        _delete_all();
+        throw BackendError("COCREATEINSTANCE FAILED!", hr);
+    }
+
+    // cached graphs are only safe to keep while someone drops them on changes
+    topologies->set_hook([this] { _watch(); });
+}
+
+WinAudioBackend::~WinAudioBackend()
+{
+    topologies->set_hook(nullptr);
+    _delete_all();
+}
+
+size_t WinAudioBackend::get_count(const AudioFlow f) const
+{
+    UINT num{};
+    _collection(f)->GetCount(&num);
+    return static_cast<size_t>(num);
+}
+
+std::unique_ptr<BackendEndpoint> WinAudioBackend::get_endpoint(const AudioFlow f, const size_t p) const
+{
+    IMMDevice* ptr = nullptr;
+    HRESULT hr = _collection(f)->Item(static_cast<UINT>(p), &ptr);
+    if (FAILED(hr) || !ptr) return nullptr;
+    return std::make_unique<WinEndpoint>(ptr, topologies);
+}
+
+std::unique_ptr<BackendEndpoint> WinAudioBackend::get_endpoint(const std::string& id) const
+{
+    IMMDevice* ptr = nullptr;
+    HRESULT hr = devenum->GetDevice(_from_utf8(id).c_str(), &ptr);
+    if (FAILED(hr) || !ptr) return nullptr;
+    return std::make_unique<WinEndpoint>(ptr, topologies);
+}
+
+std::unique_ptr<BackendEndpoint> WinAudioBackend::get_default(const AudioFlow f, const AudioType t) const
+{
+    IMMDevice* ptr = nullptr;
+    HRESULT hr = devenum->GetDefaultAudioEndpoint(f == AudioFlow::REC ? eCapture : eRender, static_cast<ERole>(t), &ptr);
+    if (FAILED(hr) || !ptr) return nullptr;
+    return std::make_unique<WinEndpoint>(ptr, topologies);
+}
+
+void WinAudioBackend::set_listener(BackendListener* l)
+{
+    {
+        std::lock_guard<std::mutex> lk(listener_mtx);
+        listener = l;
+    }
+    // stays registered after that, the cached topologies still need it
+    if (l) _watch();
+}
+
+
+
+#define EXIT_ON_ERROR(hres)  \
+              if (FAILED(hres)) { goto Exit; }
+#define SAFE_RELEASE(punk)  \
+              if ((punk) != NULL)  \
+                { (punk)->Release(); (punk) = NULL; }
+void _test()
+{
+    HRESULT hr = S_OK;
+    IMMDeviceEnumerator* pEnumerator = NULL;
+    IMMDeviceCollection* pCollection = NULL;
+    IMMDevice* pEndpoint = NULL;
+    IPropertyStore* pProps = NULL;
+    LPWSTR pwszID = NULL;
+
+    CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+    hr = CoCreateInstance(
+        __uuidof(MMDeviceEnumerator), NULL,
+        CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
+        (void**)&pEnumerator);
+
+    EXIT_ON_ERROR(hr)
+
+    hr = pEnumerator->EnumAudioEndpoints(
+            eRender, DEVICE_STATE_ACTIVE,
+            &pCollection);
+    EXIT_ON_ERROR(hr)
+
+    UINT  count;
+    hr = pCollection->GetCount(&count);
+    EXIT_ON_ERROR(hr)
+
+        if (count == 0)
+        {
+            printf("No endpoints found.\n");
+        }
+
+    // Each loop prints the name of an endpoint device.
+    for (ULONG i = 0; i < count; i++)
+    {
+        // Get pointer to endpoint number i.
+        hr = pCollection->Item(i, &pEndpoint);
+        EXIT_ON_ERROR(hr)
+
+            // Get the endpoint ID string.
+            hr = pEndpoint->GetId(&pwszID);
+        EXIT_ON_ERROR(hr)
+
+            hr = pEndpoint->OpenPropertyStore(
+                STGM_READ, &pProps);
+        EXIT_ON_ERROR(hr)
+
+            PROPVARIANT varName;
+        // Initialize container for property value.
+        PropVariantInit(&varName);
+
+        // Get the endpoint's friendly-name property.
+        hr = pProps->GetValue(
+            PKEY_Device_FriendlyName, &varName);
+        EXIT_ON_ERROR(hr)
+
+            // Print endpoint friendly name and endpoint ID.
+            printf("Endpoint %d: \"%S\" (%S)\n",
+                i, varName.pwszVal, pwszID);
+
+        CoTaskMemFree(pwszID);
+        pwszID = NULL;
+        PropVariantClear(&varName);
+        SAFE_RELEASE(pProps)
+            SAFE_RELEASE(pEndpoint)
+    }
+    SAFE_RELEASE(pEnumerator)
+        SAFE_RELEASE(pCollection)
+        return;
+Exit:
+    printf("Error!\n");
+    CoTaskMemFree(pwszID);
+    SAFE_RELEASE(pEnumerator)
+        SAFE_RELEASE(pCollection)
+        SAFE_RELEASE(pEndpoint)
+        SAFE_RELEASE(pProps)
+}
+
+#endif
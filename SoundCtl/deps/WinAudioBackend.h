@@ -0,0 +1,286 @@
+#pragma once
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <mmdeviceapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <functiondiscoverykeys_devpkey.h>
+#include <endpointvolume.h>
+#include <audiopolicy.h>
+#include <stdexcept>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "AudioBackend.h"
+
+// Owns one reference to a COM interface: copies AddRef, moves take the reference over, the last one releases it
+template<typename T> class ComRef {
+	T* p = nullptr;
+public:
+	ComRef() = default;
+	// takes over the reference held by the pointer (no AddRef)
+	explicit ComRef(T* t) : p(t) {}
+	ComRef(const ComRef& o) : p(o.p) { if (p) p->AddRef(); }
+	ComRef(ComRef&& o) noexcept : p(o.p) { o.p = nullptr; }
+	ComRef& operator=(ComRef o) noexcept { std::swap(p, o.p); return *this; }
+	~ComRef() { reset(); }
+
+	T* get() const { return p; }
+	T* operator->() const { return p; }
+	explicit operator bool() const { return p != nullptr; }
+
+	// For out parameters: releases what it holds first
+	T** put() { reset(); return &p; }
+	void reset() { if (p) { p->Release(); p = nullptr; } }
+	// After a failed call, whatever it wrote there is not a reference
+	void forget() { p = nullptr; }
+};
+
+class WinLevel : public BackendLevel {
+	ComRef<IAudioVolumeLevel> level;
+	std::string name;
+public:
+	// takes over the reference (no AddRef)
+	WinLevel(IAudioVolumeLevel*, std::string);
+	WinLevel(const WinLevel&) = delete;
+	void operator=(const WinLevel&) = delete;
+
+	const std::string& get_name() const override;
+	size_t get_channel_count() const override;
+	float get_level_db(const size_t) const override;
+	void set_level_db(const size_t, const float) override;
+	void get_levels_db(float*, const size_t) const override;
+	void set_levels_db(const float*, const size_t, const uint32_t) override;
+};
+
+// Owns one reference to either control
+class WinSwitch : public BackendSwitch {
+	ComRef<IAudioMute> mute;
+	ComRef<IAudioAutoGainControl> agc;
+	std::string name;
+public:
+	WinSwitch(IAudioMute*, IAudioAutoGainControl*, std::string);
+	WinSwitch(const WinSwitch&) = delete;
+	void operator=(const WinSwitch&) = delete;
+
+	const std::string& get_name() const override;
+	bool get() const override;
+	void set(const bool) override;
+};
+
+// Walks from every endpoint connector into the device topology (upstream for outputs, downstream for inputs)
+// until the connectors on the other side. Keeps a reference to each part so a control is one Activate away.
+class WinTopology : public TopologyGraph {
+	std::vector<IPart*> handles; // by part
+
+	void _visit(IPart*, const size_t);
+public:
+	WinTopology(IDeviceTopology*, const AudioFlow);
+	WinTopology(const WinTopology&) = delete;
+	void operator=(const WinTopology&) = delete;
+	~WinTopology();
+
+	IPart* get_part(const size_t) const;
+};
+
+class WinSession : public BackendSession {
+	ComRef<IAudioSessionControl2> ctl;
+	ComRef<ISimpleAudioVolume> vol;
+	std::string instance_id, session_id, process;
+	uint32_t pid = 0;
+public:
+	// takes over the reference (no AddRef)
+	WinSession(IAudioSessionControl*);
+	WinSession(const WinSession&) = delete;
+	void operator=(const WinSession&) = delete;
+
+	const std::string& get_instance_id() const override;
+	const std::string& get_session_id() const override;
+	uint32_t get_pid() const override;
+	const std::string& get_process_name() const override;
+	void set_volume(const float) override;
+	float get_volume() const override;
+	void set_mute(const bool) override;
+	bool get_mute() const override;
+};
+
+class WinSessionWatch;
+
+// Registered on one session, tells the watch when it expires. Holds a reference to the watch.
+class WinSessionEvents : public IAudioSessionEvents {
+	std::atomic<ULONG> refs{ 1 };
+	WinSessionWatch* const owner;
+	const std::string id;
+public:
+	WinSessionEvents(WinSessionWatch*, std::string);
+	virtual ~WinSessionEvents();
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void**) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	HRESULT STDMETHODCALLTYPE OnDisplayNameChanged(LPCWSTR, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnIconPathChanged(LPCWSTR, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnSimpleVolumeChanged(float, BOOL, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnChannelVolumeChanged(DWORD, float*, DWORD, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnGroupingParamChanged(LPCGUID, LPCGUID) override { return S_OK; }
+	HRESULT STDMETHODCALLTYPE OnStateChanged(AudioSessionState) override;
+	HRESULT STDMETHODCALLTYPE OnSessionDisconnected(AudioSessionDisconnectReason) override;
+};
+
+// Session notifications of one endpoint, forwarded to a SessionListener until stop()
+class WinSessionWatch : public IAudioSessionNotification {
+	std::atomic<ULONG> refs{ 1 };
+	IAudioSessionManager2* const mgr;
+	SessionListener* listener;
+	std::vector<std::pair<IAudioSessionControl*, WinSessionEvents*>> watched;
+	std::mutex mtx;
+
+	void _watch(IAudioSessionControl*, const std::string&);
+public:
+	WinSessionWatch(IAudioSessionManager2*, SessionListener*);
+	virtual ~WinSessionWatch();
+
+	// watches the expiry of the sessions alive now, then registers for new ones
+	void start();
+	// nothing reaches the listener once this returns
+	void stop();
+	void expired(const std::string&);
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void**) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	HRESULT STDMETHODCALLTYPE OnSessionCreated(IAudioSessionControl*) override;
+};
+
+// Endpoint volume notifications, forwarded to a VolumeListener until stop()
+class WinVolumeWatch : public IAudioEndpointVolumeCallback {
+	std::atomic<ULONG> refs{ 1 };
+	IAudioEndpointVolume* const vol;
+	VolumeListener* listener;
+	const std::string id;
+	std::mutex mtx;
+public:
+	WinVolumeWatch(IAudioEndpointVolume*, VolumeListener*, std::string);
+	virtual ~WinVolumeWatch();
+
+	void start();
+	// nothing reaches the listener once this returns
+	void stop();
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void**) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	HRESULT STDMETHODCALLTYPE OnNotify(PAUDIO_VOLUME_NOTIFICATION_DATA) override;
+};
+
+// Owns one reference to the IMMDevice. Everything else is activated on first use and kept after that.
+class WinEndpoint : public BackendEndpoint {
+	ComRef<IMMDevice> device;
+	mutable ComRef<IPropertyStore> pProps;
+	mutable ComRef<IAudioEndpointVolume> vol;
+	mutable ComRef<IAudioMeterInformation> meter;
+	mutable ComRef<IAudioSessionManager2> smgr;
+	mutable ComRef<IDeviceTopology> topo;
+	mutable std::mutex lazy_mtx; // the five above are activated on first use, from any thread
+	// stopped before anything above is released (their callbacks may still be running until then)
+	WinSessionWatch* watch = nullptr;
+	WinVolumeWatch* vwatch = nullptr;
+	std::mutex watch_mtx; // guards the two above
+	const std::shared_ptr<TopologyCache> topologies;
+
+	IPropertyStore* _props() const;
+	IAudioEndpointVolume* _vol() const;
+	IAudioMeterInformation* _meter() const;
+	IAudioSessionManager2* _smgr() const;
+	IDeviceTopology* _topo() const;
+public:
+	// takes over the reference held by the pointer (no AddRef)
+	WinEndpoint(IMMDevice*, std::shared_ptr<TopologyCache>);
+	WinEndpoint(const WinEndpoint&) = delete;
+	void operator=(const WinEndpoint&) = delete;
+	~WinEndpoint();
+
+	std::string get_id() const override;
+	std::string get_friendly_name() const override;
+	AudioFlow get_flow() const override;
+	bool is_active() const override;
+	void set_volume(const float) override;
+	float get_volume() const override;
+	void set_mute(const bool) override;
+	bool get_mute() const override;
+	size_t get_meter_channel_count() const override;
+	void get_peaks(float*, const size_t) const override;
+
+	std::vector<std::shared_ptr<BackendSession>> get_sessions() override;
+	void set_session_listener(SessionListener*) override;
+	void set_volume_listener(VolumeListener*) override;
+
+	std::shared_ptr<const TopologyGraph> get_topology() override;
+	std::unique_ptr<BackendLevel> get_underlying_volume(const size_t) override;
+	std::unique_ptr<BackendSwitch> get_underlying_switch(const NodeKind, const size_t) override;
+};
+
+// Forwards IMMNotificationClient calls to a BackendListener
+class WinNotificationClient : public IMMNotificationClient {
+	std::atomic<ULONG> refs{ 1 };
+	BackendListener* const listener;
+public:
+	WinNotificationClient(BackendListener*);
+	virtual ~WinNotificationClient() = default;
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void**) override;
+	ULONG STDMETHODCALLTYPE AddRef() override;
+	ULONG STDMETHODCALLTYPE Release() override;
+
+	HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR, DWORD) override;
+	HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR) override;
+	HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR) override;
+	HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow, ERole, LPCWSTR) override;
+	HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override;
+};
+
+// Registers for notifications once something needs them (a listener or a cached topology) and forwards them.
+// Each flow is enumerated the first time it is needed: a default device lookup enumerates nothing.
+class WinAudioBackend : public AudioBackend, private BackendListener {
+	IMMDeviceEnumerator *devenum = nullptr;
+	mutable IMMDeviceCollection *rec = nullptr, *play = nullptr; // enumerated on first use, per flow
+	WinNotificationClient* notify = nullptr;
+	BackendListener* listener = nullptr;
+	const std::shared_ptr<TopologyCache> topologies = std::make_shared<TopologyCache>();
+	std::mutex notify_mtx, listener_mtx;
+	mutable std::mutex collection_mtx;
+	static bool coinit;
+
+	template<typename T> inline void __funky_release(T*& dev) { if ((dev) != nullptr) { dev->Release(); dev = nullptr; } }
+
+	void on_device_changed(const std::string&) override;
+	void on_default_changed(const AudioFlow, const AudioType, const std::string&) override;
+
+	void _delete_all();
+	void _watch();
+	IMMDeviceCollection* _collection(const AudioFlow) const;
+public:
+	WinAudioBackend();
+	WinAudioBackend(const WinAudioBackend&) = delete;
+	void operator=(const WinAudioBackend&) = delete;
+	~WinAudioBackend();
+
+	size_t get_count(const AudioFlow) const override;
+	std::unique_ptr<BackendEndpoint> get_endpoint(const AudioFlow, const size_t) const override;
+	std::unique_ptr<BackendEndpoint> get_endpoint(const std::string&) const override;
+	std::unique_ptr<BackendEndpoint> get_default(const AudioFlow, const AudioType) const override;
+
+	void set_listener(BackendListener*) override;
+};
+
+void _test();
+
+#endif
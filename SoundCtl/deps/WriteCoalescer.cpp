@@ -0,0 +1,179 @@
+#include "WriteCoalescer.h"
+
+#include <algorithm>
+
+// idle this long, the tracked value may be stale (another application moved the slider): read it again
+static const std::chrono::seconds resync_after(1);
+
+WriteCoalescer::WriteCoalescer(const std::chrono::microseconds i)
+    : interval(i)
+{
+    if (interval.count() < 0) throw std::invalid_argument("Invalid write interval");
+    worker = std::thread(&WriteCoalescer::_work, this);
+}
+
+WriteCoalescer::~WriteCoalescer()
+{
+    {
+        std::lock_guard<std::mutex> l(mtx);
+        stop = true;
+    }
+    cond.notify_all();
+    worker.join();
+    // no lanes are added once the scheduler is gone
+    for (auto& i : lanes) {
+        i.second->cond.notify_all();
+        i.second->thread.join();
+    }
+}
+
+WriteCoalescer::Entry& WriteCoalescer::_entry(std::unique_lock<std::mutex>& l, const std::string& id, std::shared_ptr<Device> dev)
+{
+    if (!dev) throw std::invalid_argument("NULL DEVICE");
+    const auto now = std::chrono::steady_clock::now();
+    const auto stale = [this, &id, now] {
+        const auto it = entries.find(id);
+        return it == entries.end() || (!it->second.dirty && !it->second.writing && now - it->second.last_request > resync_after);
+    };
+
+    l.lock();
+    if (stale()) {
+        l.unlock();
+        const float v = dev->get_volume();
+        l.lock();
+        // another request may have read it (and moved it) meanwhile, that one is newer
+        if (stale()) {
+            const auto it = entries.find(id);
+            const auto last = (it == entries.end() ? std::chrono::steady_clock::time_point{} : it->second.last_write);
+            entries.insert_or_assign(id, Entry{ nullptr, v, v, false, false, last, now });
+        }
+    }
+
+    const auto it = entries.find(id);
+
+    // the caller may hold a newer handle (the endpoint was opened again)
+    it->second.dev = std::move(dev);
+    it->second.last_request = now;
+    ++stats.requests;
+    return it->second;
+}
+
+float WriteCoalescer::adjust(const std::string& id, std::shared_ptr<Device> dev, const float delta)
+{
+    float v;
+    {
+        std::unique_lock<std::mutex> l(mtx, std::defer_lock);
+        Entry& e = _entry(l, id, std::move(dev));
+        e.value = std::min(1.0f, std::max(0.0f, e.value + delta));
+        e.dirty = true;
+        v = e.value;
+    }
+    cond.notify_all();
+    return v;
+}
+
+float WriteCoalescer::set(const std::string& id, std::shared_ptr<Device> dev, const float value)
+{
+    if (value < 0.0f || value > 1.0f) throw std::invalid_argument("Invalid volume");
+    {
+        std::unique_lock<std::mutex> l(mtx, std::defer_lock);
+        Entry& e = _entry(l, id, std::move(dev));
+        e.value = value;
+        e.dirty = true;
+    }
+    cond.notify_all();
+    return value;
+}
+
+void WriteCoalescer::flush() const
+{
+    std::unique_lock<std::mutex> l(mtx);
+    idle.wait(l, [this] {
+        return std::none_of(entries.begin(), entries.end(), [](const std::pair<const std::string, Entry>& i) { return i.second.dirty || i.second.writing; });
+    });
+}
+
+WriteCoalescer::Stats WriteCoalescer::get_stats() const
+{
+    std::lock_guard<std::mutex> l(mtx);
+    return stats;
+}
+
+void WriteCoalescer::_work()
+{
+    using clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> l(mtx);
+
+    while (!stop) {
+        const auto now = clock::now();
+        clock::time_point next = clock::time_point::max();
+        bool pending = false;
+
+        for (auto& i : entries) {
+            Entry& e = i.second;
+            if (!e.dirty || e.writing) continue; // a write still out is recorded first
+
+            // leading edge goes out at once, the rest of the burst waits for the interval
+            const auto due = e.last_write + interval;
+            if (due > now) {
+                next = std::min(next, due);
+                pending = true;
+                continue;
+            }
+
+            e.dirty = false;
+            if (e.value == e.written) {
+                ++stats.noops;
+                continue;
+            }
+            e.writing = true;
+            e.last_write = now;
+
+            auto& lane = lanes[i.first];
+            if (!lane) {
+                lane = std::make_unique<Lane>();
+                lane->thread = std::thread(&WriteCoalescer::_write, this, std::ref(*lane));
+            }
+            lane->job = Write{ i.first, e.dev, e.value };
+            lane->busy = true;
+            lane->cond.notify_one();
+        }
+
+        // a lane that finishes wakes this up again
+        if (!pending) idle.notify_all();
+        if (next == clock::time_point::max()) cond.wait(l);
+        else cond.wait_until(l, next);
+    }
+}
+
+void WriteCoalescer::_write(Lane& lane)
+{
+    std::unique_lock<std::mutex> l(mtx);
+
+    while (true) {
+        lane.cond.wait(l, [this, &lane] { return stop || lane.busy; });
+        if (!lane.busy) return;
+
+        const Write w = std::move(lane.job);
+        bool ok = false;
+        l.unlock();
+        try {
+            w.dev->set_volume(w.value);
+            ok = true;
+        }
+        catch (...) {
+        }
+        l.lock();
+
+        ++(ok ? stats.writes : stats.errors);
+        const auto it = entries.find(w.id);
+        if (it != entries.end()) {
+            Entry& e = it->second;
+            e.writing = false;
+            if (ok) e.written = w.value;
+            else if (!e.dirty) entries.erase(it); // read again on the next request
+        }
+        lane.busy = false;
+        cond.notify_all(); // changed meanwhile: due an interval after this write
+    }
+}
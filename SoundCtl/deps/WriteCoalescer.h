@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceManager.h"
+
+// Merges bursts of volume changes per endpoint (a held volume key) into absolute writes, at most one per endpoint
+// per interval. Changes are applied to the tracked value under one lock, so concurrent adjustments are never lost;
+// the write itself is skipped when the value did not move.
+// A scheduler thread decides what is due; each endpoint has a writer thread of its own that makes the call.
+// Device calls (the writes, and the reads that resync a value) are made without the lock: an endpoint that takes
+// hundreds of milliseconds per call only holds up its own changes.
+class WriteCoalescer {
+public:
+	struct Stats {
+		uint64_t requests = 0; // adjust and set calls
+		uint64_t writes = 0;   // volume writes issued
+		uint64_t noops = 0;    // flushes skipped because the value ended where it was
+		uint64_t errors = 0;   // writes that failed, the endpoint is read again next time
+	};
+private:
+	struct Entry {
+		std::shared_ptr<Device> dev;
+		float value;     // where the endpoint goes next
+		float written;   // what it holds now, as far as we know
+		bool dirty;
+		bool writing;    // a write is out, without the lock
+		std::chrono::steady_clock::time_point last_write, last_request;
+	};
+	struct Write {
+		std::string id;
+		std::shared_ptr<Device> dev;
+		float value;
+	};
+	struct Lane {
+		std::condition_variable cond;
+		bool busy = false; // job is out
+		Write job;
+		std::thread thread;
+	};
+
+	const std::chrono::microseconds interval;
+	std::unordered_map<std::string, Entry> entries; // by endpoint ID
+	std::unordered_map<std::string, std::unique_ptr<Lane>> lanes; // by endpoint ID, created by the scheduler, kept until the end
+	Stats stats;
+	mutable std::mutex mtx;
+	std::condition_variable cond;
+	mutable std::condition_variable idle;
+	bool stop = false;
+	std::thread worker; // the scheduler
+
+	// Locks l, reading the volume first (unlocked) if the tracked value may be stale
+	Entry& _entry(std::unique_lock<std::mutex>&, const std::string&, std::shared_ptr<Device>);
+	void _work();
+	void _write(Lane&);
+public:
+	// interval = 1 / maximum writes per second per endpoint
+	WriteCoalescer(const std::chrono::microseconds = std::chrono::milliseconds(20));
+	WriteCoalescer(const WriteCoalescer&) = delete;
+	void operator=(const WriteCoalescer&) = delete;
+	~WriteCoalescer();
+
+	// Relative change, clamped to [0.0..1.0]. Returns the volume the endpoint will end at.
+	float adjust(const std::string&, std::shared_ptr<Device>, const float);
+	// Absolute value, merged with the adjustments around it
+	float set(const std::string&, std::shared_ptr<Device>, const float);
+
+	// blocks until every pending value is written
+	void flush() const;
+	Stats get_stats() const;
+};
@@ -0,0 +1,88 @@
+#!/bin/sh
+# Smoke test of the PulseAudio backend against a private server with two null sinks, through the machine mode of the
+# command line (list, get, set and profiles all go through DeviceList). Needs pulseaudio and pactl.
+# Usage: pulse_smoke.sh <path to soundctl>
+set -eu
+
+bin=$1
+dir=$(mktemp -d)
+mkdir -p "$dir/pulse"
+# nothing of the user's session is touched: own runtime dir, own server, own name cache
+export XDG_RUNTIME_DIR="$dir" PULSE_RUNTIME_PATH="$dir/pulse" PULSE_SERVER="unix:$dir/pulse/native" HOME="$dir"
+
+pulseaudio -n --daemonize=no --exit-idle-time=-1 --use-pid-file=no \
+    -L "module-native-protocol-unix socket=$dir/pulse/native" >"$dir/server.log" 2>&1 &
+pid=$!
+trap 'kill $pid 2>/dev/null || true; wait $pid 2>/dev/null || true; rm -rf "$dir"' EXIT
+
+fail() {
+    echo "FAILED: $*" >&2
+    cat "$dir/server.log" >&2
+    exit 1
+}
+
+tries=0
+until pactl info >/dev/null 2>&1; do
+    tries=$((tries + 1))
+    [ $tries -lt 50 ] || fail "the server did not start"
+    sleep 0.1
+done
+
+pactl load-module module-null-sink sink_name=smoke_a sink_properties=device.description=SmokeA >/dev/null
+pactl load-module module-null-sink sink_name=smoke_b sink_properties=device.description=SmokeB >/dev/null
+pactl set-default-sink smoke_a
+
+# <IN|OUT> <default> <volume> <mute> <levels> <id> <name>, tab separated
+field() {
+    printf '%s\n' "$1" | cut -f "$2"
+}
+
+# list: both sinks, the default one flagged
+out=$("$bin" -out line list) || fail "list"
+printf '%s\n' "$out" | grep -q "^OUT	1	.*	SmokeA$" || fail "list: SmokeA not the default: $out"
+printf '%s\n' "$out" | grep -q "^OUT	0	.*	SmokeB$" || fail "list: no SmokeB: $out"
+
+# set then get, checked against the server too
+"$bin" -out line set OUT SmokeB s 0.25 >/dev/null || fail "set volume"
+line=$("$bin" -out line get OUT SmokeB) || fail "get"
+[ "$(field "$line" 3)" = "0.2500" ] || fail "get volume: $line"
+[ "$(field "$line" 6)" = "{sink}smoke_b" ] || fail "get id: $line"
+pactl get-sink-volume smoke_b | grep -q " 25% " || fail "server volume: $(pactl get-sink-volume smoke_b)"
+
+# by ID, the default, mute and toggle
+"$bin" -out line set OUT "{sink}smoke_b" M >/dev/null || fail "mute by ID"
+pactl get-sink-mute smoke_b | grep -q "yes" || fail "server mute"
+"$bin" -out line set OUT "*" s 0.5 >/dev/null || fail "set default"
+pactl get-sink-volume smoke_a | grep -q " 50% " || fail "default volume: $(pactl get-sink-volume smoke_a)"
+"$bin" -out line set OUT SmokeB T >/dev/null || fail "toggle"
+line=$("$bin" -out line get OUT SmokeB) || fail "get after toggle"
+[ "$(field "$line" 4)" = "0" ] || fail "toggle: $line"
+
+# channel levels: get reports 10^(dB/20), dB as the server converts it (cubic, not 20*log10 of the volume)
+pactl set-sink-volume smoke_b 30% 70%
+line=$("$bin" -out line get OUT SmokeB) || fail "get levels"
+server=$(pactl get-sink-volume smoke_b | grep -o -- '-\?[0-9.]* dB' | cut -d' ' -f1 | paste -sd, -)
+awk -v lv="$(field "$line" 5)" -v db="$server" 'BEGIN {
+    n = split(lv, a, ","); m = split(db, b, ",")
+    if (n != 2 || m != 2) exit 1
+    for (c = 1; c <= n; ++c) {
+        d = 20 * log(a[c]) / log(10)
+        if (d - b[c] > 0.1 || b[c] - d > 0.1) exit 1
+    }
+}' || fail "levels: $line, server: $server"
+
+# and back in through a profile, per channel
+"$bin" -out line -save "$dir/smoke.prof" >/dev/null || fail "save profile"
+pactl set-sink-volume smoke_b 100%
+"$bin" -out line -load "$dir/smoke.prof" >/dev/null || fail "load profile"
+vol=$(pactl get-sink-volume smoke_b)
+printf '%s\n' "$vol" | grep -q " 30% .* 70% " || fail "levels from profile: $vol"
+
+# a missing device is exit code 3
+set +e
+"$bin" -out line get OUT NoSuchSink >/dev/null
+code=$?
+set -e
+[ $code -eq 3 ] || fail "missing device: exit code $code"
+
+echo "pulse smoke test passed"
@@ -0,0 +1,347 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+#include <string.h>
+#include <math.h>
+
+#include "../SoundCtl/deps/DeviceManager.h"
+#include "../SoundCtl/deps/DeviceTable.h"
+#include "../SoundCtl/deps/SimAudioBackend.h"
+#include "../SoundCtl/deps/LevelMath.h"
+#include "../SoundCtl/deps/NameIndex.h"
+
+#undef max
+#undef min
+
+// Device layer benchmarks against the simulated backend, so they run anywhere and the numbers only move when the
+// code does. Results are tab separated, one line per scenario and endpoint count:
+//   <scenario> <endpoints> <ns per op> <ops measured>
+// lines starting with # are comments. -save writes them to a file, -compare reads such a file back and flags
+// every scenario that got slower than the threshold.
+
+const int results_version = 1;
+
+struct Result {
+	std::string scenario;
+	size_t endpoints;
+	double ns;
+	size_t ops;
+};
+
+struct Options {
+	SimConfig sim;
+	std::vector<size_t> sizes = { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512 };
+	std::vector<std::string> only;
+	std::chrono::milliseconds budget{ 20 }; // per measurement, 5 measurements per result
+	std::string save, compare;
+	double threshold = 0.10;
+};
+
+// One scenario: prepared once per endpoint count, then run(i) is one operation (i counts up from 0)
+struct Scenario {
+	const char* name;
+	const char* what;
+	std::function<std::function<void(size_t)>(const std::shared_ptr<SimWorld>&, const std::vector<std::shared_ptr<Device>>&)> prepare;
+};
+
+static std::vector<size_t> _parse_sizes(const std::string& s)
+{
+	std::vector<size_t> out;
+	std::stringstream ss(s);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		const size_t n = std::stoul(item);
+		if (n == 0) throw std::invalid_argument("Invalid endpoint count: " + item);
+		out.push_back(n);
+	}
+	if (out.empty()) throw std::invalid_argument("No endpoint count");
+	return out;
+}
+
+// median of 5 runs of ns per op; the op count of a run is calibrated so a run takes about the budget
+static Result _measure(const std::function<void(size_t)>& op, const std::chrono::milliseconds budget)
+{
+	using clock = std::chrono::steady_clock;
+	size_t i = 0, n = 1;
+
+	for (;;) {
+		const auto t0 = clock::now();
+		for (size_t a = 0; a < n; ++a) op(i++);
+		const auto took = clock::now() - t0;
+		if (took >= budget / 4 || n >= (size_t(1) << 30)) {
+			const double per = std::chrono::duration<double>(took).count() / n;
+			n = std::max<size_t>(1, static_cast<size_t>(std::chrono::duration<double>(budget).count() / std::max(per, 1e-9)));
+			break;
+		}
+		n *= 4;
+	}
+
+	std::vector<double> runs;
+	for (size_t r = 0; r < 5; ++r) {
+		const auto t0 = clock::now();
+		for (size_t a = 0; a < n; ++a) op(i++);
+		runs.push_back(std::chrono::duration<double, std::nano>(clock::now() - t0).count() / n);
+	}
+	std::sort(runs.begin(), runs.end());
+	return Result{ "", 0, runs[runs.size() / 2], n * runs.size() };
+}
+
+static const std::vector<Scenario>& _scenarios()
+{
+	using Devices = std::vector<std::shared_ptr<Device>>;
+	using World = std::shared_ptr<SimWorld>;
+
+	static const std::vector<Scenario> all = {
+		{ "enumerate", "DeviceList::open_all over every playback endpoint (per call)",
+			[](const World& w, const Devices&) {
+				auto devl = std::make_shared<DeviceList>(std::make_shared<SimAudioBackend>(w));
+				devl->set_workers(1);
+				return std::function<void(size_t)>([devl](size_t) { devl->open_all(AudioFlow::PLAY); });
+			} },
+		{ "resolve_name", "friendly name -> Device, no name cache (every name is read)",
+			[](const World& w, const Devices&) {
+				auto devl = std::make_shared<DeviceList>(std::make_shared<SimAudioBackend>(w));
+				const size_t n = devl->get_num_play();
+				return std::function<void(size_t)>([devl, n](size_t i) { devl->get_play("Speakers " + std::to_string(i % n)); });
+			} },
+		{ "resolve_index", "friendly name -> Device through a warm name cache",
+			[](const World& w, const Devices&) {
+				const std::string cache = (std::filesystem::temp_directory_path() / "soundctl-bench.names").string();
+				std::filesystem::remove(cache);
+				auto devl = std::make_shared<DeviceList>(std::make_shared<SimAudioBackend>(w));
+				devl->set_name_cache(cache);
+				const size_t n = devl->get_num_play();
+				devl->get_play("Speakers 0"); // builds and saves the index
+				return std::function<void(size_t)>([devl, n](size_t i) { devl->get_play("Speakers " + std::to_string(i % n)); });
+			} },
+		{ "resolve_id", "endpoint ID -> Device",
+			[](const World& w, const Devices& devs) {
+				auto devl = std::make_shared<DeviceList>(std::make_shared<SimAudioBackend>(w));
+				auto ids = std::make_shared<std::vector<EndpointId>>();
+				for (const auto& d : devs) ids->push_back(EndpointId{ d->get_id() });
+				return std::function<void(size_t)>([devl, ids](size_t i) { devl->get_play((*ids)[i % ids->size()]); });
+			} },
+		{ "construct", "Device from a backend endpoint, by position (no lookup)",
+			[](const World& w, const Devices& devs) {
+				auto devl = std::make_shared<DeviceList>(std::make_shared<SimAudioBackend>(w));
+				const size_t n = devs.size();
+				return std::function<void(size_t)>([devl, n](size_t i) { devl->get_play(i % n); });
+			} },
+		{ "get_volume", "Device::get_volume, round robin over the endpoints",
+			[](const World&, const Devices& devs) {
+				return std::function<void(size_t)>([devs](size_t i) { devs[i % devs.size()]->get_volume(); });
+			} },
+		{ "set_volume", "Device::set_volume, round robin over the endpoints",
+			[](const World&, const Devices& devs) {
+				return std::function<void(size_t)>([devs](size_t i) { devs[i % devs.size()]->set_volume((i & 1) ? 0.25f : 0.75f); });
+			} },
+		{ "get_mute", "Device::get_mute, round robin over the endpoints",
+			[](const World&, const Devices& devs) {
+				return std::function<void(size_t)>([devs](size_t i) { devs[i % devs.size()]->get_mute(); });
+			} },
+		{ "set_mute", "Device::set_mute, round robin over the endpoints",
+			[](const World&, const Devices& devs) {
+				return std::function<void(size_t)>([devs](size_t i) { devs[i % devs.size()]->set_mute((i & 1) != 0); });
+			} },
+		{ "get_levels", "VolumeDevice::get_levels, dB from the backend to scalars (per channel vector)",
+			[](const World&, const Devices& devs) {
+				auto vols = std::make_shared<std::vector<VolumeDevice>>();
+				for (const auto& d : devs) vols->push_back(d->get_underlying_volume());
+				return std::function<void(size_t)>([vols](size_t i) { (*vols)[i % vols->size()].get_levels(); });
+			} },
+		{ "set_levels", "VolumeDevice::set_levels, scalars to dB for the backend (per channel vector)",
+			[](const World&, const Devices& devs) {
+				auto vols = std::make_shared<std::vector<VolumeDevice>>();
+				for (const auto& d : devs) vols->push_back(d->get_underlying_volume());
+				const std::vector<float> levels[2] = {
+					std::vector<float>((*vols)[0].get_channel_count(), 0.5f),
+					std::vector<float>((*vols)[0].get_channel_count(), 0.8f) };
+				return std::function<void(size_t)>([vols, levels](size_t i) { (*vols)[i % vols->size()].set_levels(levels[i & 1]); });
+			} },
+		{ "topology", "Device::get_topology plus the first volume control, graphs already cached",
+			[](const World&, const Devices& devs) {
+				for (const auto& d : devs) d->get_topology();
+				return std::function<void(size_t)>([devs](size_t i) { devs[i % devs.size()]->get_underlying_volume(); });
+			} },
+		{ "table_refresh", "DeviceTable::refresh, volume and mute of every endpoint (per call)",
+			[](const World& w, const Devices&) {
+				auto tab = std::make_shared<DeviceTable>();
+				tab->load(DeviceList(std::make_shared<SimAudioBackend>(w)), AudioFlow::PLAY);
+				return std::function<void(size_t)>([tab](size_t) { tab->refresh(); });
+			} },
+		{ "table_find", "DeviceTable::find, endpoint ID -> position",
+			[](const World& w, const Devices&) {
+				auto tab = std::make_shared<DeviceTable>();
+				tab->load(DeviceList(std::make_shared<SimAudioBackend>(w)), AudioFlow::PLAY);
+				return std::function<void(size_t)>([tab](size_t i) { tab->find(tab->get_id(i % tab->size())); });
+			} },
+		{ "table_scan", "loudest unmuted endpoint from the DeviceTable cache (per call)",
+			[](const World& w, const Devices&) {
+				auto tab = std::make_shared<DeviceTable>();
+				tab->load(DeviceList(std::make_shared<SimAudioBackend>(w)), AudioFlow::PLAY);
+				auto sink = std::make_shared<size_t>(0);
+				return std::function<void(size_t)>([tab, sink](size_t) {
+					const auto& vol = tab->get_volumes();
+					const auto& mute = tab->get_mutes();
+					size_t best = 0;
+					for (size_t p = 1; p < vol.size(); ++p) if (!mute[p] && vol[p] > vol[best]) best = p;
+					*sink += best;
+				});
+			} },
+	};
+	return all;
+}
+
+static std::vector<Result> _run(const Options& opt)
+{
+	std::vector<Result> out;
+
+	for (const size_t n : opt.sizes) {
+		SimConfig cfg = opt.sim;
+		cfg.num_play = n;
+		const auto world = std::make_shared<SimWorld>(cfg);
+		const auto backend = std::make_shared<SimAudioBackend>(world);
+		const DeviceList devl(backend);
+
+		std::vector<std::shared_ptr<Device>> devs;
+		for (size_t a = 0; a < n; ++a) devs.push_back(std::make_shared<Device>(devl.get_play(a)));
+
+		for (const auto& s : _scenarios()) {
+			if (!opt.only.empty() && std::find(opt.only.begin(), opt.only.end(), s.name) == opt.only.end()) continue;
+			Result r = _measure(s.prepare(world, devs), opt.budget);
+			r.scenario = s.name;
+			r.endpoints = n;
+			out.push_back(r);
+
+			char buf[160];
+			snprintf(buf, sizeof(buf), "%s\t%zu\t%.1f\t%zu\n", r.scenario.c_str(), r.endpoints, r.ns, r.ops);
+			std::cout << buf << std::flush;
+		}
+	}
+	return out;
+}
+
+static void _save(const std::string& path, const Options& opt, const std::vector<Result>& results)
+{
+	std::ofstream fp(path);
+	if (!fp) throw std::runtime_error("Cannot write " + path);
+	fp << "# SoundCtlBench " << results_version << "\tlat=" << opt.sim.latency.count() << ",ch=" << opt.sim.channels << ",depth=" << opt.sim.topology_depth << "\n";
+	char buf[160];
+	for (const auto& r : results) {
+		snprintf(buf, sizeof(buf), "%s\t%zu\t%.1f\t%zu\n", r.scenario.c_str(), r.endpoints, r.ns, r.ops);
+		fp << buf;
+	}
+	if (!fp) throw std::runtime_error("Cannot write " + path);
+}
+
+static std::map<std::pair<std::string, size_t>, double> _load(const std::string& path)
+{
+	std::ifstream fp(path);
+	if (!fp) throw std::runtime_error("Cannot read " + path);
+
+	std::map<std::pair<std::string, size_t>, double> out;
+	std::string line;
+	while (std::getline(fp, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		std::stringstream ss(line);
+		std::string name;
+		size_t n = 0;
+		double ns = 0;
+		if (!(ss >> name >> n >> ns)) throw std::runtime_error("Not a benchmark result: " + line);
+		out[{ name, n }] = ns;
+	}
+	return out;
+}
+
+// Returns how many results got slower than the threshold
+static size_t _compare(const std::string& path, const double threshold, const std::vector<Result>& results)
+{
+	const auto base = _load(path);
+	size_t regressions = 0, missing = 0;
+
+	std::cout << "# compared with " << path << ", threshold " << threshold * 100 << "%\n";
+	std::cout << "# scenario\tendpoints\tbaseline ns\tns\tratio\n";
+	for (const auto& r : results) {
+		const auto it = base.find({ r.scenario, r.endpoints });
+		if (it == base.end() || it->second <= 0) {
+			++missing;
+			continue;
+		}
+		const double ratio = r.ns / it->second;
+		const char* verdict = "";
+		if (ratio > 1.0 + threshold) {
+			verdict = "\tREGRESSION";
+			++regressions;
+		}
+		else if (ratio < 1.0 - threshold) verdict = "\tfaster";
+
+		char buf[200];
+		snprintf(buf, sizeof(buf), "# %s\t%zu\t%.1f\t%.1f\t%.2f%s\n", r.scenario.c_str(), r.endpoints, it->second, r.ns, ratio, verdict);
+		std::cout << buf;
+	}
+	std::cout << "# " << regressions << " regression(s), " << missing << " result(s) not in the baseline\n";
+	return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+	try {
+		Options opt;
+		opt.sim.num_rec = 0;
+		opt.sim.apps = 0;
+
+		for (int argp = 1; argp < argc; ++argp) {
+			const bool has_val = (argp + 1 < argc);
+			if (has_val && strcmp(argv[argp], "-sim") == 0) {
+				opt.sim = SimConfig::parse(argv[++argp]);
+				opt.sim.num_rec = 0;
+			}
+			else if (has_val && strcmp(argv[argp], "-sizes") == 0) opt.sizes = _parse_sizes(argv[++argp]);
+			else if (has_val && strcmp(argv[argp], "-only") == 0) {
+				std::stringstream ss(argv[++argp]);
+				std::string item;
+				while (std::getline(ss, item, ',')) opt.only.push_back(item);
+			}
+			else if (has_val && strcmp(argv[argp], "-ms") == 0) opt.budget = std::chrono::milliseconds(std::max<unsigned long>(1, std::stoul(argv[++argp])));
+			else if (has_val && strcmp(argv[argp], "-save") == 0) opt.save = argv[++argp];
+			else if (has_val && strcmp(argv[argp], "-compare") == 0) opt.compare = argv[++argp];
+			else if (has_val && strcmp(argv[argp], "-threshold") == 0) opt.threshold = std::stod(argv[++argp]) / 100.0;
+			else {
+				std::cout << "SoundCtlBench: device layer benchmarks on simulated endpoints\n";
+				std::cout << "- -sim <config>: endpoint set, as SoundCtl -sim (play= is replaced by each endpoint count; default: no latency)\n";
+				std::cout << "- -sizes <n,n,...>: endpoint counts (default 1,2,4,...,512)\n";
+				std::cout << "- -only <scenario,...>: run only these\n";
+				std::cout << "- -ms <ms>: time per measurement, 5 per result (default 20)\n";
+				std::cout << "- -save <file>: write the results there\n";
+				std::cout << "- -compare <file>: flag results slower than in that file, exit code 1 if any\n";
+				std::cout << "- -threshold <percent>: how much slower counts as a regression (default 10)\n";
+				std::cout << "Scenarios:\n";
+				for (const auto& s : _scenarios()) std::cout << "- " << s.name << ": " << s.what << "\n";
+				return 2;
+			}
+		}
+		for (const auto& i : opt.only) {
+			const auto& all = _scenarios();
+			if (std::none_of(all.begin(), all.end(), [&i](const Scenario& s) { return i == s.name; }))
+				throw std::invalid_argument("Unknown scenario: " + i);
+		}
+
+		std::cout << "# scenario\tendpoints\tns per op\tops\n";
+		const auto results = _run(opt);
+		if (!opt.save.empty()) _save(opt.save, opt, results);
+		if (!opt.compare.empty() && _compare(opt.compare, opt.threshold, results)) return 1;
+		return 0;
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Exception: " << e.what() << "\n";
+		return 2;
+	}
+}